@@ -0,0 +1,27 @@
+/**
+ *	@file benchmark_main.cpp
+ *
+ *	Runs one of the counter benchmarks, chosen by the first command line argument.
+ *	Results go to the standard output.
+ */
+
+#include <cstring>
+#include <iostream>
+#include "benchmarks.hpp"
+
+int main(int argc, const char * argv[]) {
+	if (argc >= 2 && std::strcmp(argv[1], "insert") == 0) {
+		return counterBench::insert_benchmark(argc - 2, argv + 2);
+	}
+	if (argc >= 2 && std::strcmp(argv[1], "numa") == 0) {
+		return counterBench::numa_benchmark(argc - 2, argv + 2);
+	}
+	if (argc >= 2 && std::strcmp(argv[1], "scaling") == 0) {
+		return counterBench::scaling_benchmark(argc - 2, argv + 2);
+	}
+	
+	std::cout << "Usage: ./Benchmarks insert [distinct_tokens [total_tokens]]" << std::endl;
+	std::cout << "       ./Benchmarks numa input.txt [repetitions]" << std::endl;
+	std::cout << "       ./Benchmarks scaling [megabytes [max_threads [csv|json]]]" << std::endl;
+	return 1;
+}
@@ -0,0 +1,57 @@
+/**
+ *	@file benchmarks.hpp
+ *
+ *	Entry points of the individual benchmarks run by benchmark_main.cpp.
+ *	Each takes the command line arguments following the benchmark's name
+ *	and returns a process exit code.
+ */
+
+#ifndef benchmarks_hpp
+#define benchmarks_hpp
+
+#include <chrono>
+
+namespace counterBench {
+
+	/**
+	 Compares one-at-a-time and batched (prefetching) insertion into a Token_count_map.
+
+	 @param argc [IN] Number of arguments in argv.
+	 @param argv [IN] Optional: distinct token count, then total token count.
+	 @return 0 on success.
+	 */
+	int insert_benchmark(int argc, const char* argv[]);
+
+	/**
+	 Compares counting files one task per file against counting on NUMA node pools.
+
+	 @param argc [IN] Number of arguments in argv.
+	 @param argv [IN] The input file listing the files to count, then optionally the repetition count.
+	 @return 0 on success.
+	 */
+	int numa_benchmark(int argc, const char* argv[]);
+
+	/**
+	 Times counting generated corpora (many tiny files or a few huge ones,
+	 Zipf or uniform words) serially and on 1 to N threads, writing the scaling
+	 curves (throughput, speedup, efficiency, peak memory) as CSV or JSON.
+
+	 @param argc [IN] Number of arguments in argv.
+	 @param argv [IN] Optional: corpus size in megabytes, then the most threads, then csv or json.
+	 @return 0 on success.
+	 */
+	int scaling_benchmark(int argc, const char* argv[]);
+
+	/**
+	 Seconds elapsed since the given start time.
+
+	 @param start [IN] A time point taken with std::chrono::steady_clock::now().
+	 @return Elapsed time in seconds.
+	 */
+	inline double seconds_since(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+}
+
+#endif /* benchmarks_hpp */
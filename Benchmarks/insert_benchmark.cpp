@@ -0,0 +1,127 @@
+//
+//  insert_benchmark.cpp
+//  counter
+//
+//  Times counting a synthetic token stream into a Token_count_map
+//  one token at a time (++tcm[token]) against Token_count_map::add_batch(),
+//  and merging one map into another entry by entry against the batched merge.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "benchmarks.hpp"
+#include "synthetic_text.hpp"
+#include "Token_count_map.hpp"
+
+using namespace counterLib;
+
+namespace counterBench {
+
+	namespace {
+		const int repetitions = 3; // best of
+
+		/**
+		 Draws a stream of tokens from the vocabulary,
+		 either uniformly or following Zipf's law (as natural text does).
+		 */
+		std::vector<Token_view> make_stream(const std::vector<std::string>& vocabulary,
+											std::size_t total, bool zipf, std::mt19937_64& rng) {
+			std::vector<Token_view> stream;
+			stream.reserve(total);
+			Word_sampler sample { vocabulary.size(), zipf };
+			for (std::size_t k = 0; k < total; ++k) {
+				stream.emplace_back(vocabulary[sample(rng)]);
+			}
+			return stream;
+		}
+
+		template <class Fn>
+		double best_time(Fn run) {
+			double best = 0;
+			for (int r = 0; r < repetitions; ++r) {
+				auto start = std::chrono::steady_clock::now();
+				run();
+				double t = seconds_since(start);
+				best = (r == 0 || t < best) ? t : best;
+			}
+			return best;
+		}
+
+		void report(const char* what, const char* distribution, std::size_t items, double single, double batched) {
+			std::cout << std::left << std::setw(8) << what << std::setw(9) << distribution
+				<< std::right << std::fixed << std::setprecision(1)
+				<< std::setw(12) << items / single / 1e6
+				<< std::setw(12) << items / batched / 1e6
+				<< std::setw(10) << std::setprecision(2) << single / batched << "x" << std::endl;
+		}
+	}
+
+	int insert_benchmark(int argc, const char* argv[]) {
+		std::size_t distinct = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 2000000;
+		std::size_t total = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000000;
+		if (distinct == 0 || total == 0) {
+			std::cout << "Token counts must be positive." << std::endl;
+			return 1;
+		}
+
+		std::mt19937_64 rng { 42 };
+		auto vocabulary = make_vocabulary(distinct, rng);
+
+		std::cout << "distinct tokens: " << distinct << ", stream length: " << total << std::endl;
+		std::cout << std::left << std::setw(8) << "op" << std::setw(9) << "dist"
+			<< std::right << std::setw(12) << "single M/s" << std::setw(12) << "batch M/s"
+			<< std::setw(11) << "speedup" << std::endl;
+
+		for (bool zipf : { false, true }) {
+			const char* distribution = zipf ? "zipf" : "uniform";
+			auto stream = make_stream(vocabulary, total, zipf, rng);
+			unsigned long check = 0;
+
+			// counting a token stream
+			double single = best_time([&] {
+				Token_count_map tcm;
+				for (auto& t : stream) {
+					++tcm[t];
+				}
+				check += tcm.size();
+			});
+			double batched = best_time([&] {
+				Token_count_map tcm;
+				tcm.add_batch(stream.data(), stream.size());
+				check -= tcm.size();
+			});
+			report("count", distribution, stream.size(), single, batched);
+
+			// merging a per-file map into a global one, as Counter::add_map does
+			Token_count_map fileTCM;
+			fileTCM.add_batch(stream.data(), stream.size() / 2);
+			Token_count_map globalTCM;
+			globalTCM.add_batch(stream.data() + stream.size() / 2, stream.size() - stream.size() / 2);
+			single = best_time([&] {
+				Token_count_map tcm { globalTCM };
+				for (auto& tc : fileTCM) {
+					tcm[tc.first] += tc.second;
+				}
+				check += tcm.size();
+			});
+			batched = best_time([&] {
+				Token_count_map tcm { globalTCM };
+				tcm.add_batch(fileTCM.cbegin(), fileTCM.cend());
+				check -= tcm.size();
+			});
+			report("merge", distribution, fileTCM.size(), single, batched);
+
+			if (check != 0) {
+				std::cout << "Batched and single insertion disagree!" << std::endl;
+				return 2;
+			}
+		}
+		return 0;
+	}
+
+}
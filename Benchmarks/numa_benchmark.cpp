@@ -0,0 +1,98 @@
+//
+//  numa_benchmark.cpp
+//  counter
+//
+//  Times counting the files of an input list with one task per file
+//  (on a plain Thread_pool) against counting on Node_pools, pinned and not:
+//  one table per worker, reduced within each NUMA node before crossing nodes.
+//  The speedup only shows on machines with more than one node.
+//
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "benchmarks.hpp"
+#include "Counter.hpp"
+#include "Input_file_list.hpp"
+
+using namespace counterLib;
+
+namespace counterBench {
+
+	namespace {
+		/**
+		 Best time of the given number of counts of the files, and their unique token count.
+		 */
+		double best_count_time(Counter& counter, const std::vector<std::string>& files,
+							   int repetitions, unsigned long& unique) {
+			double best = 0;
+			for (int r = 0; r < repetitions; ++r) {
+				auto start = std::chrono::steady_clock::now();
+				unique = counter.count_files(files).unique_token_count();
+				double t = seconds_since(start);
+				best = (r == 0 || t < best) ? t : best;
+			}
+			return best;
+		}
+	}
+
+	int numa_benchmark(int argc, const char* argv[]) {
+		if (argc < 1) {
+			std::cout << "An input file listing the files to count is needed." << std::endl;
+			return 1;
+		}
+		int repetitions = argc > 1 ? std::atoi(argv[1]) : 3;
+		if (repetitions < 1) {
+			repetitions = 1;
+		}
+		Input_file_list ifl { argv[0] };
+		std::vector<std::string> files(ifl.cbegin(), ifl.cend());
+
+		Cpu_topology topology = Cpu_topology::detect();
+		std::cout << "files: " << files.size() << ", NUMA nodes: " << topology.node_count()
+			<< ", CPUs:";
+		for (std::size_t node = 0; node < topology.node_count(); ++node) {
+			std::cout << " " << topology.cpus(node).size();
+		}
+		std::cout << std::endl;
+
+		unsigned long perFileUnique = 0, unpinnedUnique = 0, pinnedUnique = 0;
+		double perFile, unpinned, pinned;
+		{
+			Thread_pool pool { static_cast<unsigned>(topology.cpu_count()) };
+			Counter counter { &pool };
+			perFile = best_count_time(counter, files, repetitions, perFileUnique);
+		}
+		{
+			Node_pools nodes { topology, false };
+			Counter counter;
+			counter.set_node_pools(&nodes);
+			unpinned = best_count_time(counter, files, repetitions, unpinnedUnique);
+		}
+		{
+			Node_pools nodes { topology, true };
+			Counter counter;
+			counter.set_node_pools(&nodes);
+			pinned = best_count_time(counter, files, repetitions, pinnedUnique);
+		}
+
+		std::cout << std::left << std::setw(22) << "mode" << std::right << std::setw(10) << "seconds"
+			<< std::setw(11) << "speedup" << std::endl;
+		std::cout << std::fixed;
+		std::cout << std::left << std::setw(22) << "task per file" << std::right << std::setprecision(3)
+			<< std::setw(10) << perFile << std::setprecision(2) << std::setw(10) << 1.0 << "x" << std::endl;
+		std::cout << std::left << std::setw(22) << "node pools, unpinned" << std::right << std::setprecision(3)
+			<< std::setw(10) << unpinned << std::setprecision(2) << std::setw(10) << perFile / unpinned << "x" << std::endl;
+		std::cout << std::left << std::setw(22) << "node pools, pinned" << std::right << std::setprecision(3)
+			<< std::setw(10) << pinned << std::setprecision(2) << std::setw(10) << perFile / pinned << "x" << std::endl;
+
+		if (perFileUnique != unpinnedUnique || perFileUnique != pinnedUnique) {
+			std::cout << "The counting modes disagree!" << std::endl;
+			return 2;
+		}
+		return 0;
+	}
+
+}
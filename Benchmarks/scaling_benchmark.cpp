@@ -0,0 +1,247 @@
+//
+//  scaling_benchmark.cpp
+//  counter
+//
+//  Times Counter end to end, from the input list to the merged counts,
+//  on generated corpora: many tiny files or a few huge ones, with words drawn
+//  uniformly or following Zipf's law. Each corpus is counted serially
+//  (count_tokens()) and concurrently on pools of 1 to N threads
+//  (concurrent_count_tokens()), and the scaling curves are written
+//  as CSV or JSON: throughput, speedup and efficiency against one thread,
+//  and the peak resident memory of each run.
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "benchmarks.hpp"
+#include "synthetic_text.hpp"
+#include "Counter.hpp"
+
+using namespace counterLib;
+
+namespace counterBench {
+
+	namespace {
+		const int repetitions = 3; // best of
+		const std::size_t vocabulary_size = 100000;
+		const std::size_t tiny_file_bytes = 4 * 1024;
+		const std::size_t huge_file_count = 4;
+		const std::size_t words_per_line = 12;
+
+		/**
+		 A generated corpus: its files, listed in an input file.
+		 */
+		struct Corpus {
+			std::string name; // e.g. "tiny-zipf"
+			std::string listFileName;
+			std::vector<std::string> files;
+			std::uint64_t bytes = 0;
+		};
+
+		/**
+		 One timed run of a corpus.
+		 */
+		struct Sample {
+			const Corpus* corpus;
+			const char* mode; // "serial" or "pool"
+			unsigned threads;
+			double seconds;
+			double speedup; // against the pool of one thread
+			long peakRssKb; // -1 if unknown
+		};
+
+		/**
+		 Writes a corpus of about totalBytes into directory, in files of fileBytes,
+		 one line of words after another.
+		 */
+		Corpus make_corpus(const std::string& directory, const std::string& name,
+						   const std::vector<std::string>& vocabulary, bool zipf,
+						   std::uint64_t totalBytes, std::uint64_t fileBytes, std::mt19937_64& rng) {
+			Corpus corpus;
+			corpus.name = name;
+			corpus.listFileName = directory + "/" + name + ".txt";
+			std::ofstream list { corpus.listFileName };
+			Word_sampler sample { vocabulary.size(), zipf };
+			std::string line;
+			for (std::size_t f = 0; corpus.bytes < totalBytes; ++f) {
+				std::string fileName = directory + "/" + name + "-" + std::to_string(f) + ".txt";
+				std::ofstream file { fileName };
+				std::uint64_t written = 0;
+				while (written < fileBytes && corpus.bytes + written < totalBytes) {
+					line.clear();
+					for (std::size_t w = 0; w < words_per_line; ++w) {
+						line += vocabulary[sample(rng)];
+						line += w + 1 < words_per_line ? ' ' : '\n';
+					}
+					file << line;
+					written += line.size();
+				}
+				corpus.bytes += written;
+				corpus.files.push_back(fileName);
+				list << fileName << '\n';
+			}
+			return corpus;
+		}
+
+		/**
+		 Forgets the peak resident memory so far, so the next reading covers only what follows.
+		 Possible on Linux only (through /proc/self/clear_refs).
+
+		 @return false if it couldn't be reset.
+		 */
+		bool reset_peak_rss() {
+			std::ofstream clearRefs { "/proc/self/clear_refs" };
+			return clearRefs.is_open() && (clearRefs << "5").flush();
+		}
+
+		/**
+		 The peak resident memory, in KiB: since the last reset_peak_rss() if it worked,
+		 else since the process started.
+		 */
+		long peak_rss_kb() {
+			std::ifstream status { "/proc/self/status" };
+			std::string line;
+			while (std::getline(status, line)) {
+				if (line.compare(0, 6, "VmHWM:") == 0) {
+					return std::atol(line.c_str() + 6);
+				}
+			}
+			rusage usage;
+			if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+				return -1;
+			}
+#if defined(__APPLE__)
+			return static_cast<long>(usage.ru_maxrss / 1024); // bytes there
+#else
+			return static_cast<long>(usage.ru_maxrss);
+#endif
+		}
+
+		/**
+		 Best time of counting a corpus, with the peak memory of the runs.
+		 threads of 0 counts serially, otherwise on a pool of that many threads.
+		 */
+		Sample time_corpus(const Corpus& corpus, unsigned threads) {
+			Sample sample { &corpus, threads == 0 ? "serial" : "pool", threads, 0, 0, -1 };
+			std::unique_ptr<Thread_pool> pool { threads == 0 ? nullptr : new Thread_pool { threads } };
+			const std::string outputFileName = corpus.listFileName + ".out";
+			bool resetWorked = reset_peak_rss();
+			for (int r = 0; r < repetitions; ++r) {
+				// a fresh Counter each time, so no run gets a table warmed by the last
+				Counter counter { corpus.listFileName, outputFileName, pool.get() };
+				auto start = std::chrono::steady_clock::now();
+				if (pool) {
+					counter.concurrent_count_tokens();
+				}
+				else {
+					counter.count_tokens();
+				}
+				double t = seconds_since(start);
+				sample.seconds = (r == 0 || t < sample.seconds) ? t : sample.seconds;
+			}
+			sample.peakRssKb = resetWorked ? peak_rss_kb() : -1;
+			std::remove(outputFileName.c_str());
+			return sample;
+		}
+
+		double megabytes_per_second(const Sample& s) {
+			return s.corpus->bytes / s.seconds / 1e6;
+		}
+
+		void write_csv(const std::vector<Sample>& samples, std::ostream& out) {
+			out << "corpus,files,bytes,mode,threads,seconds,mb_per_s,speedup,efficiency,peak_rss_kb" << std::endl;
+			for (auto& s : samples) {
+				out << s.corpus->name << ',' << s.corpus->files.size() << ',' << s.corpus->bytes << ','
+					<< s.mode << ',' << s.threads << ',' << std::fixed << std::setprecision(4) << s.seconds << ','
+					<< std::setprecision(1) << megabytes_per_second(s) << ',' << std::setprecision(3) << s.speedup << ','
+					<< (s.threads ? s.speedup / s.threads : s.speedup) << ',' << s.peakRssKb << std::endl;
+			}
+		}
+
+		void write_json(const std::vector<Sample>& samples, std::ostream& out) {
+			out << "[" << std::endl;
+			for (std::size_t k = 0; k < samples.size(); ++k) {
+				auto& s = samples[k];
+				out << "  {\"corpus\": \"" << s.corpus->name << "\", \"files\": " << s.corpus->files.size()
+					<< ", \"bytes\": " << s.corpus->bytes << ", \"mode\": \"" << s.mode << "\", \"threads\": " << s.threads
+					<< std::fixed << std::setprecision(4) << ", \"seconds\": " << s.seconds
+					<< std::setprecision(1) << ", \"mb_per_s\": " << megabytes_per_second(s)
+					<< std::setprecision(3) << ", \"speedup\": " << s.speedup
+					<< ", \"efficiency\": " << (s.threads ? s.speedup / s.threads : s.speedup)
+					<< ", \"peak_rss_kb\": " << s.peakRssKb << "}" << (k + 1 < samples.size() ? "," : "") << std::endl;
+			}
+			out << "]" << std::endl;
+		}
+	}
+
+	int scaling_benchmark(int argc, const char* argv[]) {
+		double megabytes = argc > 0 ? std::strtod(argv[0], nullptr) : 32;
+		unsigned hardware = std::thread::hardware_concurrency();
+		unsigned maxThreads = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : (hardware ? hardware : 1);
+		const char* format = argc > 2 ? argv[2] : "csv";
+		if (megabytes <= 0 || maxThreads == 0 || (std::strcmp(format, "csv") != 0 && std::strcmp(format, "json") != 0)) {
+			std::cout << "Give a positive size in megabytes, a positive thread count, and csv or json." << std::endl;
+			return 1;
+		}
+
+		char directoryTemplate[] = "/tmp/counter-scaling-XXXXXX";
+		if (::mkdtemp(directoryTemplate) == nullptr) {
+			std::cout << "Unable to make a directory for the corpora." << std::endl;
+			return 1;
+		}
+		const std::string directory = directoryTemplate;
+		const auto totalBytes = static_cast<std::uint64_t>(megabytes * 1e6);
+
+		std::mt19937_64 rng { 42 };
+		auto vocabulary = make_vocabulary(vocabulary_size, rng);
+		std::vector<Corpus> corpora;
+		for (bool zipf : { true, false }) {
+			const std::string distribution = zipf ? "zipf" : "uniform";
+			corpora.push_back(make_corpus(directory, "tiny-" + distribution, vocabulary, zipf,
+										  totalBytes, tiny_file_bytes, rng));
+			corpora.push_back(make_corpus(directory, "huge-" + distribution, vocabulary, zipf,
+										  totalBytes, (totalBytes + huge_file_count - 1) / huge_file_count, rng));
+		}
+
+		std::vector<Sample> samples;
+		for (auto& corpus : corpora) {
+			std::size_t oneThread = samples.size() + 1; // the serial sample comes first
+			for (unsigned threads = 0; threads <= maxThreads; ++threads) {
+				samples.push_back(time_corpus(corpus, threads));
+				std::cerr << corpus.name << ", " << samples.back().mode << " " << threads << ": "
+					<< samples.back().seconds << " s" << std::endl;
+			}
+			for (std::size_t k = oneThread - 1; k < samples.size(); ++k) {
+				samples[k].speedup = samples[oneThread].seconds / samples[k].seconds;
+			}
+		}
+
+		if (std::strcmp(format, "json") == 0) {
+			write_json(samples, std::cout);
+		}
+		else {
+			write_csv(samples, std::cout);
+		}
+
+		for (auto& corpus : corpora) {
+			for (auto& fileName : corpus.files) {
+				std::remove(fileName.c_str());
+			}
+			std::remove(corpus.listFileName.c_str());
+		}
+		::rmdir(directory.c_str());
+		return 0;
+	}
+
+}
@@ -0,0 +1,52 @@
+//
+//  synthetic_text.cpp
+//  counter
+//
+
+#include "synthetic_text.hpp"
+#include <algorithm>
+#include "Token_count_map.hpp"
+
+using namespace counterLib;
+
+namespace counterBench {
+
+	std::vector<std::string> make_vocabulary(std::size_t distinct, std::mt19937_64& rng) {
+		std::uniform_int_distribution<int> length(3, 12), letter('a', 'z');
+		std::vector<std::string> vocabulary;
+		vocabulary.reserve(distinct);
+		Token_count_map seen;
+		while (vocabulary.size() < distinct) {
+			std::string w(length(rng), ' ');
+			for (auto& c : w) {
+				c = static_cast<char>(letter(rng));
+			}
+			if (seen.try_emplace(w).second) {
+				vocabulary.push_back(std::move(w));
+			}
+		}
+		return vocabulary;
+	}
+
+	Word_sampler::Word_sampler(std::size_t vocabularySize, bool zipf) :
+		_size { vocabularySize } {
+		if (zipf) {
+			_cdf.resize(vocabularySize);
+			double sum = 0;
+			for (std::size_t r = 0; r < _cdf.size(); ++r) {
+				sum += 1.0 / (r + 1);
+				_cdf[r] = sum;
+			}
+		}
+	}
+
+	std::size_t Word_sampler::operator() (std::mt19937_64& rng) {
+		if (_cdf.empty()) {
+			return std::uniform_int_distribution<std::size_t>(0, _size - 1)(rng);
+		}
+		double u = std::uniform_real_distribution<double>(0, _cdf.back())(rng);
+		auto r = std::lower_bound(_cdf.begin(), _cdf.end(), u) - _cdf.begin();
+		return std::min<std::size_t>(static_cast<std::size_t>(r), _size - 1);
+	}
+
+}
@@ -0,0 +1,56 @@
+/**
+ *	@file synthetic_text.hpp
+ *
+ *	Random vocabularies and word draws for the benchmarks' synthetic inputs.
+ */
+
+#ifndef synthetic_text_hpp
+#define synthetic_text_hpp
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace counterBench {
+
+	/**
+	 Makes distinct random lowercase tokens, 3 to 12 letters long.
+
+	 @param distinct [IN] Number of tokens to make.
+	 @param rng [IN/OUT] Random number generator.
+	 @return The tokens.
+	 */
+	std::vector<std::string> make_vocabulary(std::size_t distinct, std::mt19937_64& rng);
+
+	/**
+	 Draws positions in a vocabulary, either uniformly
+	 or following Zipf's law (as the words of natural text do),
+	 where the word at position r is drawn in proportion to 1 / (r + 1).
+	 */
+	class Word_sampler {
+	public:
+		/**
+		 Initializing Constructor
+
+		 @param vocabularySize [IN] Number of words to draw from. Must not be 0.
+		 @param zipf [IN] Whether to follow Zipf's law rather than draw uniformly.
+		 */
+		Word_sampler(std::size_t vocabularySize, bool zipf);
+
+		/**
+		 Draws one word.
+
+		 @param rng [IN/OUT] Random number generator.
+		 @return A position in the vocabulary.
+		 */
+		std::size_t operator() (std::mt19937_64& rng);
+
+	private:
+		std::size_t _size;
+		std::vector<double> _cdf; // Zipf's cumulative weights, empty when uniform
+	};
+
+}
+
+#endif /* synthetic_text_hpp */
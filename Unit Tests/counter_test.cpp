@@ -6,12 +6,101 @@
 //
 
 #include "counter.hpp"
+#include "Count_server.hpp"
+#include "Watch_counter.hpp"
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE CounterTests
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 using namespace counterLib;
 
+/*	Counts every heap allocation of the test program,
+	so tests can prove a code path does not allocate.
+	Every form is replaced, so each delete matches its new; they are kept
+	out of line so the compiler doesn't see free() called on memory from operator new.
+ */
+namespace {
+	std::atomic<unsigned long> allocation_count { 0 };
+}
+
+__attribute__((noinline)) void* operator new (std::size_t size) {
+	++allocation_count;
+	if (void* p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void* operator new (std::size_t size, const std::nothrow_t&) noexcept {
+	++allocation_count;
+	return std::malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) void* operator new[] (std::size_t size) {
+	return ::operator new(size);
+}
+
+__attribute__((noinline)) void* operator new[] (std::size_t size, const std::nothrow_t& nothrow) noexcept {
+	return ::operator new(size, nothrow);
+}
+
+__attribute__((noinline)) void operator delete (void* p) noexcept {
+	std::free(p);
+}
+
+__attribute__((noinline)) void operator delete (void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[] (void* p) noexcept {
+	std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[] (void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+__attribute__((noinline)) void operator delete (void* p, const std::nothrow_t&) noexcept {
+	std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[] (void* p, const std::nothrow_t&) noexcept {
+	std::free(p);
+}
+
+/*	Plans even tiny inputs a task each, in parallel,
+	so tests reach the concurrent paths without big files.
+ */
+namespace {
+	Schedule_policy parallel_policy() {
+		Schedule_policy policy;
+		policy.small_input_bytes = 0;
+		policy.parallel_bytes = 0;
+		policy.workers = 2;
+		return policy;
+	}
+}
+
 /*	1.	Open a file specified as the first parameter on the command-line
 		that contains a list of filenames, one filename per line.
  */
@@ -191,6 +280,50 @@ BOOST_AUTO_TEST_CASE( Swapping ) {
 	BOOST_REQUIRE( tcm6.size() == origTC2 );
 }
 
+BOOST_AUTO_TEST_CASE( Steady_state_counting_does_not_allocate ) {
+	File_token_counter ftc("test2.txt");
+	Token_count_map tcm;
+	ftc.add_to_map(tcm); // first pass inserts every token
+	Token_count_map firstPass { tcm };
+	
+	unsigned long before = allocation_count;
+	ftc.add_to_map(tcm); // second pass only finds them again
+	unsigned long after = allocation_count;
+	
+	BOOST_REQUIRE( after == before );
+	for (auto& tc : firstPass) {
+		BOOST_REQUIRE( tcm[tc.first] == 2 * tc.second );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( Tokens_spanning_read_blocks_are_whole ) {
+	// more text than one read block, with tokens of every length straddling block edges
+	std::ostringstream text;
+	for (int k = 0; static_cast<std::size_t>(text.tellp()) < 3 * File_token_counter::read_buffer_size; ++k) {
+		text << "\"Word" << std::string(k % 37, 'x') << "!\"" << (k % 5 ? " " : "\n\t");
+	}
+	text << std::string(File_token_counter::read_buffer_size + 10, 'z'); // longer than a block
+	{
+		std::ofstream out("long_test.txt");
+		out << text.str();
+	}
+	
+	Token_count_map expected;
+	std::istringstream in(text.str());
+	std::string aWord;
+	while (in >> aWord) {
+		std::string cleanWord = clean_word(aWord);
+		if (!cleanWord.empty()) {
+			++expected[cleanWord];
+		}
+	}
+	
+	Token_count_map tcm;
+	File_token_counter ftc("long_test.txt");
+	ftc.add_to_map(tcm);
+	BOOST_REQUIRE( tcm == expected );
+}
+
 BOOST_AUTO_TEST_CASE( Empty_file ) {
 	File_token_counter ftc { "empty.txt" };
 	Token_count_map tcm;
@@ -320,6 +453,295 @@ BOOST_AUTO_TEST_CASE( Swapping ) {
 	BOOST_REQUIRE( osf2.token_count() == origTCount2 );
 }
 
+BOOST_AUTO_TEST_CASE( Merged_runs_match_the_sorted_set ) {
+	// enough tokens for several runs, with many tied counts
+	Token_count_map tcm;
+	for (int t = 0; t < 80000; ++t) {
+		tcm.try_emplace("token" + std::to_string(t), 1 + t * 7919 % 13);
+	}
+	Output_sorting_file osf("output.txt");
+	osf.set_sorted(tcm, 3);
+	std::ostringstream expected;
+	osf.write_to_output(expected);
+	
+	Sorted_runs runs;
+	runs.sort(tcm, 3, nullptr, 3);
+	BOOST_REQUIRE( runs.run_count() == 3 );
+	BOOST_REQUIRE( runs.size() == osf.token_count() );
+	std::ostringstream merged;
+	runs.write(merged);
+	BOOST_REQUIRE( merged.str() == expected.str() );
+	
+	Thread_pool pool { 2 };
+	runs.sort(tcm, 3, &pool);
+	std::ostringstream pooled;
+	runs.write(pooled);
+	BOOST_REQUIRE( pooled.str() == expected.str() );
+}
+
+BOOST_AUTO_TEST_CASE( Chunked_file_output_matches_the_merge ) {
+	// several chunks' worth, over runs of different lengths
+	Token_count_map tcm;
+	for (int t = 0; t < 300000; ++t) {
+		tcm.try_emplace("token" + std::to_string(t), 1 + t * 7919LL % 13);
+	}
+	Sorted_runs runs;
+	runs.sort(tcm, 1, nullptr, 5);
+	std::ostringstream expected;
+	runs.write(expected, true);
+	
+	auto file_text = [](const char* fileName) {
+		std::ifstream in { fileName, std::ios::binary };
+		return std::string { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+	};
+	{
+		std::ofstream old { "chunked_output.txt" };
+		old << expected.str() << "longer than the new output";
+	}
+	Thread_pool pool { 3 };
+	for (Thread_pool* p : { static_cast<Thread_pool*>(nullptr), &pool }) {
+		int fd = ::open("chunked_output.txt", O_WRONLY);
+		BOOST_REQUIRE( fd >= 0 );
+		BOOST_REQUIRE( runs.write_file(fd, true, p) == expected.str().size() );
+		::close(fd);
+		BOOST_REQUIRE( file_text("chunked_output.txt") == expected.str() );
+	}
+	
+	runs.clear();
+	int fd = ::open("chunked_output.txt", O_WRONLY);
+	BOOST_REQUIRE( runs.write_file(fd) == 0 );
+	::close(fd);
+	BOOST_REQUIRE( file_text("chunked_output.txt").empty() );
+	std::remove("chunked_output.txt");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+/*
+	Memory resources backing the token count maps.
+ */
+BOOST_AUTO_TEST_SUITE( Memory_resource_test_suite )
+
+BOOST_AUTO_TEST_CASE( Arena_map_counts_match_heap_map ) {
+	Monotonic_arena arena;
+	Token_count_map arenaTCM { &arena };
+	Token_count_map heapTCM;
+	
+	File_token_counter ftc("test.txt");
+	ftc.add_to_map(arenaTCM);
+	ftc.add_to_map(heapTCM);
+	
+	BOOST_REQUIRE( arena.bytes_allocated() > 0 );
+	BOOST_REQUIRE( arenaTCM.size() == heapTCM.size() );
+	for (auto& p : heapTCM) {
+		auto i = arenaTCM.find(p.first);
+		BOOST_REQUIRE( i != arenaTCM.end() );
+		BOOST_REQUIRE( i->second == p.second );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( Released_arena_starts_over ) {
+	Monotonic_arena arena { 256 };
+	for (int k = 0; k < 1000; ++k) {
+		BOOST_REQUIRE( arena.allocate(24) != nullptr );
+	}
+	BOOST_REQUIRE( arena.bytes_allocated() >= 24000 );
+	arena.release();
+	BOOST_REQUIRE( arena.bytes_allocated() == 0 );
+}
+
+BOOST_AUTO_TEST_CASE( Copied_map_does_not_share_arena ) {
+	Token_count_map copyTCM;
+	{
+		Monotonic_arena arena;
+		Token_count_map arenaTCM { &arena };
+		File_token_counter ftc("test.txt");
+		ftc.add_to_map(arenaTCM);
+		copyTCM = Token_count_map { arenaTCM };
+		BOOST_REQUIRE( copyTCM.resource() == new_delete_resource() );
+	} // arena gone
+	
+	Token_count_map tcm;
+	File_token_counter ftc("test.txt");
+	ftc.add_to_map(tcm);
+	BOOST_REQUIRE( copyTCM == tcm );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+/*
+	The token count map itself.
+ */
+BOOST_AUTO_TEST_SUITE( Token_count_map_test_suite )
+
+BOOST_AUTO_TEST_CASE( Batched_adds_match_single_adds ) {
+	// more tokens than one batch, with repeats inside a batch
+	std::vector<std::string> words;
+	for (int k = 0; k < 1000; ++k) {
+		words.push_back("w" + std::to_string(k % 97));
+	}
+	std::vector<Token_view> tokens(words.begin(), words.end());
+	
+	Token_count_map single, batched;
+	for (auto& t : tokens) {
+		++single[t];
+	}
+	batched.add_batch(tokens.data(), tokens.size());
+	BOOST_REQUIRE( batched == single );
+	
+	Token_count_map merged { single }, mergedBatched { single };
+	for (auto& tc : single) {
+		merged[tc.first] += tc.second;
+	}
+	mergedBatched.add_batch(single.cbegin(), single.cend());
+	BOOST_REQUIRE( mergedBatched == merged );
+	BOOST_REQUIRE( mergedBatched["w0"] == 2 * single["w0"] );
+}
+
+BOOST_AUTO_TEST_CASE( Counts_past_32_bits_do_not_wrap ) {
+	Token_count_map perFile;
+	perFile.try_emplace("the", 3000000000LL);
+	perFile.try_emplace("a", 5);
+	
+	Token_count_map total;
+	total.add_batch(perFile.cbegin(), perFile.cend());
+	total.add_batch(perFile.cbegin(), perFile.cend());
+	BOOST_REQUIRE( total["the"] == 6000000000LL );
+	
+	Sorted_runs runs;
+	runs.sort(total);
+	std::ostringstream written;
+	runs.write(written);
+	BOOST_REQUIRE( written.str() == "the, 6000000000\na, 10\n" );
+	
+	Output_sorting_file osf("output.txt");
+	osf.set_sorted(total);
+	BOOST_REQUIRE( osf.cbegin()->second == 6000000000LL );
+}
+
+BOOST_AUTO_TEST_CASE( Zero_counts_can_be_dropped ) {
+	Monotonic_arena arena;
+	Token_count_map tcm { &arena };
+	for (int k = 0; k < 100; ++k) {
+		tcm.try_emplace("w" + std::to_string(k), k % 3);
+	}
+	tcm.drop_zeroes();
+	BOOST_REQUIRE( tcm.size() == 66 );
+	BOOST_REQUIRE( tcm.find("w0") == tcm.end() && tcm.find("w1")->second == 1 );
+	BOOST_REQUIRE( tcm.cbegin()->first == "w1" ); // in their order
+	BOOST_REQUIRE( tcm.resource() == &arena );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/*
+	N-gram counting.
+ */
+BOOST_AUTO_TEST_SUITE( Ngram_count_map_test_suite )
+
+/**
+ Finds the count of an n-gram by its text, 0 if not counted.
+ */
+int ngram_count(const Ngram_count_map& ncm, const std::string& text) {
+	for (auto i = ncm.cbegin(); i != ncm.cend(); ++i) {
+		if (ncm.text_of(i) == text) {
+			return i->second;
+		}
+	}
+	return 0;
+}
+
+BOOST_AUTO_TEST_CASE( Bigrams_run_across_read_blocks ) {
+	// well over one read block, so many bigrams straddle a block boundary
+	std::string text;
+	for (int k = 0; k < 20000; ++k) {
+		text += "Alpha, beta\n";
+	}
+	Ngram_count_map bigrams { 2 };
+	std::vector<char> buffer;
+	add_text_to_map(text, bigrams, buffer);
+	BOOST_REQUIRE( bigrams.size() == 2 );
+	BOOST_REQUIRE( ngram_count(bigrams, "alpha beta") == 20000 );
+	BOOST_REQUIRE( ngram_count(bigrams, "beta alpha") == 19999 );
+	BOOST_REQUIRE( bigrams.vocabulary().size() == 2 );
+}
+
+BOOST_AUTO_TEST_CASE( Merged_maps_translate_token_ids ) {
+	std::vector<char> buffer;
+	Ngram_count_map first { 3 }, second { 3 };
+	add_text_to_map("a b c d", first, buffer);
+	add_text_to_map("d c b a b c d", second, buffer); // different ids for the same tokens
+	first.add_map(second);
+	BOOST_REQUIRE( ngram_count(first, "a b c") == 2 );
+	BOOST_REQUIRE( ngram_count(first, "b c d") == 2 );
+	BOOST_REQUIRE( ngram_count(first, "d c b") == 1 );
+	BOOST_REQUIRE( first.size() == 5 );
+	
+	Ngram_count_map bigrams { 2 };
+	BOOST_CHECK_THROW( bigrams.add_map(first), std::invalid_argument );
+	BOOST_CHECK_THROW( Ngram_count_map { 0 }, std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_CASE( Ngrams_do_not_span_inputs ) {
+	Counter counter;
+	counter.set_ngram_size(2);
+	counter.set_schedule_policy(parallel_policy());
+	std::vector<Token_view> texts { "This is only a test.", "A *very* short test!" };
+	Count_result serial = counter.count_texts({ texts[0] }); // one task, so counted serially
+	BOOST_REQUIRE( serial.unique_token_count() == 4 );
+	Count_result result = counter.count_texts(texts); // counted concurrently
+	BOOST_REQUIRE( result.unique_token_count() == 7 ); // no "test a" between the texts
+	BOOST_REQUIRE( result.token_total == 7 );
+	BOOST_REQUIRE( result.tokens.front().first == "a test" );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/*
+	Early pruning: stopwords and minimum counts.
+ */
+BOOST_AUTO_TEST_SUITE( Pruning_test_suite )
+
+BOOST_AUTO_TEST_CASE( Stopword_set_finds_exactly_its_words ) {
+	std::vector<std::string> words;
+	for (int k = 0; k < 1000; ++k) {
+		words.push_back("stop" + std::to_string(k));
+	}
+	words.push_back("The,"); // cleaned like a token
+	words.push_back("the"); // duplicate once cleaned
+	Stopword_set stopwords { words };
+	BOOST_REQUIRE( stopwords.size() == 1001 );
+	for (int k = 0; k < 1000; ++k) {
+		BOOST_REQUIRE( stopwords.contains("stop" + std::to_string(k)) );
+		BOOST_REQUIRE( !stopwords.contains("go" + std::to_string(k)) );
+	}
+	BOOST_REQUIRE( stopwords.contains("the") );
+	BOOST_REQUIRE( !stopwords.contains("") );
+	BOOST_REQUIRE( !Stopword_set {}.contains("the") );
+}
+
+BOOST_AUTO_TEST_CASE( Stopwords_and_rare_tokens_are_left_out ) {
+	Counter counter;
+	counter.set_stopwords(Stopword_set { { "a", "is" } });
+	counter.set_min_count(2);
+	std::vector<Token_view> texts { "This is only a test.", "A *very* short test!" };
+	Count_result result = counter.count_texts({ texts[0] });
+	BOOST_REQUIRE( result.tokens.empty() ); // every token left is seen once
+	BOOST_REQUIRE( result.token_total == 3 ); // "this", "only", "test"
+	
+	result = counter.count_texts(texts);
+	BOOST_REQUIRE( result.token_total == 6 );
+	BOOST_REQUIRE( result.tokens.size() == 1 );
+	BOOST_REQUIRE( result.tokens.front() == Output_sorting_file::Token_count("test", 2) );
+	
+	// a threshold past 32 bits is kept whole, not wrapped around
+	counter.set_min_count(Count { 1 } << 32);
+	result = counter.count_texts(texts);
+	BOOST_REQUIRE( result.tokens.empty() && result.token_total == 6 );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 
@@ -384,3 +806,824 @@ BOOST_AUTO_TEST_CASE( Concurrent_token_counting ) {
 
 BOOST_AUTO_TEST_SUITE_END()
 
+
+
+/* INDEPENDENT COUNTER AND SERVER TESTS */
+BOOST_AUTO_TEST_SUITE( Counter_jobs_test_suite )
+
+BOOST_AUTO_TEST_CASE( Pooled_jobs_match_serial_count_and_reuse_arenas ) {
+	Thread_pool pool { 2 };
+	Arena_pool arenas;
+	
+	Counter serial { "input2.txt", "output3.txt" };
+	unsigned long expected = serial.count_tokens();
+	
+	for (int job = 0; job < 3; ++job) {
+		Counter pooled { "input2.txt", "output3.txt", &pool, &arenas };
+		BOOST_REQUIRE( pooled.concurrent_count_tokens() == expected );
+	}
+	// the arenas of the first job were reused by the later ones
+	Input_file_list ifl("input2.txt");
+	BOOST_REQUIRE( arenas.arena_count() <= ifl.file_count() );
+}
+
+BOOST_AUTO_TEST_CASE( Server_runs_jobs_over_its_socket ) {
+	Count_server server { "counter_test.sock", 2 };
+	std::thread serving { &Count_server::run, &server };
+	
+	int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	std::strncpy(address.sun_path, "counter_test.sock", sizeof(address.sun_path) - 1);
+	BOOST_REQUIRE( ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 );
+	
+	auto request = [fd](const std::string& line) {
+		std::string sent = line + "\n";
+		BOOST_REQUIRE( ::write(fd, sent.data(), sent.size()) == static_cast<ssize_t>(sent.size()) );
+		std::string reply;
+		char c;
+		while (::read(fd, &c, 1) == 1 && c != '\n') {
+			reply += c;
+		}
+		return reply;
+	};
+	
+	// a client hanging up before its reply doesn't take the process down with SIGPIPE;
+	// it is served while the requests below are
+	int gone = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	BOOST_REQUIRE( ::connect(gone, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 );
+	const std::string abandoned = "stream\tinput2.txt\tabandoned_output.txt\n";
+	BOOST_REQUIRE( ::write(gone, abandoned.data(), abandoned.size()) == static_cast<ssize_t>(abandoned.size()) );
+	::close(gone);
+	
+	Counter reference { "input2.txt", "output3.txt" };
+	unsigned long expected = reference.count_tokens();
+	
+	BOOST_REQUIRE( request("count\tinput2.txt\toutput4.txt") == "OK " + std::to_string(expected) );
+	BOOST_REQUIRE( request("count\tbogus_file.txt\toutput4.txt").compare(0, 5, "ERROR") == 0 );
+	BOOST_REQUIRE( request("shutdown") == "OK" );
+	::close(fd);
+	serving.join(); // after every connection, the abandoned one too
+	struct sigaction pipeAction;
+	BOOST_REQUIRE( ::sigaction(SIGPIPE, nullptr, &pipeAction) == 0 );
+	BOOST_REQUIRE( pipeAction.sa_handler == SIG_DFL ); // left as it was
+	std::remove("abandoned_output.txt");
+	
+	std::ifstream output_file ("output4.txt");
+	unsigned long line_count = 0;
+	std::string line;
+	while ( getline(output_file, line)) {
+		line_count++;
+	}
+	BOOST_REQUIRE( line_count == expected );
+}
+
+BOOST_AUTO_TEST_CASE( Library_counter_is_reusable_and_matches_file_counting ) {
+	Counter reference { "input2.txt", "output3.txt" };
+	unsigned long expected = reference.count_tokens();
+	
+	Counter library;
+	Count_result first = library.count_file_list("input2.txt");
+	BOOST_REQUIRE( first.unique_token_count() == expected );
+	Count_result again = library.count_file_list("input2.txt");
+	BOOST_REQUIRE( again.tokens == first.tokens );
+	BOOST_REQUIRE( again.token_total == first.token_total );
+	
+	// counting the same files as in-memory texts gives the same result
+	Input_file_list ifl("input2.txt");
+	std::vector<std::string> contents;
+	for (auto& filename : ifl) {
+		std::ifstream file { filename };
+		std::stringstream text;
+		text << file.rdbuf();
+		contents.push_back(text.str());
+	}
+	std::vector<Token_view> texts(contents.cbegin(), contents.cend());
+	Count_result fromTexts = library.count_texts(texts);
+	BOOST_REQUIRE( fromTexts.tokens == first.tokens );
+	
+	std::ostringstream written;
+	fromTexts.write_to_output(written);
+	reference.generate_output();
+	std::ostringstream expectedOutput;
+	reference.result_to_output(expectedOutput);
+	BOOST_REQUIRE( written.str() == expectedOutput.str() );
+	
+	Counter noFiles;
+	BOOST_CHECK_THROW( noFiles.count_tokens(), std::logic_error );
+}
+
+BOOST_AUTO_TEST_CASE( Node_pools_count_like_one_task_per_file ) {
+	BOOST_REQUIRE( parse_cpu_list("0-2,5,7-8") == (std::vector<unsigned> { 0, 1, 2, 5, 7, 8 }) );
+	BOOST_REQUIRE( Cpu_topology::detect().cpu_count() > 0 );
+	
+	Counter reference;
+	Count_result expected = reference.count_file_list("input2.txt");
+	
+	// two nodes sharing CPU 0, so the reduction across nodes runs on any machine
+	Node_pools nodes { Cpu_topology { { { 0 }, { 0 }, {} } } };
+	BOOST_REQUIRE( nodes.node_count() == 2 );
+	Counter counter;
+	counter.set_node_pools(&nodes);
+	counter.set_schedule_policy(parallel_policy());
+	Count_result result = counter.count_file_list("input2.txt");
+	BOOST_REQUIRE( result.tokens == expected.tokens );
+	BOOST_REQUIRE( result.token_total == expected.token_total );
+	std::vector<Token_view> texts { "a b b", "B c", "c c a", "d" };
+	BOOST_REQUIRE( counter.count_texts(texts).tokens == reference.count_texts(texts).tokens );
+}
+
+BOOST_AUTO_TEST_CASE( Memory_profile_reports_each_stage_and_worker ) {
+	Counter reference;
+	Count_result expected = reference.count_file_list("input2.txt");
+	BOOST_CHECK_THROW( reference.memory_profile(), std::logic_error );
+	
+	Counter counter;
+	counter.set_memory_profiling(true);
+	counter.set_schedule_policy(parallel_policy());
+	Count_result result = counter.count_file_list("input2.txt");
+	BOOST_REQUIRE( result.tokens == expected.tokens );
+	
+	Input_file_list ifl("input2.txt");
+	auto& records = counter.memory_profile().records();
+	BOOST_REQUIRE( records.size() == ifl.file_count() + 3 ); // a worker per file, then the stages
+	for (std::size_t r = 0; r < ifl.file_count(); ++r) {
+		BOOST_REQUIRE( records[r].name.compare(0, 10, "tokenize: ") == 0 );
+		BOOST_REQUIRE( records[r].allocation.peak_bytes > 0 );
+		BOOST_REQUIRE( records[r].load_factor > 0 && records[r].load_factor < 1 );
+	}
+	auto& merge = records[ifl.file_count() + 1];
+	BOOST_REQUIRE( merge.name == "merge" );
+	BOOST_REQUIRE( merge.entries == result.unique_token_count() );
+	BOOST_REQUIRE( merge.allocation.live_bytes > 0 );
+	BOOST_REQUIRE( merge.allocation.peak_bytes >= merge.allocation.live_bytes );
+	BOOST_REQUIRE( records.back().name == "sort" );
+	
+	std::ostringstream written;
+	counter.write_memory_profile(written);
+	BOOST_REQUIRE( written.str().compare(0, 6, "stage\t") == 0 );
+	
+	counter.set_memory_profiling(false);
+	BOOST_REQUIRE( counter.count_file_list("input2.txt").tokens == expected.tokens );
+}
+
+BOOST_AUTO_TEST_CASE( Deduplicated_inputs_count_exactly_the_same ) {
+	{
+		std::ofstream copy { "dedup_copy.txt" };
+		copy << "This is only a test. A *very* short test!";
+		std::ofstream sameSize { "dedup_same_size.txt" };
+		sameSize << "This is only a test. A *very* short text!";
+	}
+	std::vector<std::string> files { "test.txt", "./test.txt", "dedup_copy.txt", "test2.txt",
+		"dedup_same_size.txt", "test.txt" };
+	auto distinct = deduplicate_inputs(files);
+	BOOST_REQUIRE( distinct.size() == 3 );
+	BOOST_REQUIRE( distinct[0].filename == "test.txt" && distinct[0].copies == 4 );
+	BOOST_REQUIRE( distinct[1].filename == "test2.txt" && distinct[1].copies == 1 );
+	BOOST_REQUIRE( distinct[2].filename == "dedup_same_size.txt" && distinct[2].copies == 1 );
+	
+	Counter plain;
+	Count_result expected = plain.count_files(files);
+	Counter dedup;
+	dedup.set_deduplication(true);
+	Count_result result = dedup.count_files(files);
+	BOOST_REQUIRE( result.tokens == expected.tokens );
+	BOOST_REQUIRE( result.token_total == expected.token_total );
+	
+	plain.set_ngram_size(2);
+	dedup.set_ngram_size(2);
+	BOOST_REQUIRE( dedup.count_files(files).tokens == plain.count_files(files).tokens );
+	
+	// the serial path, through an input list
+	{
+		std::ofstream list { "dedup_input.txt" };
+		for (auto& f : files) {
+			list << f << std::endl;
+		}
+	}
+	Counter serial { "dedup_input.txt", "dedup_output.txt" };
+	serial.set_deduplication(true);
+	serial.count_tokens();
+	serial.generate_output();
+	std::ostringstream written, expectedOutput;
+	serial.result_to_output(written);
+	expected.write_to_output(expectedOutput);
+	BOOST_REQUIRE( written.str() == expectedOutput.str() );
+	
+	// counts that can't be deduplicated say so, rather than run without it
+	dedup.set_ngram_size(1);
+	dedup.collect_document_stats(true);
+	BOOST_REQUIRE_THROW( dedup.count_files(files), std::logic_error );
+	serial.collect_document_stats(true);
+	BOOST_REQUIRE_THROW( serial.count_tokens(), std::logic_error );
+	dedup.collect_document_stats(false);
+	dedup.set_sampling(0.5);
+	BOOST_REQUIRE_THROW( dedup.count_files(files), std::logic_error );
+	dedup.set_sampling(0);
+	dedup.set_fingerprinting(true);
+	BOOST_REQUIRE_THROW( dedup.count_files(files), std::logic_error );
+}
+
+BOOST_AUTO_TEST_CASE( Tracked_leaders_stay_the_top_k ) {
+	// counts only grow, so offering each grown count keeps exactly the top K
+	const std::size_t k = 4;
+	Count_tracker tracker { k };
+	Token_count_map counts;
+	unsigned state = 7;
+	for (int step = 0; step < 2000; ++step) {
+		state = state * 1103515245u + 12345u;
+		std::string token = "t" + std::to_string((state >> 16) % 25);
+		Count& count = counts[token];
+		count += 1 + (state >> 8) % 3;
+		tracker.offer(token, count);
+		
+		std::vector<Output_sorting_file::Token_count> all;
+		for (auto& tc : counts) {
+			all.emplace_back(tc.first.str(), tc.second);
+		}
+		std::sort(all.begin(), all.end(), Output_sorting_file::TC_compare());
+		all.resize(std::min(all.size(), k));
+		BOOST_REQUIRE( tracker.leaders() == all );
+	}
+	BOOST_REQUIRE( Count_tracker { 0 }.leaders().empty() );
+}
+
+BOOST_AUTO_TEST_CASE( Async_execute_reports_progress_and_cancels ) {
+	std::vector<std::string> files { "test.txt", "test2.txt", "test.txt" };
+	{
+		std::ofstream list { "async_input.txt" };
+		for (auto& f : files) {
+			list << f << std::endl;
+		}
+	}
+	Counter plain;
+	Count_result expected = plain.count_files(files);
+	
+	Counter counter { "async_input.txt", "async_output.txt" };
+	Count_job job = counter.execute_async(3);
+	job.get();
+	BOOST_REQUIRE( job.finished() );
+	Count_progress progress = job.progress();
+	BOOST_REQUIRE( progress.counted );
+	BOOST_REQUIRE( progress.files_done == 3 && progress.file_count == 3 );
+	BOOST_REQUIRE( progress.bytes_done > 0 && progress.bytes_done == progress.byte_count );
+	BOOST_REQUIRE( job.snapshot() == std::vector<Output_sorting_file::Token_count>(expected.tokens.begin(), expected.tokens.begin() + 3) );
+	std::ostringstream written, expectedOutput;
+	counter.result_to_output(written);
+	expected.write_to_output(expectedOutput);
+	BOOST_REQUIRE( written.str() == expectedOutput.str() );
+	
+	// n-grams are tracked too
+	counter.set_ngram_size(2);
+	Count_job ngramJob = counter.execute_async(2);
+	ngramJob.get();
+	plain.set_ngram_size(2);
+	Count_result ngrams = plain.count_files(files);
+	BOOST_REQUIRE( ngramJob.snapshot() == std::vector<Output_sorting_file::Token_count>(ngrams.tokens.begin(), ngrams.tokens.begin() + 2) );
+	
+	// hold the pool's only thread, so the job's inputs wait until it has been cancelled
+	Thread_pool pool { 1 };
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	auto blocker = pool.async([released]() { released.wait(); });
+	Counter held { "async_input.txt", "async_output.txt", &pool };
+	Count_job cancelled = held.execute_async();
+	cancelled.cancel();
+	release.set_value();
+	BOOST_REQUIRE_THROW( cancelled.get(), Count_cancelled );
+	BOOST_REQUIRE( cancelled.progress().files_done == 0 ); // skipped, not counted
+	BOOST_REQUIRE( !cancelled.progress().counted );
+	blocker.get();
+}
+
+BOOST_AUTO_TEST_CASE( Token_id_output_reproduces_each_file ) {
+	std::vector<std::string> files { "test.txt", "test2.txt", "test.txt" };
+	Counter counter;
+	counter.set_token_id_output("token_ids");
+	Count_result result = counter.count_files(files);
+	
+	// the vocabulary is the output order
+	std::ifstream vocabularyFile { vocabulary_file_name("token_ids") };
+	std::vector<std::string> vocabulary;
+	std::string token;
+	while (std::getline(vocabularyFile, token)) {
+		vocabulary.push_back(token);
+	}
+	BOOST_REQUIRE( vocabulary.size() == result.tokens.size() );
+	for (std::size_t id = 0; id < vocabulary.size(); ++id) {
+		BOOST_REQUIRE( vocabulary[id] == result.tokens[id].first );
+	}
+	
+	// each file decodes to its own tokens, in order
+	for (std::size_t f = 0; f < files.size(); ++f) {
+		Token_count_map counts;
+		std::vector<std::uint32_t> positions;
+		File_token_counter ftc { files[f] };
+		ftc.add_to_map(counts, positions);
+		auto ids = read_id_file(id_file_name("token_ids", f));
+		BOOST_REQUIRE( ids.size() == positions.size() );
+		for (std::size_t k = 0; k < ids.size(); ++k) {
+			BOOST_REQUIRE( vocabulary.at(ids[k]) == counts.cbegin()[positions[k]].first.str() );
+		}
+	}
+	
+	// IDs past one byte round trip
+	{
+		Id_file_writer writer { "token_ids/wide.ids" };
+		for (std::uint32_t id : { 0u, 127u, 128u, 16383u, 16384u, 4294967295u }) {
+			writer.put(id);
+		}
+	}
+	BOOST_REQUIRE( read_id_file("token_ids/wide.ids") == std::vector<std::uint32_t>({ 0u, 127u, 128u, 16383u, 16384u, 4294967295u }) );
+	{
+		std::ofstream cut { "token_ids/cut.ids", std::ios::binary };
+		cut << '\x05' << '\x80';
+		std::ofstream wider { "token_ids/wider.ids", std::ios::binary };
+		wider << "\xff\xff\xff\xff\x1f";
+	}
+	BOOST_REQUIRE_THROW( read_id_file("token_ids/cut.ids"), std::invalid_argument );
+	BOOST_REQUIRE_THROW( read_id_file("token_ids/wider.ids"), std::invalid_argument );
+	
+	// varints hold 64 bits, and no more
+	std::string bytes;
+	append_varint(bytes, UINT64_MAX);
+	BOOST_REQUIRE( bytes.size() == max_varint_bytes );
+	auto p = reinterpret_cast<const unsigned char*>(bytes.data());
+	std::uint64_t value;
+	BOOST_REQUIRE( read_varint(p, p + bytes.size(), value) && value == UINT64_MAX );
+	bytes.back() = '\x02';
+	p = reinterpret_cast<const unsigned char*>(bytes.data());
+	BOOST_REQUIRE( !read_varint(p, p + bytes.size(), value) );
+	
+	// the spilled streams are gone, after a count and after a failed one
+	BOOST_REQUIRE( ::access(spill_file_name("token_ids", 0).c_str(), F_OK) != 0 );
+	BOOST_REQUIRE_THROW( counter.count_files({ "test.txt", "no_such_file.txt", "test2.txt" }), std::invalid_argument );
+	for (std::size_t k = 0; k < files.size(); ++k) {
+		BOOST_REQUIRE( ::access(spill_file_name("token_ids", k).c_str(), F_OK) != 0 );
+	}
+	
+	counter.set_ngram_size(2);
+	BOOST_REQUIRE_THROW( counter.count_files(files), std::logic_error );
+}
+
+BOOST_AUTO_TEST_CASE( Document_stats_are_collected_while_merging ) {
+	Counter counter;
+	counter.collect_document_stats(true, true);
+	counter.set_schedule_policy(parallel_policy());
+	std::vector<Token_view> texts { "A b b.", "b C", "a" };
+	Count_result result = counter.count_texts(texts);
+	BOOST_REQUIRE( result.token_total == 6 );
+	
+	const Document_stats& stats = counter.document_stats();
+	BOOST_REQUIRE( stats.document_count() == 3 );
+	std::ostringstream df, postings;
+	counter.write_document_frequencies(df);
+	counter.write_postings(postings);
+	BOOST_REQUIRE( df.str() == "a, 2\nb, 2\nc, 1\n" );
+	// IDs are lines of the document frequency output
+	BOOST_REQUIRE( postings.str() == "0\t0:1 1:2\n1\t1:1 2:1\n2\t0:1\n" );
+	
+	// the serial path (a single task) gives the same statistics
+	counter.count_texts({ texts[0] });
+	BOOST_REQUIRE( counter.document_stats().document_count() == 1 );
+	BOOST_REQUIRE( counter.document_stats().document_frequency(0) == 1 );
+	
+	counter.set_ngram_size(2);
+	BOOST_CHECK_THROW( counter.count_texts(texts), std::logic_error );
+}
+
+BOOST_AUTO_TEST_CASE( Watch_counter_follows_appends_rewrites_and_deletes ) {
+	{
+		std::ofstream list { "watch_input.txt" };
+		list << "watched_log.txt" << std::endl;
+		std::ofstream log { "watched_log.txt" };
+		log << "Alpha beta\n";
+	}
+	auto count_of = [](const Watch_counter& w, const char* token) {
+		auto i = w.counts().find(token);
+		return i == w.counts().end() ? 0 : i->second;
+	};
+	
+	Watch_counter watcher { "watch_input.txt", "watch_output.txt", std::chrono::hours { 1 } };
+	BOOST_REQUIRE( count_of(watcher, "alpha") == 1 );
+	
+	{
+		std::ofstream log { "watched_log.txt", std::ios::app };
+		log << "gamma alp"; // the last token is still being written
+	}
+	BOOST_REQUIRE( watcher.refresh() );
+	BOOST_REQUIRE( count_of(watcher, "gamma") == 1 );
+	BOOST_REQUIRE( count_of(watcher, "alp") == 0 );
+	{
+		std::ofstream log { "watched_log.txt", std::ios::app };
+		log << "ha\n";
+	}
+	watcher.refresh();
+	BOOST_REQUIRE( count_of(watcher, "alpha") == 2 );
+	BOOST_REQUIRE( count_of(watcher, "beta") == 1 );
+	
+	{
+		std::ofstream log { "watched_log.txt" }; // rewritten, shorter
+		log << "delta\n";
+	}
+	watcher.refresh();
+	BOOST_REQUIRE( count_of(watcher, "delta") == 1 );
+	BOOST_REQUIRE( count_of(watcher, "alpha") == 0 );
+	BOOST_REQUIRE( watcher.counts().size() == 1 );
+	
+	std::remove("watched_log.txt");
+	watcher.refresh();
+	BOOST_REQUIRE( watcher.counts().empty() );
+	BOOST_REQUIRE( watcher.present_file_count() == 0 );
+	std::ifstream output { "watch_output.txt" };
+	std::string line;
+	BOOST_REQUIRE( !std::getline(output, line) );
+}
+
+BOOST_AUTO_TEST_CASE( Token_index_answers_lookups_and_prefix_queries ) {
+	Token_count_map tcm;
+	for (int t = 0; t < 5000; ++t) {
+		tcm.try_emplace("w" + std::to_string(t * 37 % 5000), 1 + t * 7919LL % 101);
+	}
+	tcm.try_emplace("wa", 5);
+	write_token_index("test_index.idx", tcm);
+	Token_index index { "test_index.idx" };
+	BOOST_REQUIRE( index.size() == tcm.size() );
+	for (auto& tc : tcm) {
+		BOOST_REQUIRE( index.count(tc.first) == tc.second );
+	}
+	for (const char* absent : { "", "a", "w", "w5000", "w12a", "zzz" }) {
+		BOOST_REQUIRE( index.count(absent) == 0 );
+	}
+	
+	// against the brute force answers
+	using Token_count = Output_sorting_file::Token_count;
+	std::vector<Token_count> all;
+	for (auto& tc : tcm) {
+		all.emplace_back(tc.first.str(), tc.second);
+	}
+	std::sort(all.begin(), all.end());
+	for (const char* prefix : { "w1", "w49", "w4999", "wa", "x", "" }) {
+		std::vector<Token_count> matches;
+		for (auto& tc : all) {
+			if (tc.first.compare(0, std::strlen(prefix), prefix) == 0) {
+				matches.push_back(tc);
+			}
+		}
+		BOOST_REQUIRE( index.with_prefix(prefix, matches.size() + 1) == matches );
+		if (matches.size() > 3) {
+			BOOST_REQUIRE( index.with_prefix(prefix, 3) == std::vector<Token_count>(matches.begin(), matches.begin() + 3) );
+		}
+		std::sort(matches.begin(), matches.end(), Output_sorting_file::TC_compare());
+		matches.resize(std::min<std::size_t>(matches.size(), 7));
+		BOOST_REQUIRE( index.top_with_prefix(prefix, 7) == matches );
+	}
+	
+	// the same through Counter, which leaves out what the minimum count prunes
+	Counter counter;
+	counter.set_min_count(2);
+	counter.count_texts({ "b a b c b a", "d" });
+	counter.write_index("test_index.idx");
+	Token_index small { "test_index.idx" };
+	BOOST_REQUIRE( small.size() == 2 );
+	BOOST_REQUIRE( small.top_with_prefix("", 5) == std::vector<Token_count>({ { "b", 3 }, { "a", 2 } }) );
+	BOOST_REQUIRE( small.count("c") == 0 );
+	
+	write_token_index("test_index.idx", Token_count_map {});
+	Token_index empty { "test_index.idx" };
+	BOOST_REQUIRE( empty.count("a") == 0 && empty.with_prefix("", 5).empty() && empty.top_with_prefix("", 5).empty() );
+	BOOST_REQUIRE_THROW( Token_index { "test.txt" }, std::invalid_argument );
+	std::remove("test_index.idx");
+	counter.set_ngram_size(2);
+	BOOST_REQUIRE_THROW( counter.write_index("test_index.idx"), std::logic_error );
+}
+
+BOOST_AUTO_TEST_CASE( Shards_split_a_count_by_files_or_by_tokens ) {
+	BOOST_REQUIRE( assign_to_shards({ 5, 30, 10, 20, 10 }, 2) == std::vector<unsigned>({ 1, 0, 1, 1, 0 }) );
+	BOOST_REQUIRE( parse_shard("2/3").index() == 2 && parse_shard("2/3").count() == 3 );
+	BOOST_REQUIRE_THROW( parse_shard("3/3"), std::invalid_argument );
+	BOOST_REQUIRE_THROW( parse_shard("1"), std::invalid_argument );
+	
+	{
+		std::ofstream list { "shard_input.txt" };
+		list << "test.txt" << std::endl << "test2.txt" << std::endl << "test3.txt" << std::endl << "test.txt" << std::endl;
+	}
+	Counter whole { "shard_input.txt", "shard_output.txt" };
+	unsigned long unique = whole.concurrent_count_tokens();
+	whole.generate_output();
+	auto contents = [](const char* fileName) {
+		std::ifstream file { fileName };
+		return std::string { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	};
+	for (auto mode : { Shard_mode::files, Shard_mode::tokens }) {
+		std::vector<std::string> outputs;
+		for (unsigned s = 0; s < 3; ++s) {
+			outputs.push_back(shard_file_name("shard_output.txt", Shard { s, 3 }));
+			Counter part { "shard_input.txt", outputs.back() };
+			part.set_shard(Shard { s, 3 }, mode);
+			part.execute();
+		}
+		BOOST_REQUIRE( merge_shard_outputs(outputs, "shard_merged.txt", mode) == unique );
+		BOOST_REQUIRE( contents("shard_merged.txt") == contents("shard_output.txt") );
+		for (auto& output : outputs) {
+			std::remove(output.c_str());
+		}
+	}
+	
+	// n-grams by tokens go by their first token, so the shards' n-grams are disjoint too
+	std::vector<Token_view> texts { "a b c a b d b c a", "c a b" };
+	Counter all;
+	all.set_ngram_size(2);
+	auto expected = all.count_texts(texts).tokens;
+	std::vector<Output_sorting_file::Token_count> joined;
+	for (unsigned s = 0; s < 3; ++s) {
+		Counter part;
+		part.set_ngram_size(2);
+		part.set_shard(Shard { s, 3 }, Shard_mode::tokens);
+		auto tokens = part.count_texts(texts).tokens;
+		joined.insert(joined.end(), tokens.begin(), tokens.end());
+	}
+	std::sort(joined.begin(), joined.end(), Output_sorting_file::TC_compare());
+	BOOST_REQUIRE( joined == expected );
+	BOOST_REQUIRE_THROW( all.set_shard(Shard { 0, 2 }, Shard_mode::files), std::logic_error );
+	std::remove("shard_input.txt");
+	std::remove("shard_output.txt");
+	std::remove("shard_merged.txt");
+}
+
+BOOST_AUTO_TEST_CASE( Checkpointed_counts_resume_where_they_stopped ) {
+	std::remove("test_checkpoint.snap");
+	Counter first;
+	first.set_checkpointing("test_checkpoint.snap", std::chrono::milliseconds { 0 });
+	Count_result partial = first.count_files({ "test.txt", "test2.txt" });
+	Checkpoint_progress progress;
+	Token_count_map saved;
+	BOOST_REQUIRE( read_checkpoint("test_checkpoint.snap", progress, saved) );
+	BOOST_REQUIRE( progress.inputs_done == 2 && saved.size() == partial.unique_token_count() );
+	for (auto& tc : partial.tokens) {
+		BOOST_REQUIRE( saved.find(tc.first)->second == tc.second );
+	}
+	
+	// as if the count of the longer list had died after its first two files
+	std::vector<std::string> files { "test.txt", "test2.txt", "test3.txt", "test.txt" };
+	Counter plain;
+	Count_result expected = plain.count_files(files);
+	Counter resumed;
+	resumed.set_checkpointing("test_checkpoint.snap", std::chrono::milliseconds { 0 }, true);
+	BOOST_REQUIRE( resumed.count_files(files).tokens == expected.tokens );
+	saved.clear();
+	BOOST_REQUIRE( read_checkpoint("test_checkpoint.snap", progress, saved) && progress.inputs_done == 4 );
+	
+	BOOST_REQUIRE_THROW( resumed.count_files({ "test2.txt", "test.txt", "test3.txt", "test.txt" }), std::invalid_argument );
+	std::remove("test_checkpoint.snap");
+	Checkpoint_progress none;
+	BOOST_REQUIRE( !read_checkpoint("test_checkpoint.snap", none, saved) && none.inputs_done == 0 );
+	BOOST_REQUIRE_THROW( read_checkpoint("test.txt", none, saved), std::invalid_argument );
+	resumed.set_ngram_size(2);
+	BOOST_REQUIRE_THROW( resumed.count_files(files), std::logic_error );
+	
+	// a snapshot that can't replace its file leaves no temporary behind
+	::mkdir("test_checkpoint_dir", 0755);
+	{
+		std::ofstream inside { "test_checkpoint_dir/keep.txt" };
+		inside << "keep";
+	}
+	BOOST_REQUIRE_THROW( write_checkpoint("test_checkpoint_dir", progress, saved), std::system_error );
+	BOOST_REQUIRE( ::access("test_checkpoint_dir.tmp", F_OK) != 0 );
+	std::remove("test_checkpoint_dir/keep.txt");
+	::rmdir("test_checkpoint_dir");
+}
+
+BOOST_AUTO_TEST_CASE( Fingerprinted_counts_match_plain_counts ) {
+	Fingerprint_count_map fcm;
+	for (int i = 0; i < 1000; ++i) {
+		fcm.add(token_fingerprint(std::to_string(i % 100)));
+	}
+	BOOST_REQUIRE( fcm.size() == 100 && fcm.load_factor() <= 0.75 );
+	BOOST_REQUIRE( fcm.find(token_fingerprint("42"))->count == 10 );
+	BOOST_REQUIRE( !fcm.find(token_fingerprint("100")) );
+	BOOST_REQUIRE( token_fingerprint("abcdefghi") != token_fingerprint("abcdefghj") );
+
+	std::vector<std::string> files { "test.txt", "test2.txt", "test3.txt", "test.txt" };
+	for (int minCount : { 1, 2, 5 }) {
+		Counter plain;
+		plain.set_min_count(minCount);
+		Counter fingerprinted;
+		fingerprinted.set_min_count(minCount);
+		fingerprinted.set_fingerprinting(true);
+		Count_result result = fingerprinted.count_files(files);
+		BOOST_REQUIRE( result.tokens == plain.count_files(files).tokens );
+		BOOST_REQUIRE( fingerprinted.fingerprint_collisions().empty() );
+	}
+	Counter ngrams;
+	ngrams.set_fingerprinting(true);
+	ngrams.set_ngram_size(2);
+	BOOST_REQUIRE_THROW( ngrams.count_files(files), std::logic_error );
+}
+
+BOOST_AUTO_TEST_CASE( Failed_pooled_counts_leave_the_arenas_usable ) {
+	{
+		std::ofstream big { "pooled_big.txt" };
+		for (int t = 0; t < 200000; ++t) {
+			big << "word" << t * 7919LL % 50000 << ' ';
+		}
+	}
+	std::vector<std::string> files { "test.txt", "test2.txt", "pooled_big.txt", "test3.txt" };
+	std::vector<std::string> broken { "test.txt", "no_such_file.txt", "pooled_big.txt", "test2.txt", "test3.txt" };
+	Counter reference;
+	Count_result expected = reference.count_files(files);
+
+	// one worker, so the tasks after the missing file are still to run when it throws,
+	// allocating from their arenas through the profile's counting resources
+	Thread_pool pool { 1 };
+	Arena_pool arenas;
+	Counter counter { &pool, &arenas };
+	counter.set_schedule_policy(parallel_policy());
+	counter.set_memory_profiling(true);
+	for (int pass = 0; pass < 3; ++pass) {
+		counter.set_sampling(pass == 1 ? 1 : 0); // sampled, so each file is a task in list order
+		counter.set_fingerprinting(pass == 2);
+		BOOST_REQUIRE_THROW( counter.count_files(broken), std::invalid_argument );
+		Count_result result = counter.count_files(files);
+		BOOST_REQUIRE( result.unique_token_count() == expected.unique_token_count() );
+		BOOST_REQUIRE( result.tokens.front() == expected.tokens.front() );
+	}
+	std::remove("pooled_big.txt");
+}
+
+BOOST_AUTO_TEST_CASE( Schedules_follow_input_sizes ) {
+	Schedule_policy policy;
+	policy.input_cost_bytes = 0;
+	policy.small_input_bytes = 100;
+	policy.batch_bytes = 150;
+	policy.parallel_bytes = 500;
+	policy.workers = 2;
+	Count_schedule plan = plan_count({ 10, 900, 60, 60, 60, 300 }, policy);
+	BOOST_REQUIRE( plan.parallel && plan.total_bytes == 1390 );
+	BOOST_REQUIRE( plan.tasks == std::vector<std::vector<std::size_t>>({ { 1 }, { 5 }, { 0, 2, 3, 4 } }) );
+	BOOST_REQUIRE( plan.task_costs == std::vector<std::uint64_t>({ 900, 300, 190 }) );
+	BOOST_REQUIRE( plan.batched_inputs == 4 );
+	BOOST_REQUIRE( !plan_count({ 100, 200 }, policy).parallel ); // too little work
+	BOOST_REQUIRE( !plan_count({ 5000 }, policy).parallel ); // one task
+	policy.workers = 1;
+	BOOST_REQUIRE( !plan_count({ 900, 900 }, policy).parallel );
+	
+	// whatever the plan, the counts are the same
+	std::vector<std::string> files { "test.txt", "test2.txt", "test3.txt", "test.txt", "input2.txt" };
+	Counter serial;
+	Count_result expected = serial.count_files(files);
+	BOOST_REQUIRE( !serial.schedule().parallel && serial.schedule().input_count == files.size() );
+	Thread_pool pool { 2 };
+	Counter scheduled { &pool };
+	policy = Schedule_policy {};
+	policy.input_cost_bytes = 0;
+	policy.small_input_bytes = 150;
+	policy.batch_bytes = 300;
+	policy.parallel_bytes = 0;
+	scheduled.set_schedule_policy(policy);
+	BOOST_REQUIRE( scheduled.count_files(files).tokens == expected.tokens );
+	BOOST_REQUIRE( scheduled.schedule().parallel && scheduled.schedule().workers == 2 );
+	BOOST_REQUIRE( scheduled.schedule().batched_inputs > 0 );
+	std::ostringstream written;
+	scheduled.schedule().write(written);
+	BOOST_REQUIRE( written.str().compare(0, 9, "parallel ") == 0 );
+	scheduled.set_ngram_size(2);
+	serial.set_ngram_size(2);
+	BOOST_REQUIRE( scheduled.count_files(files).tokens == serial.count_files(files).tokens );
+}
+
+BOOST_AUTO_TEST_CASE( Time_window_expires_old_slices ) {
+	Time_window window { 60, 6 }; // 10 second slices
+	Token_count_map first, second;
+	first["a"] = 2;
+	first["b"] = 1;
+	second["a"] = 1;
+	BOOST_REQUIRE( window.add(1000, first) );
+	BOOST_REQUIRE( window.add(1015, second) );
+	BOOST_REQUIRE( window.counts().find("a")->second == 3 );
+	BOOST_REQUIRE( !window.advance(1059) ); // the slice from 1000 is still in the window
+	BOOST_REQUIRE( window.advance(1060) );
+	BOOST_REQUIRE( window.top(5) == std::vector<Output_sorting_file::Token_count>({ { "a", 1 } }) );
+	BOOST_REQUIRE( !window.add(1005, first) ); // too old
+	BOOST_REQUIRE( window.advance(5000) );
+	BOOST_REQUIRE( window.top(5).empty() );
+	BOOST_REQUIRE_THROW( Time_window(5, 10), std::invalid_argument );
+	
+	std::int64_t time;
+	std::size_t length;
+	BOOST_REQUIRE( parse_line_time("2024-05-01T12:30:00Z GET /", time, length) );
+	BOOST_REQUIRE( time == 1714566600 && length == 21 );
+	BOOST_REQUIRE( parse_line_time("[2024-05-01 12:30:00.250+02:00] x", time, length) );
+	BOOST_REQUIRE( time == 1714559400 && length == 32 );
+	BOOST_REQUIRE( parse_line_time("1714566600.5 x", time, length) );
+	BOOST_REQUIRE( time == 1714566600 && length == 13 );
+	BOOST_REQUIRE( !parse_line_time("2024-05-01 started", time, length) );
+	BOOST_REQUIRE( !parse_line_time("12345 x", time, length) );
+}
+
+BOOST_AUTO_TEST_CASE( Watch_counter_counts_over_a_time_window ) {
+	const long long now = static_cast<long long>(std::time(nullptr));
+	{
+		std::ofstream list { "window_input.txt" };
+		list << "window_log.txt" << std::endl;
+		std::ofstream log { "window_log.txt" };
+		log << now - 7200 << " old news\n" << now << " fresh news\n" << "no timestamp, so fresh too\n";
+	}
+	Watch_window window;
+	window.span = 3600;
+	window.line_times = true;
+	window.top_k = 1;
+	Watch_counter watcher { "window_input.txt", "window_output.txt", std::chrono::hours { 1 }, window };
+	auto& counts = watcher.counts();
+	BOOST_REQUIRE( counts.find("news")->second == 1 );
+	BOOST_REQUIRE( counts.find("fresh")->second == 2 );
+	BOOST_REQUIRE( counts.find("old") == counts.end() );
+	BOOST_REQUIRE( counts.find(std::to_string(now)) == counts.end() ); // timestamps aren't counted
+	{
+		std::ofstream log { "window_log.txt", std::ios::app };
+		log << now << " fresh"; // counted once the line is whole
+	}
+	watcher.refresh();
+	BOOST_REQUIRE( counts.find("fresh")->second == 2 );
+	{
+		std::ofstream log { "window_log.txt", std::ios::app };
+		log << "er\n";
+	}
+	watcher.refresh();
+	BOOST_REQUIRE( counts.find("fresher")->second == 1 );
+	
+	std::ifstream output { "window_output.txt" };
+	std::string line;
+	BOOST_REQUIRE( std::getline(output, line) && line == "fresh, 2" );
+	BOOST_REQUIRE( !std::getline(output, line) );
+	
+	// a line longer than a read chunk is counted, and so are the lines after it
+	{
+		std::ofstream log { "window_log.txt", std::ios::app };
+		log << now;
+		for (int w = 0; w < 300000; ++w) {
+			log << " long";
+		}
+		log << "\n" << now << " after\n";
+	}
+	watcher.refresh();
+	BOOST_REQUIRE( counts.find("long")->second == 300000 );
+	BOOST_REQUIRE( counts.find("after")->second == 1 );
+	std::remove("window_log.txt");
+}
+
+BOOST_AUTO_TEST_CASE( Sampling_estimates_counts_with_intervals ) {
+	// a file of many blocks: ten words, the first ten times as common as the last
+	{
+		std::ofstream big { "sample_big.txt" };
+		std::mt19937 rng { 7 };
+		std::discrete_distribution<int> pick { 10, 9, 8, 7, 6, 5, 4, 3, 2, 1 };
+		for (int w = 0; w < 200000; ++w) {
+			big << "word" << pick(rng) << (w % 12 == 11 ? '\n' : ' ');
+		}
+	}
+	std::vector<std::string> files { "test.txt", "sample_big.txt" };
+	Counter exact;
+	Count_result truth = exact.count_files(files);
+	BOOST_REQUIRE( !truth.estimated );
+	
+	// sampling everything is exact, though marked as estimated
+	Counter counter;
+	counter.set_sampling(1);
+	Count_result all = counter.count_files(files);
+	BOOST_REQUIRE( all.estimated );
+	BOOST_REQUIRE( all.tokens == truth.tokens );
+	std::ostringstream out;
+	all.write_to_output(out);
+	BOOST_REQUIRE( out.str().find(", ~") != std::string::npos );
+	
+	// samples of a quarter of the blocks mostly bracket the true counts of the top tokens
+	std::map<std::string, Count> truthCounts(truth.tokens.cbegin(), truth.tokens.cend());
+	int bracketed = 0;
+	for (std::uint64_t seed = 0; seed < 20; ++seed) {
+		counter.set_sampling(0.25, seed);
+		counter.count_files(files);
+		auto estimates = counter.sample_estimates(5);
+		BOOST_REQUIRE( estimates.size() == 5 );
+		for (auto& e : estimates) {
+			Count trueCount = truthCounts.at(e.token);
+			bracketed += e.low <= trueCount && trueCount <= e.high;
+			BOOST_REQUIRE( e.low <= e.estimate && e.estimate <= e.high && e.sampled < trueCount );
+		}
+	}
+	BOOST_REQUIRE( bracketed >= 85 ); // of 100, at 95% confidence
+	
+	// the same seed picks the same blocks
+	counter.set_sampling(0.25, 11);
+	Count_result quarter = counter.count_files(files);
+	BOOST_REQUIRE( counter.count_files(files).tokens == quarter.tokens );
+	
+	BOOST_REQUIRE_THROW( counter.set_sampling(1.5), std::invalid_argument );
+	counter.set_ngram_size(2);
+	BOOST_REQUIRE_THROW( counter.count_files(files), std::logic_error );
+	BOOST_REQUIRE_THROW( exact.sample_estimates(5), std::logic_error );
+	std::remove("sample_big.txt");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
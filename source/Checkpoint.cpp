@@ -0,0 +1,184 @@
+//
+//  Checkpoint.cpp
+//  counter
+//
+
+#include "Checkpoint.hpp"
+#include "Varint.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace counterLib {
+
+	namespace {
+		const char checkpoint_magic[8] = { 'C', 'N', 'T', 'C', 'K', 'P', 'T', '1' };
+
+		void append_word(std::string& bytes, std::uint64_t value) {
+			char word[sizeof(value)];
+			std::memcpy(word, &value, sizeof(value));
+			bytes.append(word, sizeof(value));
+		}
+
+		std::uint64_t read_word(const std::string& bytes, std::size_t pos) noexcept {
+			std::uint64_t value;
+			std::memcpy(&value, bytes.data() + pos, sizeof(value));
+			return value;
+		}
+
+		std::string encode(const Checkpoint_progress& progress, const Token_count_map& tcm) {
+			std::string bytes;
+			bytes.reserve(sizeof(checkpoint_magic) + 3 * sizeof(std::uint64_t) + tcm.size() * 12);
+			bytes.append(checkpoint_magic, sizeof(checkpoint_magic));
+			append_word(bytes, progress.inputs_done);
+			append_word(bytes, progress.inputs_hash);
+			append_word(bytes, tcm.size());
+			for (auto& tc : tcm) {
+				append_varint(bytes, tc.first.size());
+				bytes.append(tc.first.data(), tc.first.size());
+				append_varint(bytes, static_cast<std::uint64_t>(tc.second));
+			}
+			return bytes;
+		}
+
+		/**
+		 Writes the bytes to a temporary file, flushes it to disk and renames it to fileName.
+		 On failure the temporary file is removed and the first error is reported.
+		 */
+		void write_file(const std::string& fileName, const std::string& bytes) {
+			const std::string temporary = fileName + ".tmp";
+			int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			if (fd < 0) {
+				throw std::system_error {errno, std::generic_category(), "Checkpoint unable to open snapshot file: " + temporary};
+			}
+			int error = 0;
+			std::size_t done = 0;
+			while (done < bytes.size()) {
+				ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+				if (n < 0 && errno == EINTR) {
+					continue;
+				}
+				if (n < 0) {
+					error = errno;
+					break;
+				}
+				done += static_cast<std::size_t>(n);
+			}
+			if (error == 0 && ::fsync(fd) != 0) {
+				error = errno;
+			}
+			if (::close(fd) != 0 && error == 0) {
+				error = errno;
+			}
+			if (error != 0) {
+				::unlink(temporary.c_str());
+				throw std::system_error {error, std::generic_category(), "Checkpoint unable to write snapshot file: " + temporary};
+			}
+			if (std::rename(temporary.c_str(), fileName.c_str()) != 0) {
+				error = errno;
+				::unlink(temporary.c_str());
+				throw std::system_error {error, std::generic_category(), "Checkpoint unable to replace snapshot file: " + fileName};
+			}
+		}
+	}
+
+	void Checkpoint_progress::add_input(const std::string& name) noexcept {
+		for (char c : name) {
+			inputs_hash = (inputs_hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+		}
+		inputs_hash = (inputs_hash ^ static_cast<unsigned char>('\n')) * 1099511628211ULL;
+		++inputs_done;
+	}
+
+	void write_checkpoint(const std::string& fileName, const Checkpoint_progress& progress, const Token_count_map& tcm) {
+		write_file(fileName, encode(progress, tcm));
+	}
+
+	bool read_checkpoint(const std::string& fileName, Checkpoint_progress& progress, Token_count_map& tcm) {
+		std::ifstream file { fileName, std::ios::binary };
+		if (!file.is_open()) {
+			return false;
+		}
+		const std::string bytes { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+		const std::size_t header = sizeof(checkpoint_magic) + 3 * sizeof(std::uint64_t);
+		if (bytes.size() < header || std::memcmp(bytes.data(), checkpoint_magic, sizeof(checkpoint_magic)) != 0) {
+			throw std::invalid_argument {"Checkpoint unable to read snapshot file: " + fileName + " isn't one."};
+		}
+		Checkpoint_progress read;
+		read.inputs_done = read_word(bytes, sizeof(checkpoint_magic));
+		read.inputs_hash = read_word(bytes, sizeof(checkpoint_magic) + sizeof(std::uint64_t));
+		const std::uint64_t entryCount = read_word(bytes, sizeof(checkpoint_magic) + 2 * sizeof(std::uint64_t));
+
+		// read into a map of its own first, so a damaged file adds nothing
+		Token_count_map counts;
+		counts.reserve(static_cast<Token_count_map::size_type>(std::min<std::uint64_t>(entryCount, bytes.size())));
+		auto p = reinterpret_cast<const unsigned char*>(bytes.data()) + header;
+		const auto end = reinterpret_cast<const unsigned char*>(bytes.data()) + bytes.size();
+		for (std::uint64_t e = 0; e < entryCount; ++e) {
+			std::uint64_t length, count;
+			if (!read_varint(p, end, length) || length > static_cast<std::uint64_t>(end - p)) {
+				throw std::invalid_argument {"Checkpoint unable to read snapshot file: " + fileName + " is cut short."};
+			}
+			Token_view token { reinterpret_cast<const char*>(p), static_cast<std::size_t>(length) };
+			p += length;
+			if (!read_varint(p, end, count)) {
+				throw std::invalid_argument {"Checkpoint unable to read snapshot file: " + fileName + " is cut short."};
+			}
+			counts.try_emplace(token, static_cast<Count>(count));
+		}
+		tcm.add_batch(counts.cbegin(), counts.cend());
+		progress = read;
+		return true;
+	}
+
+	Checkpoint_writer::Checkpoint_writer(const std::string& fileName, std::chrono::milliseconds interval) :
+		_fileName { fileName },
+		_interval { interval },
+		_last { std::chrono::steady_clock::now() } { }
+
+	Checkpoint_writer::~Checkpoint_writer() {
+		if (_writing.valid()) {
+			_writing.wait();
+		}
+	}
+
+	bool Checkpoint_writer::offer(const Checkpoint_progress& progress, const Token_count_map& tcm) {
+		auto now = std::chrono::steady_clock::now();
+		if (now - _last < _interval) {
+			return false;
+		}
+		if (_writing.valid()) {
+			if (_writing.wait_for(std::chrono::seconds { 0 }) != std::future_status::ready) {
+				return false; // still writing the last one
+			}
+			_writing.get();
+		}
+		_last = now;
+		std::string bytes = encode(progress, tcm);
+		const std::string& fileName = _fileName;
+		_writing = std::async(std::launch::async, [fileName](const std::string& b) { write_file(fileName, b); }, std::move(bytes));
+		++_written;
+		return true;
+	}
+
+	void Checkpoint_writer::finish(const Checkpoint_progress& progress, const Token_count_map& tcm) {
+		wait();
+		write_checkpoint(_fileName, progress, tcm);
+		_last = std::chrono::steady_clock::now();
+		++_written;
+	}
+
+	void Checkpoint_writer::wait() {
+		if (_writing.valid()) {
+			_writing.get();
+		}
+	}
+
+}
@@ -0,0 +1,134 @@
+/**
+ *	@file Checkpoint.hpp
+ *
+ *	Snapshots of a count in progress, so that a long count that dies
+ *	can resume from its last snapshot instead of starting over.
+ */
+
+#ifndef Checkpoint_hpp
+#define Checkpoint_hpp
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <string>
+#include "Token_count_map.hpp"
+
+namespace counterLib {
+
+	/**
+	 How far a count of a list of input files has got: inputs are counted
+	 in list order, so the ones done are always the first inputs_done of the list.
+	 Their names are kept as a hash, to tell whether a snapshot belongs to a list.
+	 */
+	struct Checkpoint_progress {
+		std::uint64_t inputs_done = 0;
+		std::uint64_t inputs_hash = 14695981039346656037ULL; // FNV-1a of the names done, each ended by a newline
+
+		/**
+		 Adds the next input of the list to those done.
+
+		 @param name [IN] The input's filename, as listed.
+		 */
+		void add_input(const std::string& name) noexcept;
+	};
+
+	/**
+	 Writes a snapshot of a count: its progress and its table.
+	 The file is written under a temporary name, flushed to disk and then renamed
+	 over the old snapshot, so a crash while writing leaves the old one whole.
+	 The format is the magic "CNTCKPT1", the progress and the entry count as
+	 64-bit words (in the byte order of the machine that wrote it), then each token
+	 as a varint length, its bytes and a varint count.
+	 Throws std::system_error if it can't be written.
+
+	 @param fileName [IN] Filename (path) of the snapshot.
+	 @param progress [IN] The inputs counted.
+	 @param tcm [IN] Their counts.
+	 */
+	void write_checkpoint(const std::string& fileName, const Checkpoint_progress& progress, const Token_count_map& tcm);
+
+	/**
+	 Reads a snapshot written by write_checkpoint(), adding its counts to a map.
+	 Throws std::invalid_argument if the file isn't a snapshot.
+
+	 @param fileName [IN] Filename (path) of the snapshot.
+	 @param progress [OUT] The inputs counted.
+	 @param tcm [IN/OUT] Receives their counts.
+	 @return false, leaving both alone, if there is no such file.
+	 */
+	bool read_checkpoint(const std::string& fileName, Checkpoint_progress& progress, Token_count_map& tcm);
+
+	/**
+	 Writes snapshots of a count at intervals, in the background.
+	 A snapshot is encoded on the calling thread, one pass over the table into a buffer,
+	 and written and flushed to disk on a thread of its own, while counting goes on.
+	 A snapshot falling due while the last is still being written is skipped.
+	 */
+	class Checkpoint_writer {
+	public:
+		/**
+		 Initializing Constructor
+
+		 @param fileName [IN] Filename (path) of the snapshot.
+		 @param interval [IN] Least time between the start of one snapshot and the next.
+		 */
+		Checkpoint_writer(const std::string& fileName, std::chrono::milliseconds interval);
+
+		/**
+		 Copy constructor (deleted)
+
+		 Deleted because a write in progress can't be shared.
+		 */
+		Checkpoint_writer(const Checkpoint_writer&) = delete;
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Checkpoint_writer& operator= (const Checkpoint_writer&) = delete;
+
+		/**
+		 Destructor
+
+		 Waits for a write in progress, ignoring its errors.
+		 */
+		~Checkpoint_writer();
+
+		/**
+		 Starts writing a snapshot if one is due: the interval has passed
+		 since the last began, and the last is done. Throws the error of the last
+		 write, if it failed (see write_checkpoint()).
+
+		 @param progress [IN] The inputs counted.
+		 @param tcm [IN] Their counts. Only read before this returns.
+		 @return Whether a snapshot was started.
+		 */
+		bool offer(const Checkpoint_progress& progress, const Token_count_map& tcm);
+
+		/**
+		 Waits for a write in progress, then writes a last snapshot.
+		 Throws the error of either write, if it failed.
+
+		 @param progress [IN] The inputs counted.
+		 @param tcm [IN] Their counts.
+		 */
+		void finish(const Checkpoint_progress& progress, const Token_count_map& tcm);
+
+		/**
+		 Gets the number of snapshots written or started.
+		 */
+		std::uint64_t written() const noexcept { return _written; }
+
+	private:
+		void wait(); // for the write in progress, if any; rethrows its error
+
+		std::string _fileName;
+		std::chrono::milliseconds _interval;
+		std::chrono::steady_clock::time_point _last; // when the last snapshot began
+		std::future<void> _writing; // the write in progress, if valid
+		std::uint64_t _written = 0;
+	};
+
+}
+
+#endif /* Checkpoint_hpp */
@@ -0,0 +1,89 @@
+//
+//  Count_job.cpp
+//  counter
+//
+
+#include "Count_job.hpp"
+#include <iterator>
+
+namespace counterLib {
+
+	Count_tracker::Count_tracker(std::size_t topK) :
+		_topK { topK } { }
+
+	void Count_tracker::start(std::size_t fileCount, std::uint64_t byteCount) noexcept {
+		_byteCount = byteCount;
+		_fileCount = fileCount;
+	}
+
+	void Count_tracker::input_done(std::size_t files, std::uint64_t bytes) noexcept {
+		_bytesDone += bytes;
+		_filesDone += files;
+	}
+
+	Count_progress Count_tracker::progress() const noexcept {
+		Count_progress progress;
+		progress.files_done = _filesDone;
+		progress.file_count = _fileCount;
+		progress.bytes_done = _bytesDone;
+		progress.byte_count = _byteCount;
+		progress.counted = _counted;
+		return progress;
+	}
+
+	void Count_tracker::offer(Token_view token, Count count) {
+		if (!may_lead(count)) {
+			return;
+		}
+		Output_sorting_file::Token_count candidate { token.str(), count };
+		std::lock_guard<std::mutex> lock { _leadersMutex };
+		auto leader = _leaderCounts.find(candidate.first);
+		if (leader != _leaderCounts.end()) {
+			// a leader with a higher count: move it up
+			_leaders.erase(Output_sorting_file::Token_count { leader->first, leader->second });
+			leader->second = count;
+		}
+		else {
+			if (_leaders.size() >= _topK) {
+				auto last = std::prev(_leaders.end());
+				if (!Output_sorting_file::TC_compare()(candidate, *last)) {
+					return; // same count as the last leader, but sorted after it
+				}
+				_leaderCounts.erase(last->first);
+				_leaders.erase(last);
+			}
+			_leaderCounts.emplace(candidate.first, count);
+		}
+		_leaders.insert(std::move(candidate));
+		_lastCount = _leaders.size() >= _topK ? _leaders.rbegin()->second : 0;
+	}
+
+	std::vector<Output_sorting_file::Token_count> Count_tracker::leaders() const {
+		std::lock_guard<std::mutex> lock { _leadersMutex };
+		return std::vector<Output_sorting_file::Token_count>(_leaders.cbegin(), _leaders.cend());
+	}
+
+	Count_job::Count_job(std::shared_ptr<Count_tracker> tracker, std::future<void> done) :
+		_tracker { std::move(tracker) },
+		_done { std::move(done) } { }
+
+	Count_job::~Count_job() {
+		if (_done.valid()) {
+			_tracker->cancel();
+			_done.wait();
+		}
+	}
+
+	bool Count_job::finished() const {
+		return !_done.valid() || _done.wait_for(std::chrono::seconds { 0 }) == std::future_status::ready;
+	}
+
+	bool Count_job::wait_for(std::chrono::milliseconds timeout) const {
+		return !_done.valid() || _done.wait_for(timeout) == std::future_status::ready;
+	}
+
+	void Count_job::get() {
+		_done.get();
+	}
+
+}
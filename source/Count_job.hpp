@@ -0,0 +1,241 @@
+/**
+ *	@file Count_job.hpp
+ *
+ *	A counting job running in the background (see Counter::execute_async()):
+ *	its progress, the most frequent tokens so far, and cancellation.
+ */
+
+#ifndef Count_job_hpp
+#define Count_job_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Output_sorting_file.hpp"
+
+namespace counterLib {
+
+	/**
+	 How far a counting job has got.
+	 An input is done once its counts are merged; a deduplicated input
+	 counts once for each of its copies.
+	 */
+	struct Count_progress {
+		std::size_t files_done = 0;
+		std::size_t file_count = 0; // 0 until the job has listed its inputs
+		std::uint64_t bytes_done = 0;
+		std::uint64_t byte_count = 0; // the inputs' sizes when the job started
+		bool counted = false; // every input is counted, and the output is being (or has been) written
+	};
+
+	/**
+	 Thrown by Count_job::get() when the job was cancelled before it finished.
+	 */
+	class Count_cancelled : public std::runtime_error {
+	public:
+		Count_cancelled() : std::runtime_error {"Count_job cancelled before it finished"} { }
+	};
+
+	/**
+	 The state a counting job shares with its Count_job handle:
+	 progress figures, the cancellation request and the leaders,
+	 the K tokens (or n-grams) with the highest counts so far.
+
+	 The leaders are kept up to date as each input's counts are merged:
+	 a merged token is offered with its new total, and joins them if it beats
+	 the last of them. As counts only grow, a token that isn't a leader
+	 never has more than the last leader, so the leaders are exactly
+	 the first K lines the output would have if the job stopped there.
+	 Most tokens are turned away by one comparison, without locking;
+	 the workers tokenizing the inputs never touch the leaders at all.
+	 */
+	class Count_tracker {
+	public:
+		/**
+		 Initializing Constructor
+
+		 @param topK [IN] Number of leaders to keep. 0 keeps none.
+		 */
+		explicit Count_tracker(std::size_t topK);
+
+		/**
+		 Copy constructor (deleted)
+		 */
+		Count_tracker(const Count_tracker&) = delete;
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Count_tracker& operator= (const Count_tracker&) = delete;
+
+		/**
+		 Sets the totals the progress is measured against.
+
+		 @param fileCount [IN] Number of inputs.
+		 @param byteCount [IN] Their total size.
+		 */
+		void start(std::size_t fileCount, std::uint64_t byteCount) noexcept;
+
+		/**
+		 Records that inputs are done. Safe to call from any thread.
+
+		 @param files [IN] Number of inputs done.
+		 @param bytes [IN] Their total size.
+		 */
+		void input_done(std::size_t files, std::uint64_t bytes) noexcept;
+
+		/**
+		 Records that every input is counted.
+		 */
+		void counting_done() noexcept { _counted = true; }
+
+		/**
+		 Gets the progress so far. Safe to call from any thread.
+
+		 @return The progress.
+		 */
+		Count_progress progress() const noexcept;
+
+		void cancel() noexcept { _cancelled = true; }
+		bool cancelled() const noexcept { return _cancelled; }
+
+		/**
+		 Checks, cheaply, whether a token with the given count could be a leader,
+		 before its text is made for offer(). Called by the counting thread only.
+
+		 @param count [IN] The token's new total.
+		 @return false if the token surely isn't one.
+		 */
+		bool may_lead(Count count) const noexcept {
+			return _topK > 0 && (_leaders.size() < _topK || count >= _lastCount);
+		}
+
+		/**
+		 Offers a token whose total has grown. Called by the counting thread only.
+
+		 @param token [IN] The token (or n-gram text).
+		 @param count [IN] Its new total.
+		 */
+		void offer(Token_view token, Count count);
+
+		/**
+		 Gets the leaders. Safe to call from any thread; takes time in K,
+		 not in the number of unique tokens.
+
+		 @return Up to K tokens and their counts, sorted as the output is.
+		 */
+		std::vector<Output_sorting_file::Token_count> leaders() const;
+
+	private:
+		const std::size_t _topK;
+		std::atomic<std::size_t> _fileCount { 0 };
+		std::atomic<std::uint64_t> _byteCount { 0 };
+		std::atomic<std::size_t> _filesDone { 0 };
+		std::atomic<std::uint64_t> _bytesDone { 0 };
+		std::atomic<bool> _counted { false };
+		std::atomic<bool> _cancelled { false };
+
+		mutable std::mutex _leadersMutex; // taken to change the leaders, and by leaders()
+		std::set<Output_sorting_file::Token_count, Output_sorting_file::TC_compare> _leaders; // best first
+		std::unordered_map<std::string, Count> _leaderCounts; // each leader's count in _leaders
+		Count _lastCount = 0; // count of the last leader, once there are K
+	};
+
+	/**
+	 Handle to a counting job running in the background, made by Counter::execute_async().
+	 The job's Counter must outlive it, and mustn't be used until the job is finished.
+
+	 Destroying a handle whose job hasn't been waited for with get()
+	 cancels the job and waits for it to stop.
+	 */
+	class Count_job {
+	public:
+		/**
+		 Initializing Constructor
+
+		 @param tracker [IN] The job's shared state.
+		 @param done [IN] Future of the job itself.
+		 */
+		Count_job(std::shared_ptr<Count_tracker> tracker, std::future<void> done);
+
+		/**
+		 Move Constructor
+		 */
+		Count_job(Count_job&& other) = default;
+
+		/**
+		 Copy constructor (deleted)
+		 */
+		Count_job(const Count_job&) = delete;
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Count_job& operator= (const Count_job&) = delete;
+
+		/**
+		 Destructor
+
+		 Cancels the job, unless it has been waited for, and waits for it to stop.
+		 */
+		~Count_job();
+
+		/**
+		 Gets how far the job has got.
+
+		 @return The progress so far.
+		 */
+		Count_progress progress() const noexcept { return _tracker->progress(); }
+
+		/**
+		 Gets the most frequent tokens counted so far, without pausing the job.
+		 Inputs are merged one at a time, so the snapshot is always of whole inputs.
+
+		 @return Up to K tokens (or n-grams) and their counts, sorted as the output is.
+		 */
+		std::vector<Output_sorting_file::Token_count> snapshot() const { return _tracker->leaders(); }
+
+		/**
+		 Asks the job to stop. Inputs not yet started are skipped,
+		 those being tokenized are finished, and the job ends without writing output.
+		 Has no effect once every input is counted.
+		 */
+		void cancel() noexcept { _tracker->cancel(); }
+
+		/**
+		 Checks whether the job has ended, whether finished, failed or cancelled.
+
+		 @return true if get() wouldn't wait.
+		 */
+		bool finished() const;
+
+		/**
+		 Waits for the job to end, for at most the given time.
+
+		 @param timeout [IN] The longest to wait.
+		 @return true if the job has ended.
+		 */
+		bool wait_for(std::chrono::milliseconds timeout) const;
+
+		/**
+		 Waits for the job to end. Throws what the job threw,
+		 or Count_cancelled if it was cancelled. Call once.
+		 */
+		void get();
+
+	private:
+		std::shared_ptr<Count_tracker> _tracker;
+		std::future<void> _done;
+	};
+
+}
+
+#endif /* Count_job_hpp */
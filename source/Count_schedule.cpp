@@ -0,0 +1,103 @@
+//
+//  Count_schedule.cpp
+//  counter
+//
+
+#include "Count_schedule.hpp"
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+namespace counterLib {
+
+	Count_schedule plan_count(const std::vector<std::uint64_t>& sizes, const Schedule_policy& policy) {
+		Count_schedule schedule;
+		schedule.workers = policy.workers ? policy.workers : std::thread::hardware_concurrency();
+		if (schedule.workers == 0) {
+			schedule.workers = 1; // hardware_concurrency() may not know
+		}
+		schedule.input_count = sizes.size();
+		for (auto size : sizes) {
+			schedule.total_bytes += size;
+			schedule.total_cost += size + policy.input_cost_bytes;
+		}
+
+		// small inputs share tasks, each no costlier than a worker's share, so batching never leaves a worker idle
+		const std::uint64_t share = (schedule.total_cost + schedule.workers - 1) / schedule.workers;
+		const std::uint64_t batchLimit = std::min(policy.batch_bytes, std::max(policy.small_input_bytes, share));
+		std::vector<std::vector<std::size_t>> tasks;
+		std::vector<std::uint64_t> costs;
+		std::vector<std::size_t> batch;
+		std::uint64_t batchCost = 0;
+		for (std::size_t i = 0; i < sizes.size(); ++i) {
+			const std::uint64_t cost = sizes[i] + policy.input_cost_bytes;
+			if (cost >= policy.small_input_bytes) {
+				tasks.push_back({ i });
+				costs.push_back(cost);
+				continue;
+			}
+			batch.push_back(i);
+			batchCost += cost;
+			if (batchCost >= batchLimit) {
+				tasks.push_back(std::move(batch));
+				costs.push_back(batchCost);
+				batch.clear();
+				batchCost = 0;
+			}
+		}
+		if (!batch.empty()) {
+			tasks.push_back(std::move(batch));
+			costs.push_back(batchCost);
+		}
+		for (auto& task : tasks) {
+			schedule.batched_inputs += task.size() > 1 ? task.size() : 0;
+		}
+
+		// costliest first; ties keep list order, so a plan is the same every time
+		std::vector<std::size_t> order(tasks.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&costs](std::size_t a, std::size_t b) { return costs[a] > costs[b]; });
+		for (auto t : order) {
+			schedule.tasks.push_back(std::move(tasks[t]));
+			schedule.task_costs.push_back(costs[t]);
+		}
+
+		if (schedule.workers == 1) {
+			schedule.reason = "one worker";
+		}
+		else if (schedule.tasks.size() < 2) {
+			schedule.reason = "one task";
+		}
+		else if (schedule.total_cost < policy.parallel_bytes) {
+			schedule.reason = "cost " + std::to_string(schedule.total_cost) + " below " + std::to_string(policy.parallel_bytes);
+		}
+		else {
+			schedule.parallel = true;
+			schedule.reason = std::to_string(schedule.tasks.size()) + " tasks on " + std::to_string(schedule.workers) + " workers";
+		}
+		return schedule;
+	}
+
+	void Count_schedule::write(std::ostream& out) const {
+		out << (parallel ? "parallel" : "serial") << " (" << reason << "): " << input_count << " inputs, "
+			<< total_bytes << " bytes, " << batched_inputs << " batched" << std::endl;
+		if (!parallel) {
+			return;
+		}
+		for (std::size_t t = 0; t < tasks.size(); ++t) {
+			out << "task " << t << ": cost " << task_costs[t] << ", ";
+			if (tasks[t].size() > 1) {
+				out << tasks[t].size() << " inputs from ";
+			}
+			std::size_t first = tasks[t].front();
+			if (first < names.size()) {
+				out << names[first];
+			}
+			else {
+				out << "input " << first;
+			}
+			out << std::endl;
+		}
+	}
+
+}
@@ -0,0 +1,73 @@
+/**
+ *	@file Count_schedule.hpp
+ *
+ *	Deciding how a count's inputs are spread over threads, from their sizes:
+ *	whether to count in parallel at all, which inputs share a task, and in what order the tasks start.
+ */
+
+#ifndef Count_schedule_hpp
+#define Count_schedule_hpp
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace counterLib {
+
+	/**
+	 The figures of the cost model plan_count() follows.
+	 An input costs its size in bytes plus input_cost_bytes, for opening and starting on it.
+	 */
+	struct Schedule_policy {
+		std::uint64_t input_cost_bytes = 4 * 1024; // fixed cost of an input, in bytes of reading
+		std::uint64_t small_input_bytes = 256 * 1024; // inputs costing less share tasks
+		std::uint64_t batch_bytes = 4 * 1024 * 1024; // a task of small inputs closes once it costs this much
+		std::uint64_t parallel_bytes = 1024 * 1024; // counts costing less in all run on one thread
+		unsigned workers = 0; // threads to plan for; 0 for the pool's, or the hardware's
+	};
+
+	/**
+	 How a count is run, as decided by plan_count(): serially, or as tasks
+	 on the workers, started largest first. Inputs are known by their positions in the list.
+	 */
+	struct Count_schedule {
+		bool parallel = false;
+		unsigned workers = 1;
+		std::size_t input_count = 0;
+		std::uint64_t total_bytes = 0; // the inputs' sizes
+		std::uint64_t total_cost = 0; // and their fixed costs
+		std::vector<std::vector<std::size_t>> tasks; // inputs of each task, in list order; the costliest task first
+		std::vector<std::uint64_t> task_costs; // of each task
+		std::size_t batched_inputs = 0; // inputs sharing a task with others
+		std::string reason; // for running serially or in parallel
+		std::vector<std::string> names; // of the inputs, if given, for write()
+
+		/**
+		 Writes the decisions: a summary line, then one line per task when parallel,
+		 naming its first input (by position if there are no names).
+
+		 @param out [IN/OUT] The output stream to write to.
+		 */
+		void write(std::ostream& out) const;
+	};
+
+	/**
+	 Plans a count of inputs of the given sizes.
+	 Each input costing at least small_input_bytes gets a task of its own; smaller ones
+	 are gathered, in list order, into tasks of up to batch_bytes (and no more than a worker's
+	 share of the whole), so a list of many tiny files doesn't start a task per file.
+	 The tasks are then ordered costliest first, so that with workers taking them in order
+	 (longest processing time first) a big input starts early instead of straggling at the end.
+	 The count runs serially if there is one worker or one task, or if it costs less
+	 than parallel_bytes in all, where starting tasks and merging their maps wouldn't pay.
+
+	 @param sizes [IN] Size of each input, in bytes.
+	 @param policy [IN] The figures to plan with. Its workers must be set (not 0).
+	 @return The plan.
+	 */
+	Count_schedule plan_count(const std::vector<std::uint64_t>& sizes, const Schedule_policy& policy);
+
+}
+
+#endif /* Count_schedule_hpp */
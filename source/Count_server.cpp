@@ -0,0 +1,232 @@
+//
+//  Count_server.cpp
+//  counter
+//
+
+#include "Count_server.hpp"
+#include <cerrno>
+#include <cstring>
+#include <ostream>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace counterLib {
+
+	namespace {
+		const int poll_interval_ms = 100; // how often blocked calls check for stop()
+
+#ifdef MSG_NOSIGNAL
+		const int send_flags = MSG_NOSIGNAL; // a peer gone away fails the send instead of raising SIGPIPE
+#else
+		const int send_flags = 0; // where there is no MSG_NOSIGNAL, each socket is set SO_NOSIGPIPE instead
+#endif
+
+		/**
+		 Writes all of the given bytes to a socket, without raising SIGPIPE.
+
+		 @return false if the peer has gone away.
+		 */
+		bool write_all(int fd, const char* data, std::size_t size) {
+			while (size > 0) {
+				ssize_t n = ::send(fd, data, size, send_flags);
+				if (n < 0 && errno == EINTR) {
+					continue;
+				}
+				if (n <= 0) {
+					return false;
+				}
+				data += n;
+				size -= static_cast<std::size_t>(n);
+			}
+			return true;
+		}
+
+		/**
+		 Output stream buffer that sends what is written to it down a socket,
+		 in large writes. Lets Counter::result_to_output() stream to a client.
+		 */
+		class Socket_streambuf : public std::streambuf {
+		public:
+			explicit Socket_streambuf(int fd) : _fd { fd }, _buffer(64 * 1024) {
+				setp(_buffer.data(), _buffer.data() + _buffer.size());
+			}
+			~Socket_streambuf() { sync(); }
+
+		protected:
+			int_type overflow(int_type c) override {
+				if (sync() != 0) {
+					return traits_type::eof();
+				}
+				if (!traits_type::eq_int_type(c, traits_type::eof())) {
+					*pptr() = traits_type::to_char_type(c);
+					pbump(1);
+				}
+				return traits_type::not_eof(c);
+			}
+			int sync() override {
+				bool ok = write_all(_fd, pbase(), static_cast<std::size_t>(pptr() - pbase()));
+				setp(_buffer.data(), _buffer.data() + _buffer.size());
+				return ok ? 0 : -1;
+			}
+
+		private:
+			int _fd;
+			std::vector<char> _buffer;
+		};
+
+		/**
+		 Splits a request line at its tabs.
+		 */
+		std::vector<std::string> split_fields(const std::string& line) {
+			std::vector<std::string> fields;
+			std::string::size_type start = 0, tab;
+			while ((tab = line.find('\t', start)) != std::string::npos) {
+				fields.push_back(line.substr(start, tab - start));
+				start = tab + 1;
+			}
+			fields.push_back(line.substr(start));
+			return fields;
+		}
+	}
+
+	Count_server::Count_server(const std::string& socketPath, unsigned threadCount) :
+		_socketPath { socketPath },
+		_listenFd { -1 },
+		_pool { threadCount } {
+		sockaddr_un address;
+		std::memset(&address, 0, sizeof(address));
+		if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+			throw std::invalid_argument {"Count_server socket path is empty or too long: " + socketPath};
+		}
+		address.sun_family = AF_UNIX;
+		std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+		_listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (_listenFd < 0) {
+			throw std::system_error {errno, std::generic_category(), "Count_server unable to create a socket"};
+		}
+		::unlink(socketPath.c_str()); // a stale socket from an earlier run
+		if (::bind(_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+			|| ::listen(_listenFd, SOMAXCONN) != 0) {
+			int err = errno;
+			::close(_listenFd);
+			throw std::system_error {err, std::generic_category(), "Count_server unable to listen on " + socketPath};
+		}
+	}
+
+	Count_server::~Count_server() {
+		stop();
+		{
+			// run() normally does this, but it may never have been called
+			std::unique_lock<std::mutex> lock { _connectionsMutex };
+			_connectionClosed.wait(lock, [this] { return _connectionCount == 0; });
+		}
+		::close(_listenFd);
+		::unlink(_socketPath.c_str());
+	}
+
+	void Count_server::run() {
+		while (!_stopping) {
+			pollfd listening { _listenFd, POLLIN, 0 };
+			if (::poll(&listening, 1, poll_interval_ms) <= 0) {
+				continue; // timed out (time to check _stopping) or interrupted
+			}
+			int fd = ::accept(_listenFd, nullptr, nullptr);
+			if (fd < 0) {
+				continue;
+			}
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+			int on = 1;
+			::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+			{
+				std::lock_guard<std::mutex> lock { _connectionsMutex };
+				++_connectionCount;
+			}
+			std::thread { &Count_server::serve_connection, this, fd }.detach();
+		}
+
+		std::unique_lock<std::mutex> lock { _connectionsMutex };
+		_connectionClosed.wait(lock, [this] { return _connectionCount == 0; });
+	}
+
+	void Count_server::serve_connection(int fd) {
+		std::string pending; // bytes received but not yet handled
+		char chunk[4096];
+		bool open = true;
+		while (open && !_stopping) {
+			pollfd client { fd, POLLIN, 0 };
+			int ready = ::poll(&client, 1, poll_interval_ms);
+			if (ready <= 0) {
+				continue;
+			}
+			ssize_t n = ::read(fd, chunk, sizeof(chunk));
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			if (n <= 0) {
+				break; // the client hung up
+			}
+			pending.append(chunk, static_cast<std::size_t>(n));
+
+			std::string::size_type newline;
+			while (open && (newline = pending.find('\n')) != std::string::npos) {
+				std::string request = pending.substr(0, newline);
+				pending.erase(0, newline + 1);
+				if (!request.empty() && request.back() == '\r') {
+					request.pop_back();
+				}
+				if (request == "shutdown") {
+					write_all(fd, "OK\n", 3);
+					stop();
+					open = false;
+				}
+				else if (!request.empty()) {
+					handle_request(fd, request);
+				}
+			}
+		}
+		::close(fd);
+
+		{
+			std::lock_guard<std::mutex> lock { _connectionsMutex };
+			--_connectionCount;
+		}
+		_connectionClosed.notify_all();
+	}
+
+	void Count_server::handle_request(int fd, const std::string& request) {
+		std::string reply;
+		auto fields = split_fields(request);
+		if (fields.size() != 3 || (fields[0] != "count" && fields[0] != "stream")) {
+			reply = "ERROR Expected count or stream, then the input and output filenames, separated by tabs.\n";
+		}
+		else {
+			try {
+				// a fresh Counter per job, sharing the warm pools
+				Counter c { fields[1], fields[2], &_pool, &_arenas };
+				unsigned long token_count = c.concurrent_count_tokens();
+				c.generate_output();
+				if (fields[0] == "stream") {
+					Socket_streambuf buffer { fd };
+					std::ostream out { &buffer };
+					c.result_to_output(out);
+				}
+				reply = "OK " + std::to_string(token_count) + "\n";
+			}
+			catch (std::invalid_argument& ia) {
+				reply = std::string {"ERROR Invalid argument: "} + ia.what() + "\n";
+			}
+			catch (std::exception& e) {
+				reply = std::string {"ERROR "} + e.what() + "\n";
+			}
+		}
+		write_all(fd, reply.data(), reply.size());
+	}
+
+}
@@ -0,0 +1,125 @@
+/**
+ *	@file Count_server.hpp
+ *
+ *	Long-running server mode of the 'counter' program.
+ */
+
+#ifndef Count_server_hpp
+#define Count_server_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include "Counter.hpp"
+
+namespace counterLib {
+
+	/**
+	 Serves counting jobs over a local (Unix-domain) socket,
+	 so that a scheduler running many small jobs pays for process start-up,
+	 thread creation and cold allocator state only once.
+	 Every job gets its own Counter, but all of them share the server's
+	 warm Thread_pool and Arena_pool.
+	 Each connection is served on its own thread, so jobs from different
+	 clients run at the same time.
+
+	 The protocol is line based. Each request is one line, fields separated by tabs:
+
+	 	count<TAB>input file<TAB>output file
+	 		Counts the files listed in the input file and writes the sorted result
+	 		to the output file, like running ./counter input output.
+	 		Replies "OK <number of unique tokens>".
+	 	stream<TAB>input file<TAB>output file
+	 		As count, but first sends the result lines ("token, count") back as well.
+	 	shutdown
+	 		Replies "OK" and stops accepting connections.
+	 		Jobs already running are finished.
+
+	 A request that fails is answered with "ERROR <message>" and the connection stays usable.
+	 Relative paths are relative to the server's working directory.
+
+	 Following RAII, the socket is created by the constructor and
+	 closed (and its file removed) by the destructor.
+	 */
+	class Count_server {
+	public:
+		/**
+		 Initializing Constructor
+
+		 Creates the socket and starts listening. Replaces a stale socket file.
+		 Throws std::system_error if the socket can't be set up.
+
+		 @param socketPath [IN] Filename (path) of the socket to create.
+		 @param threadCount [IN] Number of counting threads. 0 means one per hardware thread.
+		 */
+		explicit Count_server(const std::string& socketPath, unsigned threadCount = 0);
+
+		/**
+		 Copy constructor (deleted)
+
+		 Deleted because sockets and threads can't be copied.
+		 */
+		Count_server(const Count_server&) = delete;
+
+		/**
+		 Destructor
+
+		 Stops the server, closes the socket and removes its file.
+		 */
+		~Count_server();
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Count_server& operator= (const Count_server&) = delete;
+
+		/**
+		 Accepts and serves connections until stop() is called or a client
+		 sends "shutdown". Returns once all connections are done.
+		 Replies are sent without raising SIGPIPE, so a client hanging up
+		 can't kill the server, and the process's signal handling is left as it is.
+		 */
+		void run();
+
+		/**
+		 Asks run() to return. Safe to call from any thread.
+		 */
+		void stop() noexcept { _stopping = true; }
+
+		/**
+		 Gets the filename (path) of the socket.
+
+		 @return The path given to the constructor.
+		 */
+		const std::string& socket_path() const noexcept { return _socketPath; }
+
+	private:
+		/**
+		 Reads and answers requests on one connection until the client hangs up.
+
+		 @param fd [IN] The connected socket. Closed when done.
+		 */
+		void serve_connection(int fd);
+
+		/**
+		 Runs one request line and writes the reply.
+
+		 @param fd [IN] The connected socket.
+		 @param request [IN] The request line, without its newline.
+		 */
+		void handle_request(int fd, const std::string& request);
+
+		std::string _socketPath;
+		int _listenFd;
+		std::atomic<bool> _stopping { false };
+		Thread_pool _pool; // shared by every job
+		Arena_pool _arenas; // shared by every job
+		std::mutex _connectionsMutex; // guards _connectionCount
+		std::condition_variable _connectionClosed;
+		unsigned _connectionCount = 0; // connections being served (on detached threads)
+	};
+
+}
+
+#endif /* Count_server_hpp */
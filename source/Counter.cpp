@@ -6,10 +6,17 @@
 //
 
 #include "Counter.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
 #include <future>
+#include <iterator>
+#include <list>
+#include <numeric>
+#include <sys/stat.h>
 
 namespace counterLib {
-	const int Counter::concurrency_file_number_threshold = 2;
 	
 	/*
 	 C++11 mandates that the initializer for a local static variable is only run once,
@@ -27,9 +34,18 @@ namespace counterLib {
 		return instance;
 	}
 
-	Counter::Counter(const std::string& inputFileName, const std::string& outputFileName) :
+	Counter::Counter(const std::string& inputFileName, const std::string& outputFileName,
+					 Thread_pool* pool, Arena_pool* arenas) :
 		_ifl {new Input_file_list { inputFileName } },
-		_osf {new Output_sorting_file { outputFileName } } { }
+		_osf {new Output_sorting_file { outputFileName } },
+		_pool { pool },
+		_arenas { arenas ? arenas : &_ownArenas } { }
+
+	Counter::Counter(Thread_pool* pool, Arena_pool* arenas) :
+		_ifl { nullptr },
+		_osf { nullptr },
+		_pool { pool },
+		_arenas { arenas ? arenas : &_ownArenas } { }
 
 	Counter::~Counter() {
 		delete _ifl;
@@ -40,68 +56,1338 @@ namespace counterLib {
 		concurrent_count_tokens();
 		generate_output();
 	}
+	
+	namespace {
+		/**
+		 Size of the named file, or 0 if it can't be read (its count will fail).
+		 */
+		std::uint64_t file_size(const std::string& filename) noexcept {
+			struct stat status;
+			return ::stat(filename.c_str(), &status) == 0 ? static_cast<std::uint64_t>(status.st_size) : 0;
+		}
+		
+		/**
+		 Points a Counter at the tracker of its job for as long as the job runs.
+		 */
+		struct Tracking {
+			Count_tracker*& slot;
+			Tracking(Count_tracker*& aSlot, Count_tracker* tracker) noexcept : slot(aSlot) { slot = tracker; }
+			~Tracking() { slot = nullptr; }
+		};
+	}
+	
+	Count_job Counter::execute_async(std::size_t topK) {
+		require_files();
+		auto tracker = std::make_shared<Count_tracker>(topK);
+		auto done = std::async(std::launch::async, [this, tracker]() {
+			Tracking tracking { _tracker, tracker.get() };
+			std::uint64_t byteCount = 0;
+			for (auto& filename : *_ifl) {
+				byteCount += file_size(filename);
+			}
+			tracker->start(_ifl->file_count(), byteCount);
+			concurrent_count_tokens();
+			if (tracker->cancelled()) {
+				clear_counts();
+				throw Count_cancelled {};
+			}
+			tracker->counting_done();
+			generate_output();
+		});
+		return Count_job { tracker, std::move(done) };
+	}
 
 	unsigned long Counter::count_tokens() {
-		_tcm.clear();
-		for (auto fnIter = _ifl->cbegin(); fnIter != _ifl->cend(); ++fnIter ) {
-			File_token_counter tc(*fnIter);
-			tc.add_to_map(_tcm);
+		require_files();
+		if (_documentStats && _ngramSize > 1) {
+			throw std::logic_error {"Counter collects document statistics for single tokens only, not n-grams."};
+		}
+		require_plain_deduplication();
+		if (_sampleFraction > 0) {
+			sample_inputs(_ifl->cbegin(), _ifl->cend());
+			return unique_count();
+		}
+		if (!_idDirectory.empty()) {
+			encode_inputs(_ifl->cbegin(), _ifl->cend());
+			return unique_count();
+		}
+		if (!_checkpointFileName.empty()) {
+			checkpointed_inputs(_ifl->cbegin(), _ifl->cend());
+			return unique_count();
+		}
+		if (_fingerprinting) {
+			fingerprinted_inputs(_ifl->cbegin(), _ifl->cend());
+			return unique_count();
+		}
+		clear_counts();
+		if (_deduplicate) {
+			for (auto& input : deduplicate_inputs(std::vector<std::string>(_ifl->cbegin(), _ifl->cend()))) {
+				count_input(input);
+			}
+		}
+		else {
+			for (auto fnIter = _ifl->cbegin(); fnIter != _ifl->cend(); ++fnIter ) {
+				count_input(*fnIter);
+			}
 		}
-		return _tcm.size();
+		record_memory();
+		return unique_count();
 	}
 	
-	Token_count_map get_file_token_map(std::string filename) {
-		Token_count_map tcmf; // just for this file
+	Token_count_map get_file_token_map(std::string filename, Memory_resource* arena, const Stopword_set* stopwords,
+									   const Shard* shard) {
+		Token_count_map tcmf { arena }; // just for this file
 		
 		File_token_counter ftc(filename);
+		ftc.set_stopwords(stopwords);
+		ftc.set_shard(shard);
 		ftc.add_to_map(tcmf);
 		
 		return tcmf;
 	}
 
-	unsigned long Counter::concurrent_count_tokens() {
-		unsigned long token_count = 0;
+	Token_count_map get_text_token_map(Token_view text, Memory_resource* arena, const Stopword_set* stopwords,
+									   const Shard* shard) {
+		Token_count_map tcmt { arena }; // just for this text
+		
+		std::vector<char> buffer;
+		add_text_to_map(text, tcmt, buffer, stopwords, shard);
+		
+		return tcmt;
+	}
+
+	Ngram_count_map get_file_ngram_map(std::string filename, unsigned n, Memory_resource* arena, const Stopword_set* stopwords,
+									   const Shard* shard) {
+		Ngram_count_map ncmf { n, arena }; // just for this file
+		
+		File_token_counter ftc(filename);
+		ftc.set_stopwords(stopwords);
+		ftc.set_shard(shard);
+		ftc.add_to_map(ncmf);
+		
+		return ncmf;
+	}
+
+	Ngram_count_map get_text_ngram_map(Token_view text, unsigned n, Memory_resource* arena, const Stopword_set* stopwords,
+									   const Shard* shard) {
+		Ngram_count_map ncmt { n, arena }; // just for this text
+		
+		std::vector<char> buffer;
+		add_text_to_map(text, ncmt, buffer, stopwords, shard);
+		
+		return ncmt;
+	}
+
+	namespace {
+		/**
+		 Counts one input (a filename or a text) into a worker's map, for count_by_node() and batches of inputs.
+		 */
+		void add_input_to_map(const std::string& filename, Token_count_map& aTCM,
+							  std::vector<char>&, const Stopword_set* stopwords, const Shard* shard) {
+			File_token_counter ftc(filename);
+			ftc.set_stopwords(stopwords);
+			ftc.set_shard(shard);
+			ftc.add_to_map(aTCM);
+		}
+		
+		void add_input_to_map(Token_view text, Token_count_map& aTCM,
+							  std::vector<char>& buffer, const Stopword_set* stopwords, const Shard* shard) {
+			add_text_to_map(text, aTCM, buffer, stopwords, shard);
+		}
+		
+		void add_input_to_map(const Distinct_input& input, Token_count_map& aTCM,
+							  std::vector<char>& buffer, const Stopword_set* stopwords, const Shard* shard) {
+			if (input.copies == 1) {
+				add_input_to_map(input.filename, aTCM, buffer, stopwords, shard);
+				return;
+			}
+			Token_count_map copies; // counted once, then multiplied
+			add_input_to_map(input.filename, copies, buffer, stopwords, shard);
+			copies.scale(input.copies);
+			aTCM.add_batch(copies.cbegin(), copies.cend());
+		}
+		
+		/**
+		 Counts the n-grams of one input into a task's map, for a batch of inputs.
+		 */
+		void add_input_to_map(const std::string& filename, Ngram_count_map& aNCM,
+							  std::vector<char>&, const Stopword_set* stopwords, const Shard* shard) {
+			File_token_counter ftc(filename);
+			ftc.set_stopwords(stopwords);
+			ftc.set_shard(shard);
+			ftc.add_to_map(aNCM);
+		}
+		
+		void add_input_to_map(Token_view text, Ngram_count_map& aNCM,
+							  std::vector<char>& buffer, const Stopword_set* stopwords, const Shard* shard) {
+			add_text_to_map(text, aNCM, buffer, stopwords, shard);
+		}
+		
+		void add_input_to_map(const Distinct_input& input, Ngram_count_map& aNCM,
+							  std::vector<char>& buffer, const Stopword_set* stopwords, const Shard* shard) {
+			if (input.copies == 1) {
+				add_input_to_map(input.filename, aNCM, buffer, stopwords, shard);
+				return;
+			}
+			Ngram_count_map copies { aNCM.n() }; // counted once, then multiplied
+			add_input_to_map(input.filename, copies, buffer, stopwords, shard);
+			copies.scale(input.copies);
+			aNCM.add_map(copies);
+		}
+		
+		/**
+		 The inputs of one scheduled task (see Count_schedule), copied, so the task owns them.
+		 */
+		template <class Input>
+		struct Input_batch {
+			std::vector<Input> inputs;
+		};
+	}
+	
+	namespace {
+		/**
+		 Task counting the tokens of one input (a filename or a text), or of a batch of them, for merge_concurrently().
+		 */
+		struct Token_task {
+			const Stopword_set* stopwords;
+			const Shard* shard;
+			const Count_tracker* tracker; // skips the input, if set and cancelled
+			Token_count_map operator() (const std::string& filename, Memory_resource* arena) const {
+				if (tracker && tracker->cancelled()) {
+					return Token_count_map { arena };
+				}
+				return get_file_token_map(filename, arena, stopwords, shard);
+			}
+			Token_count_map operator() (Token_view text, Memory_resource* arena) const {
+				if (tracker && tracker->cancelled()) {
+					return Token_count_map { arena };
+				}
+				return get_text_token_map(text, arena, stopwords, shard);
+			}
+			Token_count_map operator() (const Distinct_input& input, Memory_resource* arena) const {
+				if (tracker && tracker->cancelled()) {
+					return Token_count_map { arena };
+				}
+				Token_count_map tcm = get_file_token_map(input.filename, arena, stopwords, shard);
+				if (input.copies != 1) {
+					tcm.scale(input.copies);
+				}
+				return tcm;
+			}
+			template <class Input>
+			Token_count_map operator() (const Input_batch<Input>& batch, Memory_resource* arena) const {
+				if (batch.inputs.size() == 1) {
+					return (*this)(batch.inputs.front(), arena);
+				}
+				Token_count_map tcm { arena };
+				std::vector<char> buffer;
+				for (auto& input : batch.inputs) {
+					if (tracker && tracker->cancelled()) {
+						break;
+					}
+					add_input_to_map(input, tcm, buffer, stopwords, shard);
+				}
+				return tcm;
+			}
+		};
+		
+		/**
+		 Task counting the n-grams of one input, or of a batch of them, for merge_concurrently().
+		 */
+		struct Ngram_task {
+			unsigned n;
+			const Stopword_set* stopwords;
+			const Shard* shard;
+			const Count_tracker* tracker; // skips the input, if set and cancelled
+			Ngram_count_map operator() (const std::string& filename, Memory_resource* arena) const {
+				if (tracker && tracker->cancelled()) {
+					return Ngram_count_map { n, arena };
+				}
+				return get_file_ngram_map(filename, n, arena, stopwords, shard);
+			}
+			Ngram_count_map operator() (Token_view text, Memory_resource* arena) const {
+				if (tracker && tracker->cancelled()) {
+					return Ngram_count_map { n, arena };
+				}
+				return get_text_ngram_map(text, n, arena, stopwords, shard);
+			}
+			Ngram_count_map operator() (const Distinct_input& input, Memory_resource* arena) const {
+				if (tracker && tracker->cancelled()) {
+					return Ngram_count_map { n, arena };
+				}
+				Ngram_count_map ncm = get_file_ngram_map(input.filename, n, arena, stopwords, shard);
+				if (input.copies != 1) {
+					ncm.scale(input.copies);
+				}
+				return ncm;
+			}
+			template <class Input>
+			Ngram_count_map operator() (const Input_batch<Input>& batch, Memory_resource* arena) const {
+				if (batch.inputs.size() == 1) {
+					return (*this)(batch.inputs.front(), arena);
+				}
+				Ngram_count_map ncm { n, arena };
+				std::vector<char> buffer;
+				for (auto& input : batch.inputs) {
+					if (tracker && tracker->cancelled()) {
+						break;
+					}
+					add_input_to_map(input, ncm, buffer, stopwords, shard);
+				}
+				return ncm;
+			}
+		};
+	}
+
+	namespace {
+		/**
+		 Task counting the tokens of one file, keeping its token stream, for merge_concurrently().
+		 */
+		struct Token_stream_task {
+			const Stopword_set* stopwords;
+			const Count_tracker* tracker; // skips the input, if set and cancelled
+			const std::string* directory; // to spill the stream to
+			std::atomic<std::size_t>* spills; // numbers the spill files, in the order the tasks start
+			Token_stream operator() (const std::string& filename, Memory_resource* arena) const {
+				Token_stream stream { arena };
+				if (!(tracker && tracker->cancelled())) {
+					File_token_counter ftc(filename);
+					ftc.set_stopwords(stopwords);
+					stream.spill_file_name = spill_file_name(*directory, (*spills)++);
+					Id_file_writer spill { stream.spill_file_name };
+					ftc.add_to_map(stream.counts, spill);
+					spill.flush();
+				}
+				return stream;
+			}
+		};
+	}
+
+	namespace {
+		/**
+		 Task sampling the tokens of one file, for merge_concurrently().
+		 Each file's blocks are picked by the seed and its name, so a sample can be repeated.
+		 */
+		struct Sample_task {
+			const Stopword_set* stopwords;
+			const Shard* shard;
+			const Count_tracker* tracker; // skips the input, if set and cancelled
+			double fraction;
+			std::uint64_t seed;
+			Token_sample operator() (const std::string& filename, Memory_resource* arena) const {
+				Token_sample sample { arena };
+				if (!(tracker && tracker->cancelled())) {
+					File_token_counter ftc(filename);
+					ftc.set_stopwords(stopwords);
+					ftc.set_shard(shard);
+					sample.blocks = ftc.add_sample_to_map(sample.counts, sample.squares, fraction,
+														  seed ^ std::hash<std::string>()(filename));
+				}
+				return sample;
+			}
+		};
+	}
+
+	namespace {
+		/**
+		 Task counting the tokens of one file by fingerprint, for merge_concurrently().
+		 */
+		struct Fingerprint_task {
+			const Stopword_set* stopwords;
+			const Shard* shard;
+			const Count_tracker* tracker; // skips the input, if set and cancelled
+			Fingerprint_count_map operator() (const std::string& filename, Memory_resource* arena) const {
+				Fingerprint_count_map fcm { arena };
+				if (!(tracker && tracker->cancelled())) {
+					File_token_counter ftc(filename);
+					ftc.set_stopwords(stopwords);
+					ftc.set_shard(shard);
+					ftc.add_to_map(fcm);
+				}
+				return fcm;
+			}
+		};
+		
+		/**
+		 Task finding the tokens of the wanted fingerprints in one file, for merge_concurrently().
+		 */
+		struct Recovery_task {
+			const Stopword_set* stopwords;
+			const Shard* shard;
+			const Fingerprint_count_map* wanted; // fingerprint to index
+			Recovered_tokens operator() (const std::string& filename, Memory_resource* arena) const {
+				Recovered_tokens recovered { arena };
+				File_token_counter ftc(filename);
+				ftc.set_stopwords(stopwords);
+				ftc.set_shard(shard);
+				ftc.recover_tokens(*wanted, recovered.tokens);
+				return recovered;
+			}
+		};
+	}
+
+	namespace {
+		/**
+		 Names an input in the memory profile: a file by its name, a text by its position.
+		 */
+		std::string input_name(const std::string& filename, std::size_t) { return filename; }
+		std::string input_name(Token_view, std::size_t position) { return std::to_string(position); }
+		std::string input_name(const Distinct_input& input, std::size_t) { return input.filename; }
+		
+		/**
+		 Reports one input as done to the tracker of a job:
+		 a file as its size, a text as its length, a deduplicated file once per copy.
+		 */
+		void report_input(Count_tracker& tracker, const std::string& filename) {
+			tracker.input_done(1, file_size(filename));
+		}
+		void report_input(Count_tracker& tracker, Token_view text) {
+			tracker.input_done(1, text.size());
+		}
+		void report_input(Count_tracker& tracker, const Distinct_input& input) {
+			auto copies = static_cast<std::size_t>(input.copies);
+			tracker.input_done(copies, copies * file_size(input.filename));
+		}
+		
+		/**
+		 Size of one input, for planning: a file's size, a text's length.
+		 */
+		std::uint64_t input_bytes(const std::string& filename) { return file_size(filename); }
+		std::uint64_t input_bytes(Token_view text) { return text.size(); }
+		std::uint64_t input_bytes(const Distinct_input& input) { return file_size(input.filename); }
+		
+		/**
+		 Bytes a string holds on the heap: none when it's short enough to be held within.
+		 */
+		std::size_t heap_bytes(const std::string& s) noexcept {
+			const char* object = reinterpret_cast<const char*>(&s);
+			return (s.data() >= object && s.data() < object + sizeof(s)) ? 0 : s.capacity() + 1;
+		}
 		
-		if (_ifl->file_count() < concurrency_file_number_threshold) {
-			token_count = count_tokens();
+		/**
+		 Figures of sorted Token_counts, each item taking bytesPerItem plus its string,
+		 made with one allocation each if perItemAllocation, or one for all.
+		 */
+		template <class Iter>
+		Allocation_stats sorted_footprint(Iter first, Iter last, std::size_t bytesPerItem, bool perItemAllocation) {
+			Allocation_stats footprint;
+			footprint.allocations = perItemAllocation ? 0 : 1;
+			for (auto i = first; i != last; ++i) {
+				footprint.live_bytes += bytesPerItem + heap_bytes(i->first);
+				footprint.allocations += (perItemAllocation ? 1 : 0) + (heap_bytes(i->first) ? 1 : 0);
+			}
+			footprint.peak_bytes = footprint.live_bytes;
+			return footprint;
+		}
+	}
+	
+	namespace {
+		/**
+		 Finishes every task of a count that is being abandoned (one of its inputs failed),
+		 so none outlives the arena it allocates from: futures from a Thread_pool,
+		 unlike those from std::async, don't wait when they are destroyed.
+		 Each map is taken out of its future and dropped here, while its arena is still leased,
+		 as the pool's worker may release the task's shared state only later.
+		 */
+		template <class Futures>
+		void drain(Futures& futures) noexcept {
+			for (auto& f : futures) {
+				if (f.valid()) {
+					try {
+						f.get();
+					}
+					catch (...) {
+						// only the first failure is reported
+					}
+				}
+			}
+		}
+	}
+	
+	template <class Iter, class Task>
+	void Counter::merge_concurrently(Iter first, Iter last, Task task) {
+		using Map = decltype(task(*first, static_cast<Memory_resource*>(nullptr)));
+		// get token counts concurrently
+		// make a list of futures based on token count maps
+		// of each input, taken from async calls.
+		// Each task gets its own arena, so the tasks don't contend for the heap.
+		// The arenas are declared first so that they outlive any map left in a future,
+		// and if anything throws, every task is drained before they go.
+		// Tasks run on the thread pool if there is one, else via std::async.
+		// When profiling, each task's map allocates through a counting resource over its arena.
+		std::list<Arena_pool::Lease> arenaList;
+		std::list<Counting_resource> countingList;
+		std::list<std::future<Map>> futureMapList;
+		try {
+			for (auto s = first; s != last; ++s ) {
+				arenaList.push_back(_arenas->acquire());
+				Memory_resource* arena = arenaList.back().get();
+				if (_memoryProfile) {
+					countingList.emplace_back(arena, &_memoryProfile->resource(Memory_profile::tokenize));
+					arena = &countingList.back();
+				}
+				auto futureMap = _pool
+					? _pool->async(task, *s, arena)
+					: std::async(std::launch::async, task, *s, arena);
+				futureMapList.push_back(std::move(futureMap));
+			}
+			// get each input's map and combine it with this object's.
+			// add_map copies the keys into our own arena,
+			// so each task's arena can go back to the pool as soon as its map is merged.
+			auto ai = arenaList.begin();
+			auto ci = countingList.begin();
+			auto input = first;
+			std::size_t position = 0;
+			for (auto fi = futureMapList.begin();
+				 fi != futureMapList.end(); ++fi, ++ai, ++input, ++position ) {
+				{
+					Map inputMap = fi->get();
+					merge_input(*input, inputMap);
+					if (_checkpoint && !(_tracker && _tracker->cancelled())) {
+						checkpoint_input(*input); // a cancelled job's inputs may have been skipped
+					}
+					if (_tracker && !_tracker->cancelled()) {
+						report_input(*_tracker, *input);
+					}
+					if (_memoryProfile) {
+						_memoryProfile->record("tokenize: " + input_name(*input, position), ci->stats(),
+											   inputMap.size(), inputMap.load_factor());
+						++ci;
+					}
+				}
+				ai->reset(); // ends the lease, giving the arena back
+			}
+		}
+		catch (...) {
+			drain(futureMapList);
+			throw;
+		}
+	}
+	
+	template <class Iter, class Task>
+	void Counter::merge_scheduled(Iter first, Iter last, Task task) {
+		using Input = typename std::iterator_traits<Iter>::value_type;
+		using Map = decltype(task(Input_batch<Input> {}, static_cast<Memory_resource*>(nullptr)));
+		const std::vector<Iter> inputs = [first, last]() {
+			std::vector<Iter> all;
+			for (auto i = first; i != last; ++i) {
+				all.push_back(i);
+			}
+			return all;
+		}();
+		// as merge_concurrently(), but a task per batch of the schedule, started in its order
+		std::list<Arena_pool::Lease> arenaList;
+		std::list<Counting_resource> countingList;
+		std::list<std::future<Map>> futureMapList;
+		try {
+			for (auto& positions : _schedule.tasks) {
+				Input_batch<Input> batch;
+				for (auto p : positions) {
+					batch.inputs.push_back(*inputs[p]);
+				}
+				arenaList.push_back(_arenas->acquire());
+				Memory_resource* arena = arenaList.back().get();
+				if (_memoryProfile) {
+					countingList.emplace_back(arena, &_memoryProfile->resource(Memory_profile::tokenize));
+					arena = &countingList.back();
+				}
+				auto futureMap = _pool
+					? _pool->async(task, std::move(batch), arena)
+					: std::async(std::launch::async, task, std::move(batch), arena);
+				futureMapList.push_back(std::move(futureMap));
+			}
+			// merge each task's map in the order started; a batch holds no documents (see plan_inputs())
+			auto ai = arenaList.begin();
+			auto ci = countingList.begin();
+			auto positions = _schedule.tasks.cbegin();
+			for (auto fi = futureMapList.begin(); fi != futureMapList.end(); ++fi, ++ai, ++positions) {
+				{
+					Map taskMap = fi->get();
+					const Input& lead = *inputs[positions->front()];
+					merge_input(lead, taskMap);
+					if (_tracker && !_tracker->cancelled()) {
+						for (auto p : *positions) {
+							report_input(*_tracker, *inputs[p]);
+						}
+					}
+					if (_memoryProfile) {
+						std::string name = input_name(lead, positions->front());
+						if (positions->size() > 1) {
+							name += " +" + std::to_string(positions->size() - 1);
+						}
+						_memoryProfile->record("tokenize: " + name, ci->stats(), taskMap.size(), taskMap.load_factor());
+						++ci;
+					}
+				}
+				ai->reset(); // ends the lease, giving the arena back
+			}
+		}
+		catch (...) {
+			drain(futureMapList);
+			throw;
+		}
+	}
+	
+	template <class Iter>
+	void Counter::plan_inputs(Iter first, Iter last) {
+		std::vector<std::uint64_t> sizes;
+		for (auto i = first; i != last; ++i) {
+			sizes.push_back(input_bytes(*i));
+		}
+		Schedule_policy policy = _schedulePolicy;
+		if (policy.workers == 0 && _pool) {
+			policy.workers = _pool->thread_count();
+		}
+		if (_documentStats) {
+			policy.small_input_bytes = 0; // each input is a document, merged on its own
+		}
+		_schedule = plan_count(sizes, policy);
+		std::size_t position = 0;
+		for (auto i = first; i != last; ++i, ++position) {
+			_schedule.names.push_back(input_name(*i, position));
+		}
+		if (_documentStats) {
+			// and documents are numbered in list order, so their tasks go in it too
+			std::vector<std::size_t> order(_schedule.tasks.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+				return _schedule.tasks[a].front() < _schedule.tasks[b].front();
+			});
+			Count_schedule listed = _schedule;
+			for (std::size_t t = 0; t < order.size(); ++t) {
+				listed.tasks[t] = _schedule.tasks[order[t]];
+				listed.task_costs[t] = _schedule.task_costs[order[t]];
+			}
+			_schedule = std::move(listed);
+		}
+	}
+	
+	template <class Iter>
+	void Counter::count_by_node(Iter first, Iter last) {
+		using Input = typename std::iterator_traits<Iter>::value_type;
+		std::vector<const Input*> inputs;
+		for (auto i = first; i != last; ++i) {
+			inputs.push_back(&*i);
+		}
+		const Stopword_set* sw = stopwords();
+		const Shard* sh = shard();
+		Count_tracker* tracker = _tracker;
+		std::atomic<std::size_t> next { 0 }; // the workers of all nodes share the inputs
+		
+		// one map per worker, in an arena of the worker's node, touched first by the worker.
+		// The leases are declared first so that they outlive the maps.
+		// When profiling, each map allocates through a counting resource over its arena.
+		const std::size_t nodeCount = _nodes->node_count();
+		std::vector<Arena_pool::Lease> leases;
+		std::list<Counting_resource> countingList;
+		std::vector<std::vector<std::future<Token_count_map>>> workerFutures(nodeCount);
+		std::vector<std::vector<Token_count_map>> workerMaps(nodeCount);
+		try {
+			for (std::size_t node = 0; node < nodeCount; ++node) {
+				Thread_pool& pool = _nodes->pool(node);
+				workerFutures[node].reserve(pool.thread_count()); // so keeping a future can't throw
+				for (unsigned w = 0; w < pool.thread_count(); ++w) {
+					leases.push_back(_nodes->arenas(node).acquire());
+					Memory_resource* arena = leases.back().get();
+					if (_memoryProfile) {
+						countingList.emplace_back(arena, &_memoryProfile->resource(Memory_profile::tokenize));
+						arena = &countingList.back();
+					}
+					workerFutures[node].push_back(pool.async([&inputs, &next, arena, sw, sh, tracker]() {
+						Token_count_map workerTCM { arena };
+						std::vector<char> buffer;
+						for (std::size_t i; (i = next++) < inputs.size(); ) {
+							if (tracker) {
+								if (tracker->cancelled()) {
+									break;
+								}
+								add_input_to_map(*inputs[i], workerTCM, buffer, sw, sh);
+								report_input(*tracker, *inputs[i]);
+							}
+							else {
+								add_input_to_map(*inputs[i], workerTCM, buffer, sw, sh);
+							}
+						}
+						return workerTCM;
+					}));
+				}
+			}
+			auto ci = countingList.begin();
+			for (std::size_t node = 0; node < nodeCount; ++node) {
+				for (auto& f : workerFutures[node]) {
+					workerMaps[node].push_back(f.get());
+					if (_memoryProfile) {
+						const Token_count_map& workerTCM = workerMaps[node].back();
+						_memoryProfile->record("tokenize: worker " + std::to_string(node) + "." + std::to_string(workerMaps[node].size() - 1),
+											   (ci++)->stats(), workerTCM.size(), workerTCM.load_factor());
+					}
+				}
+			}
+		}
+		catch (...) {
+			// the started workers read inputs and next, and allocate from the leases, so let them finish first
+			for (auto& futures : workerFutures) {
+				drain(futures);
+			}
+			throw;
+		}
+		
+		// reduce within each node, on the node, into its first worker's map
+		std::vector<std::future<void>> reductions;
+		reductions.reserve(nodeCount);
+		try {
+			for (std::size_t node = 0; node < nodeCount; ++node) {
+				auto& maps = workerMaps[node];
+				reductions.push_back(_nodes->pool(node).async([&maps]() {
+					for (std::size_t m = 1; m < maps.size(); ++m) {
+						maps.front().add_batch(maps[m].cbegin(), maps[m].cend());
+					}
+				}));
+			}
+		}
+		catch (...) {
+			drain(reductions); // they add into workerMaps
+			throw;
+		}
+		for (auto& r : reductions) {
+			r.wait();
+		}
+		for (auto& r : reductions) {
+			r.get();
+		}
+		
+		// only the per-node results cross nodes
+		for (auto& maps : workerMaps) {
+			add_map(maps.front());
+		}
+	}
+	
+	template <class Iter>
+	void Counter::count_inputs(Iter first, Iter last) {
+		if (_documentStats && _ngramSize > 1) {
+			throw std::logic_error {"Counter collects document statistics for single tokens only, not n-grams."};
+		}
+		clear_counts();
+		plan_inputs(first, last);
+		// a tracked job runs its tasks even so, to keep its leaders current as they merge
+		if (!_schedule.parallel && !_tracker) {
+			for (auto i = first; i != last; ++i) {
+				count_input(*i);
+			}
+		}
+		else if (_ngramSize > 1) {
+			merge_scheduled(first, last, Ngram_task { _ngramSize, stopwords(), shard(), _tracker });
+		}
+		else if (_nodes && !_documentStats) {
+			count_by_node(first, last);
 		}
 		else {
-			// get token counts concurrently
-			// make a list of futures based on token count maps
-			// of each file of our input file list, taken from async calls
-			std::list<std::future<Token_count_map>> futureTCMList;
-			for (auto s = _ifl->cbegin(); s != _ifl->cend(); ++s ) {
-				auto futureTCM = std::async(get_file_token_map, *s);
-				futureTCMList.push_back(std::move(futureTCM));
+			merge_scheduled(first, last, Token_task { stopwords(), shard(), _tracker });
+		}
+		record_memory();
+	}
+
+	template <class Iter>
+	void Counter::encode_inputs(Iter first, Iter last) {
+		if (_ngramSize > 1) {
+			throw std::logic_error {"Counter writes token IDs for single tokens only, not n-grams."};
+		}
+		if (shard()) {
+			throw std::logic_error {"Counter writes token IDs of whole counts only, not of a shard of the tokens."};
+		}
+		clear_counts();
+		::mkdir(_idDirectory.c_str(), 0777); // fails harmlessly if it exists; opening the files tells
+		std::atomic<std::size_t> spills { 0 };
+		auto remove_spills = [this, &spills]() {
+			for (std::size_t k = 0; k < spills; ++k) {
+				std::remove(spill_file_name(_idDirectory, k).c_str()); // fails harmlessly if already gone
 			}
-			// get each file's token map and combine it with this object's
-			for (auto fi = futureTCMList.begin();
-				 fi != futureTCMList.end(); ++fi ) {
-				add_map(fi->get());
+			_tokenStreams.clear();
+		};
+		try {
+			merge_concurrently(first, last, Token_stream_task { stopwords(), _tracker, &_idDirectory, &spills });
+			record_memory();
+			if (!(_tracker && _tracker->cancelled())) {
+				write_token_ids();
 			}
-			token_count = _tcm.size();
 		}
+		catch (...) {
+			remove_spills();
+			throw;
+		}
+		remove_spills();
+	}
+	
+	template <class Iter>
+	void Counter::sample_inputs(Iter first, Iter last) {
+		if (_ngramSize > 1 || _documentStats || !_idDirectory.empty()) {
+			throw std::logic_error {"Counter samples single tokens only, without document statistics or token IDs."};
+		}
+		clear_counts();
+		merge_concurrently(first, last, Sample_task { stopwords(), shard(), _tracker, _sampleFraction, _sampleSeed });
+		_sampleEstimator.apply(_tcm);
+		_estimated = true;
+		record_memory();
+	}
+	
+	template <class Iter>
+	void Counter::checkpointed_inputs(Iter first, Iter last) {
+		if (_ngramSize > 1 || _documentStats) {
+			throw std::logic_error {"Counter checkpoints counts of single tokens only, without document statistics."};
+		}
+		clear_counts();
+		_progress = Checkpoint_progress {};
+		if (_resume && read_checkpoint(_checkpointFileName, _progress, _tcm)) {
+			// the snapshot's files must be the first of these
+			Checkpoint_progress replay;
+			for (auto i = first; i != last && replay.inputs_done < _progress.inputs_done; ++i) {
+				replay.add_input(*i);
+			}
+			if (replay.inputs_done != _progress.inputs_done || replay.inputs_hash != _progress.inputs_hash) {
+				clear_counts();
+				throw std::invalid_argument {"Counter unable to resume from " + _checkpointFileName + ", a snapshot of other input files."};
+			}
+			for (std::uint64_t skipped = 0; skipped < _progress.inputs_done; ++skipped, ++first) {
+				if (_tracker) {
+					report_input(*_tracker, *first);
+				}
+			}
+		}
+		_checkpoint.reset(new Checkpoint_writer { _checkpointFileName, _checkpointInterval });
+		try {
+			merge_concurrently(first, last, Token_task { stopwords(), shard(), _tracker });
+			if (!(_tracker && _tracker->cancelled())) {
+				_checkpoint->finish(_progress, _tcm);
+			}
+		}
+		catch (...) {
+			_checkpoint.reset();
+			throw;
+		}
+		_checkpoint.reset();
+		record_memory();
+	}
+	
+	void Counter::checkpoint_input(const std::string& filename) {
+		_progress.add_input(filename);
+		_checkpoint->offer(_progress, _tcm);
+	}
+	
+	template <class Iter>
+	void Counter::fingerprinted_inputs(Iter first, Iter last) {
+		if (_ngramSize > 1 || _documentStats) {
+			throw std::logic_error {"Counter counts by fingerprint single tokens only, without document statistics."};
+		}
+		clear_counts();
+		Memory_resource* resource = _memoryProfile ? &_memoryProfile->resource(Memory_profile::merge) : new_delete_resource();
+		Fingerprint_count_map fingerprints { resource };
+		_fingerprints.swap(fingerprints);
+		merge_concurrently(first, last, Fingerprint_task { stopwords(), shard(), _tracker });
 		
-		return token_count;
+		// index the fingerprints to write out, then let the first pass's table go
+		Fingerprint_count_map wanted { resource };
+		_fingerprints.for_each([this, &wanted](const Fingerprint_count_map::Entry& entry) {
+			if (entry.count >= _minCount) {
+				wanted.add(entry.fingerprint, static_cast<Count>(_survivorCounts.size()));
+				_survivorCounts.push_back(entry.count);
+			}
+		});
+		Fingerprint_count_map { resource }.swap(_fingerprints);
+		if (_tracker && _tracker->cancelled()) {
+			return;
+		}
+		_survivors.assign(_survivorCounts.size(), Token_view {});
+		_tcm.reserve(static_cast<Token_count_map::size_type>(_survivorCounts.size()));
+		
+		// the second pass isn't progress: the job reached 100% with the first
+		Count_tracker* tracker = _tracker;
+		_tracker = nullptr;
+		try {
+			merge_concurrently(first, last, Recovery_task { stopwords(), shard(), &wanted });
+		}
+		catch (...) {
+			_tracker = tracker;
+			throw;
+		}
+		_tracker = tracker;
+		record_memory();
 	}
 	
-	void Counter::add_map(const Token_count_map& aTCM) {
-		for (auto tc: aTCM) {
-			auto i = _tcm.find(tc.first);
-			if (i == _tcm.end()) {
-				// doesn't exist, add
-				_tcm.emplace(tc.first, tc.second);
+	void Counter::set_checkpointing(const std::string& fileName, std::chrono::milliseconds interval, bool resume) {
+		_checkpointFileName = fileName;
+		_checkpointInterval = interval;
+		_resume = resume;
+	}
+	
+	template <class Iter>
+	void Counter::count_file_inputs(Iter first, Iter last) {
+		require_plain_deduplication();
+		if (_sampleFraction > 0) {
+			sample_inputs(first, last);
+		}
+		else if (!_idDirectory.empty()) {
+			encode_inputs(first, last);
+		}
+		else if (!_checkpointFileName.empty()) {
+			checkpointed_inputs(first, last);
+		}
+		else if (_fingerprinting) {
+			fingerprinted_inputs(first, last);
+		}
+		else if (_deduplicate) {
+			auto distinct = deduplicate_inputs(std::vector<std::string>(first, last));
+			count_inputs(distinct.cbegin(), distinct.cend());
+		}
+		else {
+			count_inputs(first, last);
+		}
+	}
+	
+	unsigned long Counter::concurrent_count_tokens() {
+		require_files();
+		count_file_inputs(_ifl->cbegin(), _ifl->cend());
+		return unique_count();
+	}
+	
+	Count_result Counter::count_files(const std::vector<std::string>& filenames) {
+		count_file_inputs(filenames.cbegin(), filenames.cend());
+		return make_result();
+	}
+	
+	Count_result Counter::count_file_list(const std::string& inputFileName) {
+		Input_file_list ifl { inputFileName };
+		return count_files(std::vector<std::string>(ifl.cbegin(), ifl.cend()));
+	}
+	
+	Count_result Counter::count_texts(const std::vector<Token_view>& texts) {
+		count_inputs(texts.cbegin(), texts.cend());
+		return make_result();
+	}
+	
+	void Counter::set_ngram_size(unsigned n) {
+		Ngram_count_map fresh { n, _tcm.resource() }; // throws if n is out of range
+		_ncm.swap(fresh);
+		_ngramSize = n;
+	}
+	
+	void Counter::set_stopwords(Stopword_set stopwords) {
+		_stopwords = std::move(stopwords);
+	}
+	
+	void Counter::set_shard(const Shard& shard, Shard_mode mode) {
+		if (mode == Shard_mode::files) {
+			require_files();
+			_ifl->keep_shard(shard);
+			return;
+		}
+		_shard = shard;
+	}
+	
+	void Counter::set_min_count(Count minCount) noexcept {
+		_minCount = minCount < 1 ? 1 : minCount;
+	}
+	
+	void Counter::count_input(const std::string& filename) {
+		File_token_counter tc(filename);
+		tc.set_stopwords(stopwords());
+		tc.set_shard(shard());
+		if (_ngramSize > 1) {
+			tc.add_to_map(_ncm);
+		}
+		else if (_documentStats) {
+			// the document's own counts are needed, so count it apart, then merge
+			_documentTCM.clear();
+			tc.add_to_map(_documentTCM);
+			merge_input(filename, _documentTCM);
+		}
+		else {
+			tc.add_to_map(_tcm);
+		}
+	}
+	
+	void Counter::count_input(const Distinct_input& input) {
+		if (input.copies == 1) {
+			count_input(input.filename);
+			return;
+		}
+		// count the content once, then add it as many times as it's listed
+		File_token_counter tc(input.filename);
+		tc.set_stopwords(stopwords());
+		tc.set_shard(shard());
+		if (_ngramSize > 1) {
+			Ngram_count_map copies { _ngramSize };
+			tc.add_to_map(copies);
+			copies.scale(input.copies);
+			add_map(copies);
+		}
+		else {
+			_documentTCM.clear(); // free, as document statistics rule deduplication out
+			tc.add_to_map(_documentTCM);
+			_documentTCM.scale(input.copies);
+			add_map(_documentTCM);
+		}
+	}
+	
+	void Counter::count_input(Token_view text) {
+		if (_ngramSize > 1) {
+			add_text_to_map(text, _ncm, _textBuffer, stopwords(), shard());
+		}
+		else if (_documentStats) {
+			_documentTCM.clear();
+			add_text_to_map(text, _documentTCM, _textBuffer, stopwords(), shard());
+			merge_input(text, _documentTCM);
+		}
+		else {
+			add_text_to_map(text, _tcm, _textBuffer, stopwords(), shard());
+		}
+	}
+	
+	void Counter::merge_input(const std::string& filename, const Token_count_map& aTCM) {
+		if (!_documentStats) {
+			add_map(aTCM);
+			return;
+		}
+		// merge, learning the ID (position in _tcm) of each of the document's tokens
+		_documentIds.resize(aTCM.size());
+		_tcm.add_batch(aTCM.cbegin(), aTCM.cend(), _documentIds.data());
+		_documentStats->add_document(filename, aTCM.cbegin(), aTCM.cend(), _documentIds.data());
+		if (_tracker) {
+			track_leaders(_documentIds.data(), aTCM.size());
+		}
+	}
+	
+	void Counter::merge_input(const std::string& filename, Token_stream& input) {
+		// merge, learning the position in _tcm of each of the file's tokens
+		_runs.clear();
+		_documentIds.resize(input.counts.size());
+		_tcm.add_batch(input.counts.cbegin(), input.counts.cend(), _documentIds.data());
+		if (_documentStats) {
+			_documentStats->add_document(filename, input.counts.cbegin(), input.counts.cend(), _documentIds.data());
+		}
+		if (_tracker) {
+			track_leaders(_documentIds.data(), input.counts.size());
+		}
+		// the spilled positions translate through these into _tcm, so the file's own map can go
+		Spilled_stream spilled { input.spill_file_name, std::vector<std::uint32_t>(_documentIds.size()) };
+		for (std::size_t p = 0; p < _documentIds.size(); ++p) {
+			spilled.positions[p] = static_cast<std::uint32_t>(_documentIds[p]);
+		}
+		_tokenStreams.push_back(std::move(spilled));
+	}
+	
+	void Counter::merge_input(const std::string&, const Token_sample& sample) {
+		_runs.clear();
+		_documentIds.resize(sample.counts.size());
+		_tcm.add_batch(sample.counts.cbegin(), sample.counts.cend(), _documentIds.data());
+		_sampleEstimator.add(sample, _documentIds.data());
+	}
+	
+	void Counter::set_sampling(double fraction, std::uint64_t seed) {
+		if (!(fraction >= 0 && fraction <= 1)) {
+			throw std::invalid_argument {"Counter can only sample a fraction from 0 to 1 of each file, not " + std::to_string(fraction)};
+		}
+		_sampleFraction = fraction;
+		_sampleSeed = seed;
+	}
+	
+	std::vector<Count_estimate> Counter::sample_estimates(std::size_t k) const {
+		if (!_estimated) {
+			throw std::logic_error {"Counter's last count wasn't sampled; call set_sampling() first."};
+		}
+		return _sampleEstimator.top(_tcm, k);
+	}
+	
+	void Counter::write_token_ids() {
+		// IDs follow the output order, from the most frequent token on
+		auto entries = _tcm.cbegin();
+		std::vector<std::uint32_t> order(_tcm.size());
+		for (std::uint32_t p = 0; p < order.size(); ++p) {
+			order[p] = p;
+		}
+		std::sort(order.begin(), order.end(), [entries](std::uint32_t a, std::uint32_t b) {
+			return entries[a].second > entries[b].second
+				|| (entries[a].second == entries[b].second && entries[a].first < entries[b].first);
+		});
+		std::vector<std::uint32_t> ids(order.size()); // position in _tcm -> ID
+		{
+			const std::string vocabularyFileName = vocabulary_file_name(_idDirectory);
+			std::ofstream vocabulary { vocabularyFileName };
+			if (!vocabulary.is_open()) {
+				throw std::invalid_argument {"Counter unable to open vocabulary file: " + vocabularyFileName};
+			}
+			for (std::uint32_t id = 0; id < order.size(); ++id) {
+				ids[order[id]] = id;
+				vocabulary << entries[order[id]].first << '\n';
+			}
+		}
+		
+		// each file's spilled stream is translated on a task of its own, then removed
+		std::vector<std::future<void>> writes;
+		writes.reserve(_tokenStreams.size()); // so keeping a future can't throw
+		for (std::size_t f = 0; f < _tokenStreams.size(); ++f) {
+			auto encode = [this, &ids, f]() {
+				Spilled_stream& stream = _tokenStreams[f];
+				for (auto& p : stream.positions) {
+					p = ids[p]; // now from the file's own positions straight to IDs
+				}
+				{
+					Id_file_reader spill { stream.file_name };
+					Id_file_writer writer { id_file_name(_idDirectory, f) };
+					for (std::uint32_t p; spill.get(p); ) {
+						writer.put(stream.positions[p]);
+					}
+					writer.flush();
+				}
+				std::remove(stream.file_name.c_str());
+				std::vector<std::uint32_t>().swap(stream.positions);
+			};
+			writes.push_back(_pool ? _pool->async(encode) : std::async(std::launch::async, encode));
+		}
+		// wait for every task before get() may throw, so none outlives ids
+		for (auto& w : writes) {
+			w.wait();
+		}
+		for (auto& w : writes) {
+			w.get();
+		}
+	}
+	
+	void Counter::merge_input(const std::string&, const Recovered_tokens& recovered) {
+		for (auto& tc : recovered.tokens) {
+			auto index = static_cast<std::size_t>(tc.second);
+			Token_view& survivor = _survivors[index];
+			if (survivor.empty()) {
+				survivor = _tcm.try_emplace(tc.first, _survivorCounts[index]).first->first; // stays put in _tcm's arena
+			}
+			else if (!(survivor == tc.first)) {
+				std::pair<std::string, std::string> collision { survivor.str(), tc.first.str() };
+				if (std::find(_collisions.begin(), _collisions.end(), collision) == _collisions.end()) {
+					_collisions.push_back(std::move(collision)); // once, though found in many files
+				}
+			}
+		}
+	}
+	
+	void Counter::merge_input(Token_view, const Token_count_map& aTCM) {
+		// texts are named by their position
+		merge_input(std::to_string(_documentStats ? _documentStats->document_count() : 0), aTCM);
+	}
+	
+	void Counter::collect_document_stats(bool enabled, bool keepPostings) {
+		if (enabled) {
+			_documentStats.reset(new Document_stats { keepPostings });
+		}
+		else {
+			_documentStats.reset();
+		}
+	}
+	
+	const Document_stats& Counter::document_stats() const {
+		if (!_documentStats) {
+			throw std::logic_error {"Counter isn't collecting document statistics; call collect_document_stats() first."};
+		}
+		return *_documentStats;
+	}
+	
+	void Counter::write_document_frequencies(std::ostream& out) const {
+		document_stats().write_document_frequencies(out, _tcm);
+	}
+	
+	void Counter::write_index(const std::string& fileName) const {
+		if (_ngramSize > 1) {
+			throw std::logic_error {"Counter indexes single tokens only, not n-grams."};
+		}
+		write_token_index(fileName, _tcm, _minCount);
+	}
+	
+	void Counter::write_postings(std::ostream& out) const {
+		document_stats().write_postings(out, _tcm);
+	}
+	
+	void Counter::clear_counts() noexcept {
+		_runs.clear();
+		_tokenStreams.clear();
+		_sampleEstimator.clear();
+		_estimated = false;
+		_fingerprints.clear();
+		_survivorCounts.clear();
+		_survivors.clear();
+		_collisions.clear();
+		_tcm.clear();
+		_ncm.clear();
+		if (_documentStats) {
+			_documentStats->clear();
+		}
+		if (_memoryProfile) {
+			_memoryProfile->clear();
+		}
+	}
+	
+	void Counter::set_memory_profiling(bool enabled) {
+		if (enabled == (_memoryProfile != nullptr)) {
+			return;
+		}
+		std::unique_ptr<Memory_profile> profile { enabled ? new Memory_profile : nullptr };
+		Memory_resource* resource = enabled ? &profile->resource(Memory_profile::merge) : new_delete_resource();
+		Token_count_map tcm { resource };
+		Ngram_count_map ncm { _ngramSize, resource };
+		_runs.clear();
+		_tcm.swap(tcm);
+		_ncm.swap(ncm);
+		_memoryProfile.swap(profile); // the old profile outlives the old maps
+	}
+	
+	const Memory_profile& Counter::memory_profile() const {
+		if (!_memoryProfile) {
+			throw std::logic_error {"Counter isn't profiling memory; call set_memory_profiling() first."};
+		}
+		return *_memoryProfile;
+	}
+	
+	void Counter::record_memory() {
+		if (_memoryProfile) {
+			_memoryProfile->record(Memory_profile::tokenize);
+			if (_ngramSize > 1) {
+				_memoryProfile->record(Memory_profile::merge, _ncm.size(), _ncm.load_factor());
 			}
 			else {
-				i->second += tc.second;
+				_memoryProfile->record(Memory_profile::merge, _tcm.size(), _tcm.load_factor());
+			}
+		}
+	}
+	
+	Count_result Counter::make_result() const {
+		Count_result result;
+		result.estimated = _estimated;
+		if (_ngramSize > 1) {
+			result.tokens.reserve(_ncm.size());
+			for (auto i = _ncm.cbegin(); i != _ncm.cend(); ++i) {
+				result.token_total += i->second;
+				if (i->second >= _minCount) {
+					result.tokens.emplace_back(_ncm.text_of(i), i->second);
+				}
+			}
+		}
+		else {
+			result.tokens.reserve(_tcm.size());
+			for (auto& tc : _tcm) {
+				result.token_total += tc.second;
+				if (tc.second >= _minCount) {
+					result.tokens.emplace_back(tc.first.str(), tc.second);
+				}
+			}
+		}
+		std::sort(result.tokens.begin(), result.tokens.end(), Output_sorting_file::TC_compare());
+		if (_memoryProfile) {
+			Allocation_stats footprint = sorted_footprint(result.tokens.cbegin(), result.tokens.cend(),
+														  sizeof(Output_sorting_file::Token_count), false);
+			footprint.live_bytes += (result.tokens.capacity() - result.tokens.size()) * sizeof(Output_sorting_file::Token_count);
+			footprint.peak_bytes = footprint.live_bytes;
+			_memoryProfile->record("sort", footprint, result.tokens.size());
+		}
+		return result;
+	}
+	
+	void Counter::require_files() const {
+		if (_ifl == nullptr || _osf == nullptr) {
+			throw std::logic_error {"Counter was made without input and output files; use count_files() or count_texts() instead."};
+		}
+	}
+	
+	void Counter::require_plain_deduplication() const {
+		if (!_deduplicate) {
+			return;
+		}
+		if (_documentStats) {
+			throw std::logic_error {"Counter can't deduplicate while collecting document statistics, as each copy is a document."};
+		}
+		if (_sampleFraction > 0 || !_idDirectory.empty() || !_checkpointFileName.empty() || _fingerprinting) {
+			throw std::logic_error {"Counter deduplicates plain counts only, not sampled, checkpointed or fingerprinted ones, nor ones writing token IDs."};
+		}
+	}
+	
+	void Counter::add_map(const Token_count_map& aTCM) {
+		// a new key is copied into _tcm's own key arena
+		_runs.clear(); // may point into entries that are about to move
+		if (_tracker) {
+			_documentIds.resize(aTCM.size());
+			_tcm.add_batch(aTCM.cbegin(), aTCM.cend(), _documentIds.data());
+			track_leaders(_documentIds.data(), aTCM.size());
+		}
+		else {
+			_tcm.add_batch(aTCM.cbegin(), aTCM.cend());
+		}
+	}
+	
+	void Counter::add_map(const Ngram_count_map& aNCM) {
+		// token IDs are translated into _ncm's own
+		if (!_tracker) {
+			_ncm.add_map(aNCM);
+			return;
+		}
+		_documentIds.resize(aNCM.size());
+		_ncm.add_map(aNCM, _documentIds.data());
+		for (auto p : _documentIds) {
+			auto entry = _ncm.cbegin() + p;
+			if (_tracker->may_lead(entry->second)) {
+				_tracker->offer(_ncm.text_of(entry), entry->second); // only leaders' texts are made
+			}
+		}
+	}
+	
+	void Counter::track_leaders(const Token_count_map::size_type* positions, Token_count_map::size_type n) {
+		for (Token_count_map::size_type k = 0; k < n; ++k) {
+			auto& tc = _tcm.cbegin()[positions[k]];
+			if (_tracker->may_lead(tc.second)) {
+				_tracker->offer(tc.first, tc.second);
 			}
 		}
 	}
 
 	void Counter::generate_output() {
+		require_files();
 		_osf->clear();
-		_osf->set_sorted(_tcm);
-		_osf->write_to_file();
+		_runs.clear();
+		if (_ngramSize > 1) {
+			_osf->set_sorted(_ncm, _minCount);
+			if (_memoryProfile) {
+				// a red-black tree node holds the item, three links and a color
+				Allocation_stats footprint = sorted_footprint(_osf->cbegin(), _osf->cend(),
+															  sizeof(Output_sorting_file::Token_count) + 4 * sizeof(void*), true);
+				_memoryProfile->record("sort", footprint, _osf->token_count());
+			}
+			_osf->write_to_file();
+		}
+		else {
+			_runs.sort(_tcm, _minCount, _pool);
+			if (_memoryProfile) {
+				Allocation_stats footprint;
+				footprint.live_bytes = footprint.peak_bytes = _runs.memory_bytes();
+				footprint.allocations = 2;
+				_memoryProfile->record("sort", footprint, _runs.size());
+			}
+			_osf->write_to_file(_runs, _estimated, _pool);
+		}
+	}
+	
+	void Counter::result_to_output(std::ostream& out) {
+		require_files();
+		if (_ngramSize > 1) {
+			_osf->write_to_output(out);
+		}
+		else {
+			_runs.write(out, _estimated);
+		}
+	}
+
+}
+
+namespace counterLib {
+
+	void Count_result::write_to_output(std::ostream& out) const {
+		for (auto& tc : tokens) {
+			out << tc.first << (estimated ? ", ~" : ", ") << tc.second << std::endl;
+		}
 	}
 
 }
@@ -11,13 +11,60 @@
 #include "Input_file_list.hpp"
 #include "File_token_counter.hpp"
 #include "Output_sorting_file.hpp"
+#include "Thread_pool.hpp"
+#include "Node_pools.hpp"
+#include "Document_stats.hpp"
+#include "Memory_profile.hpp"
+#include "Input_dedup.hpp"
+#include "Count_job.hpp"
+#include "Token_ids.hpp"
+#include "Sample_estimate.hpp"
+#include "Token_index.hpp"
+#include "Shard.hpp"
+#include "Checkpoint.hpp"
+#include "Count_schedule.hpp"
+#include <memory>
+#include <vector>
 
 namespace counterLib {
 
+	/**
+	 The result of a counting job run through the library API
+	 (Counter::count_files() and friends): every unique token and its count,
+	 sorted as the output file is, from most to least frequent.
+	 Owns its tokens, so it stays valid after the Counter is reused or destroyed.
+	 */
+	struct Count_result {
+		std::vector<Output_sorting_file::Token_count> tokens; // or n-grams; sorted by Output_sorting_file::TC_compare
+		unsigned long long token_total = 0; // all tokens counted, not just unique ones
+		bool estimated = false; // counts extrapolated from a sample (see Counter::set_sampling())
+		
+		/**
+		 Gets the number of unique tokens.
+
+		 @return The number of unique tokens counted.
+		 */
+		unsigned long unique_token_count() const noexcept { return tokens.size(); }
+		
+		/**
+		 Writes the tokens and their counts to the given stream,
+		 in the same format as the output file (estimates marked "~").
+
+		 @param out [IN/OUT] The output stream to write to.
+		 */
+		void write_to_output(std::ostream& out) const;
+	};
+
 	/**
 	 Main class for the 'counter' program.
 	 Brings together all other classes.
 	 Directly instantiated and called in main().
+	 Also usable as a library: make one with the pool constructor and call
+	 count_files(), count_file_list() or count_texts() as often as needed.
+	 An instance keeps its warm map between calls, so reusing one is cheaper
+	 than making a new one per job.
+	 Separate instances share no state, so they may be used from different
+	 threads at the same time; a single instance is not thread-safe.
 	 All other custom classes for this program essentially wrap files.
 	 Following RAII (Resource Acquisition Is Initialization),
 	 each of the other classes opens a file for the name passed to its constructor.
@@ -29,12 +76,6 @@ namespace counterLib {
 	 */
 	class Counter {
 	public:
-		/**
-		 The minimum number of files to be tokenized
-		 when concurrency methods will be invoked.
-		 */
-		static const int concurrency_file_number_threshold; 
-		
 		/**
 		 Singleton Constructor.
 		 Returns only one instance of Counter per session.
@@ -46,6 +87,59 @@ namespace counterLib {
 		 */
 		static Counter* singleton_instance(const char* inputFileName, const char* outputFileName);
 		
+		/**
+		 Initializing Constructor
+		 
+		 Opens the named input file for reading and
+		 the named output file for writing.
+		 Unlike singleton_instance(), makes an independent Counter,
+		 so one process can run any number of counting jobs,
+		 for example in server mode (see Count_server).
+		 
+		 @param inputFileName [IN] The filename (path) of the input file,
+		 	which contains a list of filenames, one filename per line.
+		 	The files should contain UTF-8 text for tokenization and counting.
+		 
+		 @param outputFileName [IN/OUT] The filename (path) of the output file.
+		 
+		 @param pool [IN] Optional thread pool to run concurrent counting tasks on.
+			If null, std::async is used. Must outlive this object.
+		 
+		 @param arenas [IN] Optional pool of arenas for the per-file token maps,
+			so that they stay warm from job to job.
+			If null, this object keeps its own. Must outlive this object.
+		 */
+		Counter(const std::string& inputFileName, const std::string& outputFileName,
+				Thread_pool* pool = nullptr, Arena_pool* arenas = nullptr);
+		
+		/**
+		 Library Constructor
+		 
+		 Makes a Counter without input or output files,
+		 for use through count_files(), count_file_list() and count_texts().
+		 The file based members (execute(), count_tokens() and so on)
+		 throw std::logic_error on such an instance.
+		 
+		 @param pool [IN] Optional thread pool to run concurrent counting tasks on.
+			If null, std::async is used. Must outlive this object.
+		 
+		 @param arenas [IN] Optional pool of arenas for the per-input token maps.
+			If null, this object keeps its own. Must outlive this object.
+		 */
+		explicit Counter(Thread_pool* pool = nullptr, Arena_pool* arenas = nullptr);
+		
+		/**
+		 Copy constructor (deleted)
+		 
+		 Deleted because the contained file streams can't be copied.
+		 */
+		Counter(const Counter&) = delete;
+		
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Counter& operator= (const Counter&) = delete;
+		
 		/**
 		 Destructor
 		 *
@@ -60,6 +154,23 @@ namespace counterLib {
 		 Equivalent to running count_tokens() and then generate_output().
 		 */
 		void execute();
+		
+		/**
+		 Runs execute() on a background thread, returning at once.
+		 The returned handle reports the job's progress (inputs and bytes counted),
+		 snapshots the topK most frequent tokens so far, and cancels the job.
+		 Snapshots are kept up to date as each input is merged, at a cost in topK,
+		 not in the number of unique tokens, and without pausing the workers.
+		 Single inputs are then counted on a task of their own too, so they can be merged
+		 as they are done; with node pools the snapshots only fill at the end,
+		 as per-node results are merged last.
+		 This object must outlive the job, and mustn't be used until the job is finished.
+		 A cancelled job leaves no counts and no output.
+
+		 @param topK [IN] Number of tokens (or n-grams) snapshots hold. 0 keeps none.
+		 @return Handle to the job.
+		 */
+		Count_job execute_async(std::size_t topK = 10);
 
 		/**
 		 Tokenizes the files listed in the input file, 
@@ -83,6 +194,8 @@ namespace counterLib {
 		 Sorts the unique tokens according to their frequency (from most to least),
 		 Then writes them to the output file. Each line is a token, 
 		 followed by its frequency.
+		 Single tokens are sorted in slices on the worker threads, and the sorted
+		 runs are merged as they are written (see Sorted_runs), with no copy of the tokens.
 		 */
 		void generate_output();
 		
@@ -91,35 +204,480 @@ namespace counterLib {
 
 		 @param out [IN/OUT] The output stream to write to.
 		 */
-		void result_to_output(std::ostream& out) {
-			_osf->write_to_output(out);
-		}
+		void result_to_output(std::ostream& out);
 		
 		/**
 		 Adds the given Token_count_map to that of this object.
+		 New keys are copied into this object's own arena,
+		 so aTCM (and its arena) may be destroyed afterwards.
 
 		 @param aTCM [IN] The Token_count_map to add.
 		 */
 		void add_map(const Token_count_map& aTCM);
 		
+		/**
+		 Adds the given Ngram_count_map to that of this object,
+		 translating its token IDs.
+
+		 @param aNCM [IN] The Ngram_count_map to add. Must count the same n as this object.
+		 */
+		void add_map(const Ngram_count_map& aNCM);
+		
+		/**
+		 Switches between counting single tokens (n of 1, the default)
+		 and counting n-grams: runs of n consecutive tokens, such as bigrams for 2.
+		 Affects every counting member function and the output,
+		 where an n-gram is written as its tokens separated by single spaces.
+		 N-grams never run from one file (or text) into the next.
+		 Throws std::invalid_argument if n is 0 or greater than Ngram_count_map::max_n.
+
+		 @param n [IN] Number of tokens per counted item.
+		 */
+		void set_ngram_size(unsigned n);
+		
+		/**
+		 Gets the number of tokens per counted item.
+
+		 @return 1 when counting single tokens, otherwise the n of the n-grams.
+		 */
+		unsigned ngram_size() const noexcept { return _ngramSize; }
+		
+		/**
+		 Sets the stopwords to drop while tokenizing, so they are never counted
+		 (nor stored, sorted or written). With n-grams, n-grams run over them.
+
+		 @param stopwords [IN] The stopwords. An empty set (the default) drops nothing.
+		 */
+		void set_stopwords(Stopword_set stopwords);
+		
+		/**
+		 Sets the smallest count a token (or n-gram) needs to be in the output.
+		 Rarer ones are still counted, but pruned before sorting,
+		 so they cost neither sorting nor writing.
+		 Doesn't affect document statistics.
+
+		 @param minCount [IN] The minimum count. 1 (the default) keeps everything.
+		 */
+		void set_min_count(Count minCount) noexcept;
+		
+		/**
+		 Makes this object count one shard of a count split between processes,
+		 each running a Counter on the same inputs with its own shard of the same count
+		 (see launch_shards() for running them on one machine).
+		 By files, the input file list (of the initializing constructor) keeps only
+		 this shard's files (see Input_file_list::keep_shard()), for good;
+		 the shards' counts then overlap and must be added up (see merge_shard_outputs()),
+		 so prune them only after that. By tokens, every input is tokenized but
+		 only this shard's tokens are counted (see Shard::owns()), or the n-grams
+		 starting with them; each shard's counts are then whole and disjoint from the others',
+		 so its output can be pruned as usual, and the outputs merged or just concatenated.
+		 Counting by tokens holds a 1/count share of the table, but still reads everything.
+		 Throws std::logic_error to split by files without an input file list.
+		 Counting a shard of the tokens with token IDs on throws std::logic_error too,
+		 as its IDs would cover only its own tokens.
+
+		 @param shard [IN] This object's shard; the whole count (the default) to stop splitting by tokens.
+		 @param mode [IN] How the count is split.
+		 */
+		void set_shard(const Shard& shard, Shard_mode mode);
+		
+		/**
+		 Sets NUMA node pools to count single tokens on, instead of one task per input.
+		 Each node then runs one task per CPU, each counting inputs into its own table
+		 (in an arena of its node) until none are left; the tables of each node are
+		 merged on that node, and only the per-node results are merged across nodes.
+		 N-gram counting and document statistics keep to one task per input.
+
+		 @param nodes [IN] The node pools, or null (the default) to stop using them.
+			Must outlive their use by this object.
+		 */
+		void set_node_pools(Node_pools* nodes) noexcept { _nodes = nodes; }
+		
+		/**
+		 Sets the figures counts are planned with (see plan_count()): before counting files or texts,
+		 their sizes are taken (files are stat'ed) and a cost model decides whether to count
+		 serially or in parallel, which small inputs share a task, and which tasks start first
+		 (the costliest). A worker count of 0 (the default) plans for the thread pool's threads,
+		 or without one the hardware's. Document statistics keep a task per input, in list order.
+		 Checkpointing, sampling, token IDs and counting by fingerprint run a task per file regardless.
+
+		 @param policy [IN] The figures.
+		 */
+		void set_schedule_policy(const Schedule_policy& policy) noexcept { _schedulePolicy = policy; }
+		
+		/**
+		 Gets the plan the last count of files or texts ran by (see set_schedule_policy()).
+
+		 @return The plan, valid until the next count.
+		 */
+		const Count_schedule& schedule() const noexcept { return _schedule; }
+		
+		/**
+		 Turns on (or off) checkpointing, for long counts of files that may die part way
+		 (out of memory, preempted). Files are then counted one task per file and merged
+		 in list order, so the files done are always the first of the list; at the given
+		 interval, a snapshot of the merged table and of how many files are done is written
+		 in the background (see Checkpoint_writer), and a last one once counting is done.
+		 With resume, a count starts from the snapshot, if there is one, and skips the files it holds.
+		 A snapshot from another list (its first files named otherwise) throws std::invalid_argument.
+		 Applies to the counting of files, in place of node pools; only single tokens
+		 are supported, and counting n-grams, document statistics or deduplicated files
+		 with it on throws std::logic_error. Sampling and token IDs go without it.
+
+		 @param fileName [IN] Filename (path) of the snapshot; empty (the default) to stop.
+		 @param interval [IN] Least time between snapshots.
+		 @param resume [IN] Whether to start from the snapshot.
+		 */
+		void set_checkpointing(const std::string& fileName, std::chrono::milliseconds interval = std::chrono::seconds { 60 },
+							   bool resume = false);
+		
+		/**
+		 Turns on (or off) counting by fingerprint, to count a large vocabulary in less memory.
+		 A first pass counts each token under its 64-bit fingerprint only (see Fingerprint_count_map),
+		 16 bytes a token and no strings, and a second pass reads the files again to recover
+		 the strings of just the tokens counted at least the minimum count (see set_min_count()).
+		 So memory drops as far as the minimum count prunes the vocabulary;
+		 with a minimum count of 1 every string is recovered and only the second read is added.
+		 The counts are exact unless two tokens share a fingerprint: if they do and would be
+		 written out, the second pass finds both and fingerprint_collisions() reports them,
+		 the one found first being written with their summed count.
+		 Applies to the counting of files, which mustn't change between the passes,
+		 in place of node pools; only single tokens are supported, and counting n-grams,
+		 document statistics or deduplicated files with it on throws std::logic_error.
+		 Sampling, token IDs and checkpointing go without it.
+
+		 @param enabled [IN] Whether to count by fingerprint.
+		 */
+		void set_fingerprinting(bool enabled) noexcept { _fingerprinting = enabled; }
+		
+		/**
+		 Gets the pairs of tokens found sharing a fingerprint by the last count by fingerprint,
+		 each pair counted as one token, under the first.
+
+		 @return The pairs, valid until the next count; normally none.
+		 */
+		const std::vector<std::pair<std::string, std::string>>& fingerprint_collisions() const noexcept { return _collisions; }
+		
+		/**
+		 Turns on (or off) deduplicating the input files before counting:
+		 a file listed more than once, or byte-identical to another listed file,
+		 is tokenized once and its counts multiplied by its number of copies
+		 (see deduplicate_inputs()). The counts are exactly those without it.
+		 Plain counts only: counting with it and document statistics (each copy being
+		 a document), sampling, checkpointing, fingerprinting or token IDs throws std::logic_error.
+
+		 @param enabled [IN] Whether to deduplicate.
+		 */
+		void set_deduplication(bool enabled) noexcept { _deduplicate = enabled; }
+		
+		/**
+		 Turns on (or off) writing each counted file as a stream of token IDs,
+		 so the corpus needn't be tokenized again downstream.
+		 IDs are dense and follow the output order (the most frequent token is 0),
+		 and the vocabulary file lists the tokens in ID order, whatever the minimum count
+		 (see Token_ids.hpp for the file names and the varint format).
+		 Each file's task spills its token stream to a temporary file in the directory
+		 as it counts, and once counting is done the spilled files are translated
+		 to IDs in parallel, so each file is tokenized once, and only the positions
+		 of each file's distinct tokens are held in memory, not its stream.
+		 Applies to the counting of files (execute(), count_files() and so on);
+		 they are then counted one task per file, not on node pools. Only single tokens
+		 are supported; counting n-grams or deduplicated files with it on throws std::logic_error.
+		 Throws std::invalid_argument if a file can't be written.
+
+		 @param directory [IN] Directory to write to, made if missing; empty (the default) to stop.
+		 */
+		void set_token_id_output(const std::string& directory) { _idDirectory = directory; }
+		
+		/**
+		 Turns on (or off) sampling: a quick preview of the counts of files,
+		 estimated from a random fraction of each file rather than counted in full.
+		 Each file is read as randomly chosen blocks aligned to whole tokens
+		 (see File_token_counter::add_sample_to_map()), tokenized as usual,
+		 and the counts are extrapolated to the whole files (see Sample_estimator).
+		 The output then holds the estimates, written "token, ~count",
+		 and sample_estimates() gives confidence intervals for the top tokens.
+		 Applies to the counting of files; only single tokens are supported, and
+		 counting n-grams, document statistics, token IDs or deduplicated files with it on throws std::logic_error.
+		 Throws std::invalid_argument if the fraction is above 1 or negative.
+
+		 @param fraction [IN] Fraction of each file to read; 0 (the default) counts everything.
+		 @param seed [IN] Seed of the block choice, so a preview can be repeated.
+		 */
+		void set_sampling(double fraction, std::uint64_t seed = 0);
+		
+		/**
+		 Gets the estimates of the tokens with the highest estimated counts,
+		 with 95% confidence intervals, from the last count.
+		 Throws std::logic_error unless the last count was sampled.
+
+		 @param k [IN] Most tokens to get.
+		 @return Up to k estimates, in output order.
+		 */
+		std::vector<Count_estimate> sample_estimates(std::size_t k) const;
+		
+		/**
+		 Turns on (or off) collecting document statistics while counting:
+		 the document frequency of each token (how many files, or texts, it occurs in)
+		 and optionally the postings of each document (its tokens' IDs and counts).
+		 They are gathered as the per-file maps are merged, so counting stays one pass.
+		 Only single tokens are supported; counting n-grams, or deduplicated files,
+		 with statistics on throws std::logic_error.
+
+		 @param enabled [IN] Whether to collect the statistics.
+		 @param keepPostings [IN] Whether to keep per-document postings as well.
+		 */
+		void collect_document_stats(bool enabled = true, bool keepPostings = false);
+		
+		/**
+		 Gets the document statistics of the last count.
+		 Throws std::logic_error if they aren't being collected.
+		 Texts given to count_texts() are named by their position ("0", "1", ...).
+
+		 @return The statistics, valid until the next count.
+		 */
+		const Document_stats& document_stats() const;
+		
+		/**
+		 Writes the document frequency of each token of the last count,
+		 as Document_stats::write_document_frequencies() does.
+
+		 @param out [IN/OUT] The output stream to write to.
+		 */
+		void write_document_frequencies(std::ostream& out) const;
+		
+		/**
+		 Writes an index of the tokens of the last count and their counts
+		 (those counted at least the minimum count), which a Token_index
+		 then queries in place: exact lookups, prefixes, top-K by prefix.
+		 Only single tokens are indexed; with n-grams it throws std::logic_error.
+
+		 @param fileName [IN] Filename (path) of the index file (see write_token_index()).
+		 */
+		void write_index(const std::string& fileName) const;
+		
+		/**
+		 Writes the postings of each document of the last count,
+		 as Document_stats::write_postings() does. Empty lines unless postings are kept.
+
+		 @param out [IN/OUT] The output stream to write to.
+		 */
+		void write_postings(std::ostream& out) const;
+		
+		/**
+		 Turns on (or off) memory profiling: counting the bytes and allocations
+		 of each stage of a count, and of each worker's table, with the load
+		 factors of the tables (see Memory_profile).
+		 Turning it on or off drops the counts so far.
+		 Without it, no counting resource is put in place, so counting costs nothing extra.
+
+		 @param enabled [IN] Whether to profile.
+		 */
+		void set_memory_profiling(bool enabled);
+		
+		/**
+		 Gets the memory profile of the last count (and sort).
+		 Throws std::logic_error if memory isn't being profiled.
+
+		 @return The profile, valid until the next count.
+		 */
+		const Memory_profile& memory_profile() const;
+		
+		/**
+		 Writes the memory profile of the last count, as Memory_profile::write() does.
+
+		 @param out [IN/OUT] The output stream to write to.
+		 */
+		void write_memory_profile(std::ostream& out) const { memory_profile().write(out); }
+		
+		/**
+		 Counts the tokens of the given files,
+		 concurrently when that pays (see set_schedule_policy()).
+		 Doesn't touch this object's input or output file, if it has any.
+
+		 @param filenames [IN] Filenames (paths) of files with UTF-8 text.
+		 @return The sorted token counts of all the files together.
+		 */
+		Count_result count_files(const std::vector<std::string>& filenames);
+		
+		/**
+		 Counts the tokens of the files listed in the named file,
+		 like count_files().
+
+		 @param inputFileName [IN] Filename (path) of a file listing
+			the files to count, one filename per line.
+		 @return The sorted token counts of all the listed files together.
+		 */
+		Count_result count_file_list(const std::string& inputFileName);
+		
+		/**
+		 Counts the tokens of texts already in memory,
+		 concurrently when that pays (see set_schedule_policy()).
+		 The texts are only read, and needn't outlive the call.
+
+		 @param texts [IN] The UTF-8 texts to count.
+		 @return The sorted token counts of all the texts together.
+		 */
+		Count_result count_texts(const std::vector<Token_view>& texts);
+		
 	private:
 		/**
-		 Initializing Constructor
-		 
-		 Opens the named input file for reading and
-		 the named output file for writing.
-		 
-		 @param inputFileName [IN] The filename (path) of the input file,
-		 	which contains a list of filenames, one filename per line.
-		 	The files should contain UTF-8 text for tokenization and counting.
-		 
-		 @param outputFileName [IN/OUT] The filename (path) of the output file.
+		 Counts each input on its own task (with its own leased arena)
+		 and merges the results into _tcm, in input order.
+
+		 @param first [IN] Start of the inputs.
+		 @param last [IN] End of the inputs.
+		 @param task [IN] Function making the Token_count_map of one input,
+			given the input and the arena for the map.
 		 */
-		Counter(const std::string& inputFileName, const std::string& outputFileName);
+		template <class Iter, class Task>
+		void merge_concurrently(Iter first, Iter last, Task task);
 		
+		/**
+		 Counts the given inputs into _tcm or _ncm as merge_concurrently() does,
+		 but with a task per batch of _schedule, started and merged in its order.
+		 */
+		template <class Iter, class Task>
+		void merge_scheduled(Iter first, Iter last, Task task);
+		
+		/**
+		 Plans the count of the given inputs into _schedule, from their sizes.
+		 */
+		template <class Iter>
+		void plan_inputs(Iter first, Iter last);
+		
+		/**
+		 Counts the given inputs (filenames or texts) into _tcm or _ncm,
+		 concurrently when the plan says it pays.
+		 */
+		template <class Iter>
+		void count_inputs(Iter first, Iter last);
+		
+		/**
+		 Counts the given files with count_inputs(), deduplicated first if asked to.
+		 */
+		template <class Iter>
+		void count_file_inputs(Iter first, Iter last);
+		
+		/**
+		 Counts the tokens of the given inputs into _tcm on the node pools,
+		 reducing within each node before merging across nodes.
+		 */
+		template <class Iter>
+		void count_by_node(Iter first, Iter last);
+		
+		/**
+		 Counts the given files spilling their token streams,
+		 then writes them as token IDs (see set_token_id_output()).
+		 The spilled files are removed whether or not the count succeeds.
+		 */
+		template <class Iter>
+		void encode_inputs(Iter first, Iter last);
+		
+		void write_token_ids(); // ranks the tokens of _tcm, then translates _tokenStreams
+		
+		/**
+		 Samples the given files into _tcm, replacing the counts with estimates
+		 (see set_sampling()).
+		 */
+		template <class Iter>
+		void sample_inputs(Iter first, Iter last);
+		
+		/**
+		 Counts the given files into _tcm from the snapshot, if resuming,
+		 writing snapshots as it goes (see set_checkpointing()).
+		 */
+		template <class Iter>
+		void checkpointed_inputs(Iter first, Iter last);
+		
+		/**
+		 Counts the given files into _tcm by fingerprint, then recovers the tokens
+		 of the fingerprints counted at least the minimum count (see set_fingerprinting()).
+		 */
+		template <class Iter>
+		void fingerprinted_inputs(Iter first, Iter last);
+		
+		/**
+		 Records a file as merged, for the next snapshot, and writes one if it is due.
+		 Inputs other than listed files aren't checkpointed.
+		 */
+		void checkpoint_input(const std::string& filename);
+		template <class Input>
+		void checkpoint_input(const Input&) noexcept { }
+		
+		void count_input(const std::string& filename); // counts one file on this thread
+		void count_input(Token_view text); // counts one text on this thread
+		void count_input(const Distinct_input& input); // counts one file's content times its copies
+		
+		/**
+		 Merges the map of one input (file or text) into _tcm,
+		 recording the input's document statistics if they are being collected.
+		 */
+		void merge_input(const std::string& filename, const Token_count_map& aTCM);
+		void merge_input(Token_view text, const Token_count_map& aTCM);
+		void merge_input(const Distinct_input&, const Token_count_map& aTCM) { add_map(aTCM); }
+		void merge_input(const std::string& filename, Token_stream& input); // keeps its stream, translated
+		void merge_input(const std::string& filename, const Token_sample& sample); // adds it to the estimates
+		template <class Input>
+		void merge_input(const Input&, const Ngram_count_map& aNCM) { add_map(aNCM); }
+		template <class Input>
+		void merge_input(const Input&, const Fingerprint_count_map& aFCM) { _fingerprints.add_map(aFCM); }
+		void merge_input(const std::string& filename, const Recovered_tokens& recovered); // keeps the strings
+		
+		/**
+		 Offers the tokens at the given positions of _tcm, just merged,
+		 to the leaders of the tracked job.
+		 */
+		void track_leaders(const Token_count_map::size_type* positions, Token_count_map::size_type n);
+		
+		void clear_counts() noexcept;
+		void record_memory(); // records the tokenize and merge stages, when profiling
+		const Stopword_set* stopwords() const noexcept { return _stopwords.empty() ? nullptr : &_stopwords; }
+		const Shard* shard() const noexcept { return _shard.whole() ? nullptr : &_shard; } // of the tokens to count
+		unsigned long unique_count() const noexcept { return _ngramSize > 1 ? _ncm.size() : _tcm.size(); }
+		Count_result make_result() const; // sorts _tcm (or _ncm) into a result
+		void require_files() const; // throws std::logic_error if made without files
+		void require_plain_deduplication() const; // throws std::logic_error if deduplicating with what can't be
+		
+
 		Input_file_list* _ifl;
 		Output_sorting_file* _osf;
+		Thread_pool* _pool; // not owned, may be null
+		Arena_pool _ownArenas; // used when no Arena_pool is given
+		Arena_pool* _arenas; // arenas of the per-file token maps
+		Node_pools* _nodes = nullptr; // not owned, null unless counting by node
+		Schedule_policy _schedulePolicy;
+		Count_schedule _schedule; // of the last count of files or texts
+		bool _deduplicate = false; // whether to count each distinct input file once
+		std::string _idDirectory; // where to write token IDs; empty unless writing them
+		std::vector<Spilled_stream> _tokenStreams; // each file's spilled tokens and how they translate into _tcm, until written
+		double _sampleFraction = 0; // of each file to sample; 0 counts in full
+		std::uint64_t _sampleSeed = 0;
+		std::string _checkpointFileName; // empty unless checkpointing
+		std::chrono::milliseconds _checkpointInterval { 0 };
+		bool _resume = false; // whether to start from the snapshot
+		std::unique_ptr<Checkpoint_writer> _checkpoint; // set while a checkpointed count runs
+		Checkpoint_progress _progress; // files merged by the checkpointed count
+		bool _fingerprinting = false; // whether to count by fingerprint, in two passes
+		Fingerprint_count_map _fingerprints; // the first pass's counts, while it runs
+		std::vector<Count> _survivorCounts; // counts of the fingerprints to recover, by index
+		std::vector<Token_view> _survivors; // the token recovered for each, in _tcm; empty until found
+		std::vector<std::pair<std::string, std::string>> _collisions; // tokens found sharing a fingerprint
+		Sample_estimator _sampleEstimator;
+		bool _estimated = false; // whether _tcm holds estimates, from sampling
+		Count_tracker* _tracker = nullptr; // not owned, set while an execute_async() job runs
+		std::unique_ptr<Memory_profile> _memoryProfile; // null unless profiling; outlives the maps using it
 		Token_count_map _tcm;
+		unsigned _ngramSize = 1; // 1 counts tokens into _tcm, more counts n-grams into _ncm
+		Ngram_count_map _ncm;
+		Sorted_runs _runs; // output order of _tcm, set by generate_output()
+		Stopword_set _stopwords; // dropped by the tokenizer
+		Shard _shard; // of the tokens counted, when split by tokens; otherwise whole
+		Count _minCount = 1; // smallest count written out
+		std::unique_ptr<Document_stats> _documentStats; // null unless collecting
+		Token_count_map _documentTCM; // one document's counts, when collecting serially
+		std::vector<Token_count_map::size_type> _documentIds; // IDs (positions) of one input's merged tokens or n-grams
+		std::vector<char> _textBuffer; // count_texts() scratch, kept warm between calls
 		
 	};
 	
@@ -128,9 +686,57 @@ namespace counterLib {
 	 Non-member function for use as a thread task in async concurrency.
 	 
 	 @param filename [IN] File name (path) to a file with UTF-8 text.
+	 @param arena [IN] Memory resource for the map's nodes and keys,
+		normally a Monotonic_arena owned by the calling thread's task.
+		Must outlive the returned map.
+	 @param stopwords [IN] Tokens to drop, or null. Must outlive the task.
+	 @param shard [IN] The shard of the tokens to count, or null for all. Must outlive the task.
 	 @return Token_count_map for the given file.
 	 */
-	Token_count_map get_file_token_map(std::string filename);
+	Token_count_map get_file_token_map(std::string filename, Memory_resource* arena,
+									   const Stopword_set* stopwords = nullptr, const Shard* shard = nullptr);
+	
+	/**
+	 Gets the token map of the given text.
+	 Non-member function for use as a thread task in async concurrency.
+	 
+	 @param text [IN] UTF-8 text, which must stay valid until the task is done.
+	 @param arena [IN] Memory resource for the map's nodes and keys.
+		Must outlive the returned map.
+	 @param stopwords [IN] Tokens to drop, or null. Must outlive the task.
+	 @param shard [IN] The shard of the tokens to count, or null for all. Must outlive the task.
+	 @return Token_count_map for the given text.
+	 */
+	Token_count_map get_text_token_map(Token_view text, Memory_resource* arena,
+									   const Stopword_set* stopwords = nullptr, const Shard* shard = nullptr);
+	
+	/**
+	 Gets the n-gram map of the file with the given filename.
+	 Non-member function for use as a thread task in async concurrency.
+	 
+	 @param filename [IN] File name (path) to a file with UTF-8 text.
+	 @param n [IN] Number of tokens per n-gram.
+	 @param arena [IN] Memory resource for the map. Must outlive the returned map.
+	 @param stopwords [IN] Tokens to drop, or null. Must outlive the task.
+	 @param shard [IN] The shard of the tokens to count, or null for all. Must outlive the task.
+	 @return Ngram_count_map for the given file.
+	 */
+	Ngram_count_map get_file_ngram_map(std::string filename, unsigned n, Memory_resource* arena,
+									   const Stopword_set* stopwords = nullptr, const Shard* shard = nullptr);
+	
+	/**
+	 Gets the n-gram map of the given text.
+	 Non-member function for use as a thread task in async concurrency.
+	 
+	 @param text [IN] UTF-8 text, which must stay valid until the task is done.
+	 @param n [IN] Number of tokens per n-gram.
+	 @param arena [IN] Memory resource for the map. Must outlive the returned map.
+	 @param stopwords [IN] Tokens to drop, or null. Must outlive the task.
+	 @param shard [IN] The shard of the tokens to count, or null for all. Must outlive the task.
+	 @return Ngram_count_map for the given text.
+	 */
+	Ngram_count_map get_text_ngram_map(Token_view text, unsigned n, Memory_resource* arena,
+									   const Stopword_set* stopwords = nullptr, const Shard* shard = nullptr);
 }
 
 #endif /* Counter_hpp */
@@ -0,0 +1,118 @@
+//
+//  Cpu_topology.cpp
+//  counter
+//
+
+#include "Cpu_topology.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace counterLib {
+
+	namespace {
+		/**
+		 One node with every hardware thread.
+		 */
+		std::vector<std::vector<unsigned>> single_node() {
+			unsigned count = std::thread::hardware_concurrency();
+			std::vector<unsigned> cpus(count == 0 ? 1 : count);
+			for (unsigned c = 0; c < cpus.size(); ++c) {
+				cpus[c] = c;
+			}
+			return { cpus };
+		}
+	}
+
+	Cpu_topology::Cpu_topology(std::vector<std::vector<unsigned>> nodes) {
+		for (auto& cpus : nodes) {
+			if (!cpus.empty()) {
+				std::sort(cpus.begin(), cpus.end());
+				_nodes.push_back(std::move(cpus));
+			}
+		}
+		if (_nodes.empty()) {
+			_nodes = single_node();
+		}
+	}
+
+	Cpu_topology Cpu_topology::detect() {
+		std::vector<std::vector<unsigned>> nodes;
+#if defined(__linux__)
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		bool haveMask = ::sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+		for (unsigned node = 0; ; ++node) {
+			std::ifstream cpulist { "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist" };
+			if (!cpulist.is_open()) {
+				break; // nodes are numbered densely on all but exotic machines
+			}
+			std::string list;
+			std::getline(cpulist, list);
+			std::vector<unsigned> cpus;
+			for (auto cpu : parse_cpu_list(list)) {
+				if (!haveMask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))) {
+					cpus.push_back(cpu);
+				}
+			}
+			nodes.push_back(std::move(cpus));
+		}
+#endif
+		return Cpu_topology { std::move(nodes) };
+	}
+
+	std::size_t Cpu_topology::cpu_count() const noexcept {
+		std::size_t count = 0;
+		for (auto& cpus : _nodes) {
+			count += cpus.size();
+		}
+		return count;
+	}
+
+	std::vector<unsigned> parse_cpu_list(const std::string& list) {
+		std::vector<unsigned> cpus;
+		std::stringstream parts { list };
+		std::string part;
+		while (std::getline(parts, part, ',')) {
+			char* end = nullptr;
+			unsigned long first = std::strtoul(part.c_str(), &end, 10);
+			if (end == part.c_str()) {
+				continue;
+			}
+			unsigned long last = first;
+			if (*end == '-') {
+				const char* lastStart = end + 1;
+				last = std::strtoul(lastStart, &end, 10);
+				if (end == lastStart || last < first) {
+					continue;
+				}
+			}
+			for (unsigned long cpu = first; cpu <= last; ++cpu) {
+				cpus.push_back(static_cast<unsigned>(cpu));
+			}
+		}
+		return cpus;
+	}
+
+	bool pin_current_thread(unsigned cpu) noexcept {
+#if defined(__linux__)
+		if (cpu >= CPU_SETSIZE) {
+			return false;
+		}
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+		(void)cpu; // macOS, for one, only offers affinity hints
+		return false;
+#endif
+	}
+
+}
@@ -0,0 +1,80 @@
+/**
+ *	@file Cpu_topology.hpp
+ *
+ *	Which CPUs belong to which NUMA node, and pinning threads to CPUs.
+ */
+
+#ifndef Cpu_topology_hpp
+#define Cpu_topology_hpp
+
+#include <string>
+#include <vector>
+
+namespace counterLib {
+
+	/**
+	 The NUMA nodes of the machine and the CPUs of each,
+	 limited to the CPUs this process may run on.
+
+	 On Linux this is read from /sys/devices/system/node.
+	 Elsewhere, or if that can't be read, the machine is taken to be
+	 a single node holding every hardware thread (the single-node fallback).
+	 */
+	class Cpu_topology {
+	public:
+		/**
+		 Initializing Constructor
+
+		 @param nodes [IN] The CPU numbers of each node. Nodes without CPUs are dropped.
+			If none are left, a single node with every hardware thread is used.
+		 */
+		explicit Cpu_topology(std::vector<std::vector<unsigned>> nodes);
+
+		/**
+		 Detects the topology of this machine.
+
+		 @return The nodes with CPUs this process may use.
+		 */
+		static Cpu_topology detect();
+
+		std::size_t node_count() const noexcept { return _nodes.size(); }
+
+		/**
+		 Gets the CPUs of a node.
+
+		 @param node [IN] Node position, from 0 to node_count() - 1.
+		 @return The node's CPU numbers, in increasing order.
+		 */
+		const std::vector<unsigned>& cpus(std::size_t node) const { return _nodes.at(node); }
+
+		/**
+		 Gets the total number of CPUs over all nodes.
+
+		 @return The number of CPUs.
+		 */
+		std::size_t cpu_count() const noexcept;
+
+	private:
+		std::vector<std::vector<unsigned>> _nodes;
+	};
+
+	/**
+	 Parses a Linux CPU list, such as "0-3,8,10-11".
+
+	 @param list [IN] The list.
+	 @return The CPU numbers listed, in the order given. Malformed parts are skipped.
+	 */
+	std::vector<unsigned> parse_cpu_list(const std::string& list);
+
+	/**
+	 Pins the calling thread to one CPU, so the scheduler can't move it
+	 (and the memory it first touches) to another core or node.
+
+	 @param cpu [IN] The CPU number.
+	 @return false where pinning isn't supported (anywhere but Linux) or failed.
+	 */
+	bool pin_current_thread(unsigned cpu) noexcept;
+
+}
+
+#endif /* Cpu_topology_hpp */
@@ -0,0 +1,86 @@
+//
+//  Document_stats.cpp
+//  counter
+//
+
+#include "Document_stats.hpp"
+#include <algorithm>
+#include <string>
+
+namespace counterLib {
+
+	void Document_stats::add_document(const std::string& name, Token_count_map::const_iterator first,
+									  Token_count_map::const_iterator last, const Token_count_map::size_type* ids) {
+		_documentNames.push_back(name);
+		for (auto entry = first; entry != last; ++entry, ++ids) {
+			if (*ids >= _documentFrequency.size()) {
+				_documentFrequency.resize(*ids + 1); // new tokens have the highest IDs
+			}
+			++_documentFrequency[*ids];
+			if (_keepPostings) {
+				_postings.push_back(Posting { static_cast<std::uint32_t>(*ids), entry->second });
+			}
+		}
+		_postingsEnd.push_back(_postings.size());
+	}
+
+	void Document_stats::clear() noexcept {
+		_documentFrequency.clear();
+		_documentNames.clear();
+		_postings.clear();
+		_postingsEnd.clear();
+	}
+
+	std::pair<const Document_stats::Posting*, const Document_stats::Posting*> Document_stats::postings(std::size_t document) const {
+		const Posting* base = _postings.data();
+		std::size_t start = document == 0 ? 0 : _postingsEnd.at(document - 1);
+		return { base + start, base + _postingsEnd.at(document) };
+	}
+
+	std::vector<std::uint32_t> Document_stats::sorted_ids(const Token_count_map& tokens) const {
+		std::vector<std::uint32_t> ids(tokens.size());
+		for (std::uint32_t id = 0; id < ids.size(); ++id) {
+			ids[id] = id;
+		}
+		auto entries = tokens.cbegin();
+		std::sort(ids.begin(), ids.end(), [this, entries](std::uint32_t a, std::uint32_t b) {
+			int dfA = document_frequency(a), dfB = document_frequency(b);
+			if (dfA != dfB) {
+				return dfA > dfB;
+			}
+			// as std::string compares, so ties are broken as in the main output
+			Token_view tokenA = entries[a].first, tokenB = entries[b].first;
+			int c = std::char_traits<char>::compare(tokenA.data(), tokenB.data(), std::min(tokenA.size(), tokenB.size()));
+			return c != 0 ? c < 0 : tokenA.size() < tokenB.size();
+		});
+		return ids;
+	}
+
+	void Document_stats::write_document_frequencies(std::ostream& out, const Token_count_map& tokens) const {
+		auto entries = tokens.cbegin();
+		for (auto id : sorted_ids(tokens)) {
+			out << entries[id].first << ", " << document_frequency(id) << '\n';
+		}
+		out.flush();
+	}
+
+	void Document_stats::write_postings(std::ostream& out, const Token_count_map& tokens) const {
+		// token ID -> line of the token in write_document_frequencies()
+		auto ids = sorted_ids(tokens);
+		std::vector<std::uint32_t> line(ids.size());
+		for (std::uint32_t l = 0; l < ids.size(); ++l) {
+			line[ids[l]] = l;
+		}
+
+		for (std::size_t d = 0; d < document_count(); ++d) {
+			out << document_name(d) << '\t';
+			auto p = postings(d);
+			for (auto posting = p.first; posting != p.second; ++posting) {
+				out << (posting == p.first ? "" : " ") << line[posting->token] << ':' << posting->count;
+			}
+			out << '\n';
+		}
+		out.flush();
+	}
+
+}
@@ -0,0 +1,120 @@
+/**
+ *	@file Document_stats.hpp
+ *
+ *	Per-document statistics gathered while per-file token maps are merged.
+ */
+
+#ifndef Document_stats_hpp
+#define Document_stats_hpp
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Token_count_map.hpp"
+
+namespace counterLib {
+
+	/**
+	 Collects, in the same pass as the overall count, what TF-IDF style
+	 consumers need beyond it: the document frequency of each token
+	 (the number of documents it occurs in) and, optionally,
+	 compact per-document postings (each token's ID and count in that document).
+
+	 A token's ID is its position in the merged Token_count_map,
+	 which Token_count_map::add_batch() reports as each document is merged.
+	 So the document frequencies are a plain vector indexed by ID,
+	 and no second hash table is needed.
+	 */
+	class Document_stats {
+	public:
+		/**
+		 One token of one document.
+		 */
+		struct Posting {
+			std::uint32_t token; // ID: position in the merged Token_count_map
+			Count count; // occurrences in the document
+		};
+
+		/**
+		 Initializing Constructor
+
+		 @param keepPostings [IN] Whether to keep the postings of each document,
+			or only the document frequencies.
+		 */
+		explicit Document_stats(bool keepPostings = false) : _keepPostings { keepPostings } { }
+
+		/**
+		 Records one document that has just been merged.
+
+		 @param name [IN] Name of the document, normally its filename.
+		 @param first [IN] Iterator to the first entry of the document's own token map.
+		 @param last [IN] Iterator to just past the last entry of the document's map.
+		 @param ids [IN] The merged map's ID of each entry, as given by Token_count_map::add_batch().
+		 */
+		void add_document(const std::string& name, Token_count_map::const_iterator first,
+						  Token_count_map::const_iterator last, const Token_count_map::size_type* ids);
+
+		/**
+		 Forgets all documents. Keeps capacity.
+		 */
+		void clear() noexcept;
+
+		bool keeps_postings() const noexcept { return _keepPostings; }
+		std::size_t document_count() const noexcept { return _documentNames.size(); }
+		const std::string& document_name(std::size_t document) const { return _documentNames.at(document); }
+
+		/**
+		 Gets the number of documents a token occurs in.
+
+		 @param token [IN] ID of the token in the merged map.
+		 @return The token's document frequency; 0 for a token no document has.
+		 */
+		int document_frequency(std::size_t token) const noexcept {
+			return token < _documentFrequency.size() ? _documentFrequency[token] : 0;
+		}
+
+		/**
+		 Gets the postings of a document, in the order its tokens were first seen.
+		 Empty unless postings are kept.
+
+		 @param document [IN] Position of the document, from 0 to document_count() - 1.
+		 @return Pointers to the first posting and just past the last one.
+		 */
+		std::pair<const Posting*, const Posting*> postings(std::size_t document) const;
+
+		/**
+		 Writes each token and its document frequency, one per line ("token, frequency"),
+		 sorted as the main output is: most frequent first, then alphabetically.
+
+		 @param out [IN/OUT] The output stream to write to.
+		 @param tokens [IN] The merged map the IDs refer to.
+		 */
+		void write_document_frequencies(std::ostream& out, const Token_count_map& tokens) const;
+
+		/**
+		 Writes the postings, one document per line: its name, a tab, then space separated
+		 "ID:count" pairs. So that no vocabulary file is needed, an ID here is the (0-based)
+		 line of the token in the output of write_document_frequencies().
+
+		 @param out [IN/OUT] The output stream to write to.
+		 @param tokens [IN] The merged map the IDs refer to.
+		 */
+		void write_postings(std::ostream& out, const Token_count_map& tokens) const;
+
+	private:
+		/**
+		 Gets the token IDs in write_document_frequencies() order.
+		 */
+		std::vector<std::uint32_t> sorted_ids(const Token_count_map& tokens) const;
+
+		bool _keepPostings;
+		std::vector<int> _documentFrequency; // indexed by token ID
+		std::vector<std::string> _documentNames;
+		std::vector<Posting> _postings; // all documents, one after another
+		std::vector<std::size_t> _postingsEnd; // end of each document's postings in _postings
+	};
+
+}
+
+#endif /* Document_stats_hpp */
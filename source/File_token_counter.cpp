@@ -6,19 +6,284 @@
 //
 
 #include "File_token_counter.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <random>
 
 namespace counterLib {
+	const std::size_t File_token_counter::read_buffer_size = 64 * 1024;
+	const std::size_t File_token_counter::sample_block_size = 16 * 1024;
+
+	namespace {
+		/**
+		 Token sink counting single tokens into a Token_count_map.
+		 Tokens are collected and handed to the map a batch at a time,
+		 so it can overlap their lookups.
+		 */
+		class Token_batcher {
+		public:
+			/**
+			 @param tcm [IN/OUT] The map to count into.
+			 @param positions [IN/OUT] Receives each token's position in tcm, if not null.
+			 @param shard [IN] The shard whose tokens to count, or null for all.
+			 @param spill [IN/OUT] Is written each token's position in tcm, if not null.
+			 */
+			explicit Token_batcher(Token_count_map& tcm, std::vector<std::uint32_t>* positions = nullptr,
+								   const Shard* shard = nullptr, Id_file_writer* spill = nullptr) :
+				_tcm(tcm), _positions { positions }, _shard { shard }, _spill { spill } { }
+			
+			void operator() (Token_view token) {
+				if (_shard && !_shard->owns(token)) {
+					return;
+				}
+				_batch[_batched++] = token;
+				if (_batched == Token_count_map::batch_size) {
+					flush();
+				}
+			}
+			
+			void flush() {
+				if (_positions || _spill) {
+					Token_count_map::size_type positions[Token_count_map::batch_size];
+					_tcm.add_batch(_batch, _batched, positions);
+					if (_positions) {
+						_positions->insert(_positions->end(), positions, positions + _batched);
+					}
+					if (_spill) {
+						for (std::size_t k = 0; k < _batched; ++k) {
+							_spill->put(static_cast<std::uint32_t>(positions[k]));
+						}
+					}
+				}
+				else {
+					_tcm.add_batch(_batch, _batched);
+				}
+				_batched = 0;
+			}
+			
+		private:
+			Token_count_map& _tcm;
+			std::vector<std::uint32_t>* _positions; // not owned, may be null
+			const Shard* _shard; // not owned, may be null
+			Id_file_writer* _spill; // not owned, may be null
+			Token_view _batch[Token_count_map::batch_size]; // views into the read buffer
+			std::size_t _batched = 0;
+		};
+		
+		/**
+		 Token sink counting n-grams into an Ngram_count_map.
+		 Keeps the IDs of the last n tokens in a sliding window,
+		 so an n-gram is never built as a string.
+		 The window lives as long as the sink, one input,
+		 so n-grams run across read blocks but never from one file into the next.
+		 With a shard, only the n-grams whose first token is the shard's are counted,
+		 so the shards split the n-grams as they split the tokens.
+		 */
+		class Ngram_batcher {
+		public:
+			explicit Ngram_batcher(Ngram_count_map& ncm, const Shard* shard = nullptr) :
+				_ncm(ncm), _n { ncm.n() }, _shard { shard } { }
+			
+			void operator() (Token_view token) {
+				Ngram_count_map::Token_id id = _ncm.intern(token); // copies a new token, so no view outlives the block
+				const bool owned = !_shard || _shard->owns(token);
+				if (_filled < _n) {
+					_owned[_filled] = owned;
+					_window[_filled++] = id;
+				}
+				else {
+					std::memmove(_window, _window + 1, (_n - 1) * sizeof(id));
+					std::memmove(_owned, _owned + 1, (_n - 1) * sizeof(bool));
+					_window[_n - 1] = id;
+					_owned[_n - 1] = owned;
+				}
+				if (_filled == _n && _owned[0]) {
+					std::memcpy(_batch + _batched * _n, _window, _n * sizeof(id));
+					if (++_batched == Token_count_map::batch_size) {
+						flush();
+					}
+				}
+			}
+			
+			void flush() {
+				_ncm.add_batch(_batch, _batched);
+				_batched = 0;
+			}
+			
+		private:
+			Ngram_count_map& _ncm;
+			unsigned _n;
+			Ngram_count_map::Token_id _window[Ngram_count_map::max_n]; // the last n token IDs
+			const Shard* _shard; // not owned, may be null
+			bool _owned[Ngram_count_map::max_n]; // whether each token of the window is the shard's
+			unsigned _filled = 0;
+			Ngram_count_map::Token_id _batch[Token_count_map::batch_size * Ngram_count_map::max_n];
+			std::size_t _batched = 0;
+		};
+		
+		/**
+		 Token sink counting single tokens by fingerprint into a Fingerprint_count_map,
+		 so no token's string is kept.
+		 */
+		class Fingerprint_sink {
+		public:
+			explicit Fingerprint_sink(Fingerprint_count_map& fcm, const Shard* shard = nullptr) :
+				_fcm(fcm), _shard { shard } { }
+			
+			void operator() (Token_view token) {
+				if (!_shard || _shard->owns(token)) {
+					_fcm.add(token_fingerprint(token));
+				}
+			}
+			
+			void flush() { }
+			
+		private:
+			Fingerprint_count_map& _fcm;
+			const Shard* _shard; // not owned, may be null
+		};
+		
+		/**
+		 Token sink keeping the strings of the tokens whose fingerprints are wanted,
+		 each mapped to the count its fingerprint has in the wanted map.
+		 A token's string is copied the first time it turns up only.
+		 */
+		class Recovery_sink {
+		public:
+			Recovery_sink(const Fingerprint_count_map& wanted, Token_count_map& found, const Shard* shard = nullptr) :
+				_wanted(wanted), _found(found), _shard { shard } { }
+			
+			void operator() (Token_view token) {
+				if (_shard && !_shard->owns(token)) {
+					return;
+				}
+				const Fingerprint_count_map::Entry* entry = _wanted.find(token_fingerprint(token));
+				if (entry) {
+					_found.try_emplace(token, entry->count);
+				}
+			}
+			
+			void flush() { }
+			
+		private:
+			const Fingerprint_count_map& _wanted;
+			Token_count_map& _found;
+			const Shard* _shard; // not owned, may be null
+		};
+		
+		/**
+		 Hands the whitespace delimited tokens of [first, last) to the sink.
+		 The sink may hold on to views into this block,
+		 so it is always flushed before returning.
+		 
+		 @param first [IN/OUT] Start of the text. Tokens are cleaned in place.
+		 @param last [IN] End of the text.
+		 @param atEnd [IN] Whether last is the end of the input.
+			If not, a token running up to last may continue in the next block.
+		 @param sink [IN/OUT] Token_batcher, Ngram_batcher or another sink to add to.
+		 @param stopwords [IN] Tokens to drop, or null.
+		 @return Start of a token cut off at last, not counted yet; last if none.
+		 */
+		template <class Sink>
+		char* count_block(char* first, char* last, bool atEnd, Sink& sink, const Stopword_set* stopwords) {
+			char* p = first;
+			for (;;) {
+				while (p != last && isspace(static_cast<unsigned char>(*p))) {
+					++p;
+				}
+				char* wordStart = p;
+				while (p != last && !isspace(static_cast<unsigned char>(*p))) {
+					++p;
+				}
+				if ((p == last && !atEnd) || wordStart == p) {
+					sink.flush();
+					return p == last && !atEnd ? wordStart : last; // a cut off token may continue in the next block
+				}
+				Token_view token = clean_token(wordStart, p);
+				if (!token.empty() && !(stopwords && stopwords->contains(token))) {
+					sink(token);
+				}
+			}
+		}
+		
+		/**
+		 Reads the whole input, block by block, into the buffer and counts its tokens.
+		 A token cut off at the end of a block is moved to the front of the buffer
+		 and completed by the next block.
+		 
+		 @param read [IN] Function (char* destination, size_t size) filling destination
+			with up to size bytes of input and returning how many it filled.
+			Fewer than size means the input is done.
+		 @param buffer [IN/OUT] The read buffer. Grown only for a token longer than itself.
+		 @param sink [IN/OUT] Token_batcher, Ngram_batcher or another sink to add to.
+		 @param stopwords [IN] Tokens to drop, or null.
+		 @param countLastToken [IN] Whether a token running up to the end of the input counts.
+			If not, it is left uncounted, as if more of it could still arrive.
+		 @return The length of the uncounted token at the end of the input; always 0 if countLastToken.
+		 */
+		template <class Read, class Sink>
+		std::size_t count_blocks(Read read, std::vector<char>& buffer, Sink& sink,
+								 const Stopword_set* stopwords, bool countLastToken = true) {
+			std::size_t carried = 0; // length of a token cut off at the end of the last block
+			bool atEnd = false;
+			while (!atEnd) {
+				if (carried == buffer.size()) {
+					// a single token as long as the whole buffer; rare, so just grow it
+					buffer.resize(buffer.size() * 2);
+				}
+				std::size_t wanted = buffer.size() - carried;
+				std::size_t got = read(&buffer[carried], wanted);
+				char* first = &buffer[0];
+				char* last = first + carried + got;
+				atEnd = got < wanted;
+				
+				char* rest = count_block(first, last, atEnd && countLastToken, sink, stopwords);
+				carried = last - rest;
+				std::memmove(first, rest, carried);
+			}
+			return carried;
+		}
+		
+		/**
+		 Reader for count_blocks() copying from in-memory text.
+		 */
+		class Text_reader {
+		public:
+			explicit Text_reader(Token_view text) : _next { text.begin() }, _end { text.end() } { }
+			
+			std::size_t operator() (char* destination, std::size_t size) {
+				std::size_t n = std::min(size, static_cast<std::size_t>(_end - _next));
+				std::memcpy(destination, _next, n);
+				_next += n;
+				return n;
+			}
+			
+		private:
+			const char* _next;
+			const char* _end;
+		};
+		
+		void ensure_buffer(std::vector<char>& buffer) {
+			if (buffer.size() < File_token_counter::read_buffer_size) {
+				buffer.resize(File_token_counter::read_buffer_size);
+			}
+		}
+	}
 
 	File_token_counter::File_token_counter (const std::string& textFileName) {
 		_tcFile.open(textFileName);
 		if (!_tcFile.is_open()) {
 			throw std::invalid_argument {"File_token_counter unable to open listed file: " + textFileName + ". Make sure it exists in relationship to the program you are running."};
 		}
-		_tcFile.setf(std::ios_base::skipws); // make the file stream skip white space
+		_buffer.resize(read_buffer_size);
 	}
 	
 	File_token_counter::File_token_counter (File_token_counter&& other) noexcept {
 		_tcFile = std::move(other._tcFile);
+		_buffer = std::move(other._buffer);
+		_stopwords = other._stopwords;
+		_shard = other._shard;
 	}
 
 	File_token_counter::~File_token_counter() {
@@ -27,29 +292,174 @@ namespace counterLib {
 		// But makes things explicit if _tcFile implementation is ever changed.
 	}
 
-	void File_token_counter::add_to_map(Token_count_map& tcm) {
+	bool File_token_counter::rewind() {
 		// always start at beginning in case of multiple calls (tests)
 		_tcFile.clear();
 		_tcFile.seekg(0, _tcFile.beg);
+		return static_cast<bool>(_tcFile); // false if e.g. moved from
+	}
+	
+	std::size_t File_token_counter::read(char* destination, std::size_t size) {
+		_tcFile.read(destination, size);
+		return static_cast<std::size_t>(_tcFile.gcount());
+	}
+
+	void File_token_counter::add_to_map(Token_count_map& tcm) {
+		if (!rewind()) {
+			return;
+		}
+		Token_batcher sink { tcm, nullptr, _shard };
+		count_blocks([this](char* destination, std::size_t size) { return read(destination, size); }, _buffer, sink, _stopwords);
+	}
+	
+	void File_token_counter::add_to_map(Token_count_map& tcm, std::vector<std::uint32_t>& positions) {
+		if (!rewind()) {
+			return;
+		}
+		Token_batcher sink { tcm, &positions, _shard };
+		count_blocks([this](char* destination, std::size_t size) { return read(destination, size); }, _buffer, sink, _stopwords);
+	}
+	
+	void File_token_counter::add_to_map(Token_count_map& tcm, Id_file_writer& positions) {
+		if (!rewind()) {
+			return;
+		}
+		Token_batcher sink { tcm, nullptr, _shard, &positions };
+		count_blocks([this](char* destination, std::size_t size) { return read(destination, size); }, _buffer, sink, _stopwords);
+	}
+	
+	void File_token_counter::read_aligned_block(std::uint64_t offset, std::size_t size, std::string& text) {
+		// from the byte before the block, to tell whether a token runs into it
+		const std::size_t before = offset > 0 ? 1 : 0;
+		text.resize(before + size);
+		_tcFile.clear();
+		_tcFile.seekg(static_cast<std::streamoff>(offset - before), _tcFile.beg);
+		text.resize(read(&text[0], text.size()));
+		std::size_t start = before;
+		if (before && text.size() > 0 && !isspace(static_cast<unsigned char>(text[0]))) {
+			while (start < text.size() && !isspace(static_cast<unsigned char>(text[start]))) {
+				++start; // part of a token of the block before
+			}
+		}
+		text.erase(0, std::min(start, text.size()));
 		
-		std::string aWord;
-		while ( _tcFile >> aWord ) {
-			std::string cleanWord = clean_word(aWord);
-			if (cleanWord != "") {
-				auto i = tcm.find(cleanWord);
-				if (i == tcm.end()) {
-					// doesn't exist, add for value of one
-					tcm.emplace(cleanWord, 1);
-				}
-				else {
-					i->second++;
-				}
+		// finish the last token
+		char c;
+		while (!text.empty() && !isspace(static_cast<unsigned char>(text.back())) && _tcFile.get(c)) {
+			text.push_back(c);
+		}
+	}
+	
+	Block_sample File_token_counter::add_sample_to_map(Token_count_map& tcm, std::vector<Count>& squares,
+													  double fraction, std::uint64_t seed) {
+		Block_sample sample;
+		if (!rewind()) {
+			return sample;
+		}
+		_tcFile.seekg(0, _tcFile.end);
+		const auto fileSize = static_cast<std::uint64_t>(_tcFile.tellg());
+		sample.block_count = (fileSize + sample_block_size - 1) / sample_block_size;
+		if (sample.block_count == 0) {
+			return sample;
+		}
+		auto wanted = static_cast<std::uint64_t>(fraction * sample.block_count + 0.5);
+		sample.sampled_count = std::max<std::uint64_t>(1, std::min(wanted, sample.block_count));
+		
+		// a partial shuffle picks the blocks; they are then read in file order
+		std::vector<std::uint64_t> blocks(sample.block_count);
+		for (std::uint64_t b = 0; b < blocks.size(); ++b) {
+			blocks[b] = b;
+		}
+		std::mt19937_64 rng { seed };
+		for (std::uint64_t k = 0; k < sample.sampled_count; ++k) {
+			std::uniform_int_distribution<std::uint64_t> pick(k, blocks.size() - 1);
+			std::swap(blocks[k], blocks[pick(rng)]);
+		}
+		blocks.resize(sample.sampled_count);
+		std::sort(blocks.begin(), blocks.end());
+		
+		Token_count_map blockTCM;
+		std::vector<Token_count_map::size_type> positions;
+		std::string text;
+		for (auto b : blocks) {
+			// blocks of equal size (give or take a byte), so that no short last block skews the estimates
+			auto begin = b * fileSize / sample.block_count;
+			auto end = (b + 1) * fileSize / sample.block_count;
+			read_aligned_block(begin, static_cast<std::size_t>(end - begin), text);
+			blockTCM.clear();
+			Token_batcher sink { blockTCM, nullptr, _shard };
+			count_blocks(Text_reader { text }, _buffer, sink, _stopwords);
+			
+			positions.resize(blockTCM.size());
+			tcm.add_batch(blockTCM.cbegin(), blockTCM.cend(), positions.data());
+			squares.resize(tcm.size());
+			for (std::size_t k = 0; k < positions.size(); ++k) {
+				Count c = blockTCM.cbegin()[k].second;
+				squares[positions[k]] += c * c;
 			}
 		}
+		return sample;
+	}
+	
+	std::uint64_t File_token_counter::add_appended_to_map(Token_count_map& tcm, std::uint64_t offset) {
+		_tcFile.clear();
+		_tcFile.seekg(static_cast<std::streamoff>(offset), _tcFile.beg);
+		if (!_tcFile) {
+			return offset; // e.g. moved from
+		}
+		std::uint64_t end = offset;
+		Token_batcher sink { tcm, nullptr, _shard };
+		std::size_t unfinished = count_blocks([this, &end](char* destination, std::size_t size) {
+			std::size_t got = read(destination, size);
+			end += got;
+			return got;
+		}, _buffer, sink, _stopwords, false);
+		return end - unfinished;
+	}
+	
+	void File_token_counter::add_to_map(Ngram_count_map& ncm) {
+		if (!rewind()) {
+			return;
+		}
+		Ngram_batcher sink { ncm, _shard };
+		count_blocks([this](char* destination, std::size_t size) { return read(destination, size); }, _buffer, sink, _stopwords);
+	}
+	
+	void File_token_counter::add_to_map(Fingerprint_count_map& fcm) {
+		if (!rewind()) {
+			return;
+		}
+		Fingerprint_sink sink { fcm, _shard };
+		count_blocks([this](char* destination, std::size_t size) { return read(destination, size); }, _buffer, sink, _stopwords);
+	}
+	
+	void File_token_counter::recover_tokens(const Fingerprint_count_map& wanted, Token_count_map& found) {
+		if (!rewind()) {
+			return;
+		}
+		Recovery_sink sink { wanted, found, _shard };
+		count_blocks([this](char* destination, std::size_t size) { return read(destination, size); }, _buffer, sink, _stopwords);
+	}
+	
+	void add_text_to_map(Token_view text, Token_count_map& tcm, std::vector<char>& buffer, const Stopword_set* stopwords,
+						 const Shard* shard) {
+		ensure_buffer(buffer);
+		Token_batcher sink { tcm, nullptr, shard };
+		count_blocks(Text_reader { text }, buffer, sink, stopwords);
+	}
+
+	void add_text_to_map(Token_view text, Ngram_count_map& ncm, std::vector<char>& buffer, const Stopword_set* stopwords,
+						 const Shard* shard) {
+		ensure_buffer(buffer);
+		Ngram_batcher sink { ncm, shard };
+		count_blocks(Text_reader { text }, buffer, sink, stopwords);
 	}
 
 	File_token_counter& File_token_counter::operator= (File_token_counter&& other) noexcept {
 		_tcFile = std::move(other._tcFile);
+		_buffer = std::move(other._buffer);
+		_stopwords = other._stopwords;
+		_shard = other._shard;
 		return *this;
 	}
 	
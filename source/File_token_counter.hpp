@@ -6,17 +6,29 @@
 #ifndef File_token_counter_hpp
 #define File_token_counter_hpp
 
+#include <cstdint>
 #include <fstream>
 #include <string>
 #include <stdexcept>
-#include <unordered_map>
-#include "String_utils.hpp"
+#include <vector>
+#include "Token_count_map.hpp"
+#include "Fingerprint_count_map.hpp"
+#include "Ngram_count_map.hpp"
+#include "Shard.hpp"
+#include "Stopword_set.hpp"
+#include "Token_ids.hpp"
 
 namespace counterLib {
 	
-	using Token_count_map = std::unordered_map<std::string, int>;
-	// Using an unordered (hash) map provides speed entry and lookup.
-
+	/**
+	 How much of a file add_sample_to_map() read: the number of blocks
+	 the file splits into, and how many of them were tokenized.
+	 */
+	struct Block_sample {
+		std::uint64_t block_count = 0;
+		std::uint64_t sampled_count = 0;
+	};
+	
 	/**
 	 *	Encapsulates the opening, processing, and closing of a file
 	 *	of UTF-8 text for tokenization and counting of their frequency.
@@ -67,10 +79,118 @@ namespace counterLib {
 			stripping leading and trailing punctuation,
 			and forcing the token to be lowercase.
 
+		 The file is read in large blocks and each token is cleaned in place
+		 and looked up as a Token_view into the read buffer,
+		 so only tokens new to the map cost an allocation.
+
 		 @param tcm [IN] A Token_count_map for accumulating token counts.
 		 */
 		void add_to_map(Token_count_map& tcm);
 		
+		/**
+		 Tokenizes the file of this object as add_to_map() above does,
+		 also keeping the token stream: the position in tcm (begin() + position)
+		 of each token counted, in file order, so the file can be written
+		 as token IDs without being tokenized again (see Token_stream).
+		 
+		 @param tcm [IN/OUT] A Token_count_map for accumulating token counts.
+			Must hold fewer than 2^32 tokens.
+		 @param positions [IN/OUT] Receives the position of each token, appended.
+		 */
+		void add_to_map(Token_count_map& tcm, std::vector<std::uint32_t>& positions);
+		
+		/**
+		 Tokenizes the file of this object as add_to_map() above does, writing
+		 the token stream to a file as it goes instead of keeping it, so a file
+		 of any length can be written as token IDs in the memory of its distinct tokens.
+		 
+		 @param tcm [IN/OUT] A Token_count_map for accumulating token counts.
+			Must hold fewer than 2^32 tokens.
+		 @param positions [IN/OUT] Is written the position of each token.
+		 */
+		void add_to_map(Token_count_map& tcm, Id_file_writer& positions);
+		
+		/**
+		 Tokenizes a random sample of the file, as add_to_map() above does:
+		 the file splits into equal blocks of at most sample_block_size bytes, and the given fraction
+		 of them (at least one) is chosen at random and tokenized, in file order.
+		 A token belongs to the block its first byte is in, so a block starts
+		 after any token running into it and runs on to the end of its last token;
+		 sampling every block counts exactly what add_to_map() does.
+		 Each block's counts are added to tcm, and their squares to squares,
+		 for estimating the variance of the counts between blocks.
+		 
+		 @param tcm [IN/OUT] A Token_count_map for accumulating the sampled counts.
+		 @param squares [IN/OUT] Per position in tcm, the sum of the squares of
+			the token's per-block counts. Grown to tcm.size().
+		 @param fraction [IN] Fraction of the blocks to sample, from 0 to 1.
+		 @param seed [IN] Seed of the block choice; the same seed picks the same blocks.
+		 @return The number of blocks of the file and the number sampled.
+		 */
+		Block_sample add_sample_to_map(Token_count_map& tcm, std::vector<Count>& squares,
+									   double fraction, std::uint64_t seed);
+		
+		/**
+		 Sets the stopwords to drop while tokenizing, before they are counted.
+		 
+		 @param stopwords [IN] The stopwords, or null for none (the default).
+			Must outlive this object's use of it.
+		 */
+		void set_stopwords(const Stopword_set* stopwords) noexcept { _stopwords = stopwords; }
+		
+		/**
+		 Sets the shard of the tokens to count: other tokens are tokenized but dropped
+		 before they reach the map (see Shard::owns()). N-grams are counted
+		 if their first token is the shard's.
+		 
+		 @param shard [IN] The shard, or null for every token (the default).
+			Must outlive this object's use of it.
+		 */
+		void set_shard(const Shard* shard) noexcept { _shard = shard; }
+		
+		/**
+		 Tokenizes only the part of the file from the given offset on,
+		 as add_to_map() above does, for a file that is being appended to (a log).
+		 A token running up to the end of the file is not counted,
+		 as the rest of it may not have been written yet;
+		 the returned offset points at it, so the next call counts it once it is whole.
+		 
+		 @param tcm [IN/OUT] A Token_count_map for accumulating token counts.
+		 @param offset [IN] Where to start, normally the result of the previous call (0 at first).
+			Must not be inside a token.
+		 @return The offset just past the last counted token (and any whitespace after it).
+		 */
+		std::uint64_t add_appended_to_map(Token_count_map& tcm, std::uint64_t offset);
+		
+		/**
+		 Tokenizes the file of this object as add_to_map() above does,
+		 but counts its n-grams (runs of ncm.n() consecutive tokens) instead.
+		 N-grams run across lines and read blocks, but not past the end of the file.
+		 
+		 @param ncm [IN/OUT] An Ngram_count_map for accumulating n-gram counts.
+		 */
+		void add_to_map(Ngram_count_map& ncm);
+		
+		/**
+		 Tokenizes the file of this object as add_to_map() above does,
+		 but counts each token under its fingerprint (see token_fingerprint()),
+		 keeping no strings: the first pass of a count by fingerprint.
+		 
+		 @param fcm [IN/OUT] A Fingerprint_count_map for accumulating counts.
+		 */
+		void add_to_map(Fingerprint_count_map& fcm);
+		
+		/**
+		 Tokenizes the file of this object as add_to_map() above does,
+		 finding the tokens whose fingerprints are in wanted: the second pass of a count by fingerprint.
+		 Each is added to found once, mapped to wanted's count for its fingerprint,
+		 so if those are all distinct (as indexes are), two tokens mapped alike share a fingerprint.
+		 
+		 @param wanted [IN] The fingerprints to look for.
+		 @param found [IN/OUT] Receives the tokens found.
+		 */
+		void recover_tokens(const Fingerprint_count_map& wanted, Token_count_map& found);
+		
 		/**
 		 Copy Assignment Operator (deleted)
 		 
@@ -93,10 +213,37 @@ namespace counterLib {
 		 
 		 @param other [IN/OUT] Reference to another File_token_counter.
 		 */
-		void swap (File_token_counter& other) noexcept { _tcFile.swap(other._tcFile); }
+		void swap (File_token_counter& other) noexcept {
+			_tcFile.swap(other._tcFile);
+			_buffer.swap(other._buffer);
+			std::swap(_stopwords, other._stopwords);
+			std::swap(_shard, other._shard);
+		}
+		
+		/**
+		 The size in bytes of the blocks the file is read in.
+		 */
+		static const std::size_t read_buffer_size;
+		
+		/**
+		 The size in bytes of the blocks add_sample_to_map() chooses from.
+		 */
+		static const std::size_t sample_block_size;
 		
 	private:
+		bool rewind(); // back to the start of the file; false if there's no file
+		std::size_t read(char* destination, std::size_t size); // one block, returns bytes read
+		
+		/**
+		 Reads the tokens starting in [offset, offset + size) into text,
+		 with the rest of the last of them.
+		 */
+		void read_aligned_block(std::uint64_t offset, std::size_t size, std::string& text);
+		
 		std::ifstream _tcFile; // stores the open file stream of this object
+		std::vector<char> _buffer; // read buffer; tokens are viewed in place
+		const Stopword_set* _stopwords = nullptr; // not owned
+		const Shard* _shard = nullptr; // not owned
 				
 	};
 	
@@ -109,5 +256,33 @@ namespace counterLib {
 	 */
 	void swap(File_token_counter & left, File_token_counter & right) noexcept;
 	
+	/**
+	 Tokenizes in-memory text exactly as File_token_counter::add_to_map() tokenizes a file,
+	 adding the unique tokens and their frequency counts to the given Token_count_map.
+	 The text itself is left alone: it is copied through the given buffer a block at a time,
+	 and tokens are cleaned in the buffer.
+	 
+	 @param text [IN] UTF-8 text to tokenize.
+	 @param tcm [IN/OUT] A Token_count_map for accumulating token counts.
+	 @param buffer [IN/OUT] Scratch buffer. Reusing one across calls avoids allocation.
+	 @param stopwords [IN] Stopwords to drop, or null for none.
+	 @param shard [IN] The shard of the tokens to count, or null for all.
+	 */
+	void add_text_to_map(Token_view text, Token_count_map& tcm, std::vector<char>& buffer,
+						 const Stopword_set* stopwords = nullptr, const Shard* shard = nullptr);
+	
+	/**
+	 Counts the n-grams of in-memory text exactly as File_token_counter::add_to_map()
+	 counts those of a file. N-grams don't run from one text into the next.
+	 
+	 @param text [IN] UTF-8 text to tokenize.
+	 @param ncm [IN/OUT] An Ngram_count_map for accumulating n-gram counts.
+	 @param buffer [IN/OUT] Scratch buffer. Reusing one across calls avoids allocation.
+	 @param stopwords [IN] Stopwords to drop, or null for none. N-grams run over dropped tokens.
+	 @param shard [IN] The shard of the n-grams to count (by their first token), or null for all.
+	 */
+	void add_text_to_map(Token_view text, Ngram_count_map& ncm, std::vector<char>& buffer,
+						 const Stopword_set* stopwords = nullptr, const Shard* shard = nullptr);
+	
 }
 #endif /* File_token_counter_hpp */
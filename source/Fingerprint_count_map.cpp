@@ -0,0 +1,151 @@
+//
+//  Fingerprint_count_map.cpp
+//  counter
+//
+
+#include "Fingerprint_count_map.hpp"
+#include <cstring>
+#include <utility>
+
+namespace counterLib {
+
+	namespace {
+		const std::size_t min_slot_count = 16;
+	}
+
+	std::uint64_t token_fingerprint(Token_view token) noexcept {
+		// MurmurHash64A (Austin Appleby, public domain)
+		const std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+		const int r = 47;
+		const std::size_t length = token.size();
+		std::uint64_t h = 0x9747b28c5f3a7e1dULL ^ (length * m);
+		const char* p = token.data();
+		for (const char* end = p + (length & ~static_cast<std::size_t>(7)); p != end; p += 8) {
+			std::uint64_t k;
+			std::memcpy(&k, p, sizeof(k));
+			k *= m;
+			k ^= k >> r;
+			k *= m;
+			h ^= k;
+			h *= m;
+		}
+		const std::size_t rest = length & 7;
+		if (rest) {
+			for (std::size_t b = 0; b < rest; ++b) {
+				h ^= static_cast<std::uint64_t>(static_cast<unsigned char>(p[b])) << (8 * b);
+			}
+			h *= m;
+		}
+		h ^= h >> r;
+		h *= m;
+		h ^= h >> r;
+		return h != 0 ? h : 1; // 0 marks an empty slot
+	}
+
+	Fingerprint_count_map::Fingerprint_count_map(Memory_resource* resource) :
+		_resource { resource } { }
+
+	Fingerprint_count_map::Fingerprint_count_map(Fingerprint_count_map&& other) noexcept :
+		_resource { other._resource } {
+		swap(other);
+	}
+
+	Fingerprint_count_map::~Fingerprint_count_map() {
+		deallocate();
+	}
+
+	Fingerprint_count_map& Fingerprint_count_map::operator= (Fingerprint_count_map&& other) noexcept {
+		Fingerprint_count_map moved { std::move(other) };
+		swap(moved);
+		return *this;
+	}
+
+	void Fingerprint_count_map::swap(Fingerprint_count_map& other) noexcept {
+		std::swap(_resource, other._resource);
+		std::swap(_slots, other._slots);
+		std::swap(_size, other._size);
+		std::swap(_slotCount, other._slotCount);
+	}
+
+	std::size_t Fingerprint_count_map::probe(std::uint64_t fingerprint) const noexcept {
+		// fingerprints are well mixed, so their low bits serve as the slot
+		const std::size_t mask = _slotCount - 1;
+		std::size_t s = static_cast<std::size_t>(fingerprint) & mask;
+		while (_slots[s].fingerprint != 0 && _slots[s].fingerprint != fingerprint) {
+			s = (s + 1) & mask; // linear probing
+		}
+		return s;
+	}
+
+	void Fingerprint_count_map::add(std::uint64_t fingerprint, Count count) {
+		if ((_size + 1) * 4 > _slotCount * 3) {
+			rehash(_slotCount < min_slot_count ? min_slot_count : _slotCount * 2);
+		}
+		Entry& entry = _slots[probe(fingerprint)];
+		if (entry.fingerprint == 0) {
+			entry.fingerprint = fingerprint;
+			++_size;
+		}
+		entry.count += count;
+	}
+
+	void Fingerprint_count_map::add_map(const Fingerprint_count_map& other) {
+		// other's entries come in slot order; going into fewer slots than other's,
+		// they would pile up in long runs, so make room for them all first
+		std::size_t slotCount = _slotCount < min_slot_count ? min_slot_count : _slotCount;
+		while ((_size + other._size) * 4 > slotCount * 3 || slotCount < other._slotCount) {
+			slotCount *= 2;
+		}
+		if (slotCount != _slotCount) {
+			rehash(slotCount);
+		}
+		other.for_each([this](const Entry& e) { add(e.fingerprint, e.count); });
+	}
+
+	const Fingerprint_count_map::Entry* Fingerprint_count_map::find(std::uint64_t fingerprint) const noexcept {
+		if (_size == 0) {
+			return nullptr;
+		}
+		const Entry& entry = _slots[probe(fingerprint)];
+		return entry.fingerprint != 0 ? &entry : nullptr;
+	}
+
+	void Fingerprint_count_map::clear() noexcept {
+		if (_slots) {
+			std::memset(_slots, 0, _slotCount * sizeof(Entry));
+		}
+		_size = 0;
+	}
+
+	void Fingerprint_count_map::rehash(std::size_t slotCount) {
+		auto slots = static_cast<Entry*>(_resource->allocate(slotCount * sizeof(Entry), alignof(Entry)));
+		std::memset(slots, 0, slotCount * sizeof(Entry));
+		Entry* old = _slots;
+		const std::size_t oldCount = _slotCount;
+		_slots = slots;
+		_slotCount = slotCount;
+		// fingerprints are unique, so just look for an empty slot
+		const std::size_t mask = _slotCount - 1;
+		for (std::size_t o = 0; o < oldCount; ++o) {
+			if (old[o].fingerprint != 0) {
+				std::size_t s = static_cast<std::size_t>(old[o].fingerprint) & mask;
+				while (_slots[s].fingerprint != 0) {
+					s = (s + 1) & mask;
+				}
+				_slots[s] = old[o];
+			}
+		}
+		if (old) {
+			_resource->deallocate(old, oldCount * sizeof(Entry), alignof(Entry));
+		}
+	}
+
+	void Fingerprint_count_map::deallocate() noexcept {
+		if (_slots) {
+			_resource->deallocate(_slots, _slotCount * sizeof(Entry), alignof(Entry));
+		}
+		_slots = nullptr;
+		_size = _slotCount = 0;
+	}
+
+}
@@ -0,0 +1,176 @@
+/**
+ *	@file Fingerprint_count_map.hpp
+ *
+ *	Hash table from token fingerprints to counts, for counting
+ *	without holding the tokens' strings (see Counter::set_fingerprinting()).
+ */
+
+#ifndef Fingerprint_count_map_hpp
+#define Fingerprint_count_map_hpp
+
+#include <cstdint>
+#include "Memory_resource.hpp"
+#include "Token_count_map.hpp"
+
+namespace counterLib {
+
+	/**
+	 Gets the 64-bit fingerprint of a token (MurmurHash64A), never 0.
+	 Two different tokens share one with a chance of about 2^-64 a pair,
+	 so a vocabulary of n tokens holds a collision with a chance of about n^2 / 2^65.
+
+	 @param token [IN] The token.
+	 @return Its fingerprint.
+	 */
+	std::uint64_t token_fingerprint(Token_view token) noexcept;
+
+	/**
+	 Hash table mapping token fingerprints to their counts.
+	 Each entry is just the fingerprint and the count, 16 bytes,
+	 held in place in an open-addressing (linear probing) table kept at most 3/4 full,
+	 so a token costs the same whatever its length, and no key is ever allocated.
+	 All memory comes from the Memory_resource given to the constructor.
+	 */
+	class Fingerprint_count_map {
+	public:
+		/**
+		 One slot of the table; a fingerprint of 0 marks it empty.
+		 */
+		struct Entry {
+			std::uint64_t fingerprint;
+			Count count;
+		};
+
+		/**
+		 Initializing Constructor
+
+		 @param resource [IN] Where the map's memory comes from. Must outlive the map.
+		 */
+		explicit Fingerprint_count_map(Memory_resource* resource = new_delete_resource());
+
+		/**
+		 Copy constructor (deleted)
+
+		 Deleted as the maps are large; move them instead.
+		 */
+		Fingerprint_count_map(const Fingerprint_count_map&) = delete;
+
+		/**
+		 Move constructor
+
+		 Takes over other's memory and resource. Leaves other empty.
+
+		 @param other [IN] rvalue of another Fingerprint_count_map.
+		 */
+		Fingerprint_count_map(Fingerprint_count_map&& other) noexcept;
+
+		/**
+		 Destructor
+
+		 Gives all memory back to the resource.
+		 */
+		~Fingerprint_count_map();
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Fingerprint_count_map& operator= (const Fingerprint_count_map&) = delete;
+
+		/**
+		 Move Assignment Operator
+
+		 @param other [IN] rvalue of another Fingerprint_count_map.
+		 @return reference to this map, now using other's resource.
+		 */
+		Fingerprint_count_map& operator= (Fingerprint_count_map&& other) noexcept;
+
+		/**
+		 Member function that efficiently swaps the contents (and resources) of two maps.
+
+		 @param other [IN/OUT] Reference to another Fingerprint_count_map.
+		 */
+		void swap(Fingerprint_count_map& other) noexcept;
+
+		std::size_t size() const noexcept { return _size; }
+		bool empty() const noexcept { return _size == 0; }
+
+		/**
+		 Gets the fraction of slots in use.
+
+		 @return size() over the slot count, 0 if there are no slots yet.
+		 */
+		double load_factor() const noexcept { return _slotCount ? static_cast<double>(_size) / _slotCount : 0; }
+
+		/**
+		 Gets the bytes the table takes.
+		 */
+		std::size_t memory_bytes() const noexcept { return _slotCount * sizeof(Entry); }
+
+		/**
+		 Adds to the count of a fingerprint, inserting it if new.
+
+		 @param fingerprint [IN] The fingerprint (see token_fingerprint()). Not 0.
+		 @param count [IN] How much to add.
+		 */
+		void add(std::uint64_t fingerprint, Count count = 1);
+
+		/**
+		 Adds the counts of another map to this one.
+
+		 @param other [IN] The map to add.
+		 */
+		void add_map(const Fingerprint_count_map& other);
+
+		/**
+		 Looks up a fingerprint.
+
+		 @param fingerprint [IN] The fingerprint.
+		 @return Its entry, or null if not present.
+		 */
+		const Entry* find(std::uint64_t fingerprint) const noexcept;
+
+		/**
+		 Calls visit(entry) for each entry, in no particular order.
+		 */
+		template <class Visit>
+		void for_each(Visit visit) const {
+			for (std::size_t s = 0; s < _slotCount; ++s) {
+				if (_slots[s].fingerprint != 0) {
+					visit(_slots[s]);
+				}
+			}
+		}
+
+		/**
+		 Removes all entries, keeping the slots.
+		 */
+		void clear() noexcept;
+
+	private:
+		std::size_t probe(std::uint64_t fingerprint) const noexcept; // its slot, or the empty one where it would go
+		void rehash(std::size_t slotCount);
+		void deallocate() noexcept;
+
+		Memory_resource* _resource;
+		Entry* _slots = nullptr;
+		std::size_t _size = 0;
+		std::size_t _slotCount = 0; // zero or a power of two
+	};
+
+	/**
+	 What the second pass of a count by fingerprint found in one input:
+	 the tokens of the wanted fingerprints (see File_token_counter::recover_tokens()),
+	 each mapped to its fingerprint's index among the wanted.
+	 */
+	struct Recovered_tokens {
+		Token_count_map tokens;
+
+		explicit Recovered_tokens(Memory_resource* resource = new_delete_resource()) : tokens { resource } { }
+
+		Token_count_map::size_type size() const noexcept { return tokens.size(); }
+		double load_factor() const noexcept { return tokens.load_factor(); }
+	};
+
+}
+
+#endif /* Fingerprint_count_map_hpp */
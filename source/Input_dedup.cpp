@@ -0,0 +1,134 @@
+//
+//  Input_dedup.cpp
+//  counter
+//
+
+#include "Input_dedup.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <sys/stat.h>
+
+namespace counterLib {
+
+	namespace {
+		const std::size_t block_size = 64 * 1024;
+
+		/**
+		 The path with symbolic links, "." and ".." resolved, or as given if it can't be.
+		 */
+		std::string canonical_path(const std::string& path) {
+			char* resolved = ::realpath(path.c_str(), nullptr);
+			if (resolved == nullptr) {
+				return path;
+			}
+			std::string canonical { resolved };
+			std::free(resolved);
+			return canonical;
+		}
+
+		/**
+		 64-bit FNV-1a hash of a file's content.
+
+		 @return false if the file can't be read.
+		 */
+		bool content_hash(const std::string& fileName, std::uint64_t& hash) {
+			std::ifstream file { fileName, std::ios::binary };
+			if (!file.is_open()) {
+				return false;
+			}
+			std::vector<char> block(block_size);
+			hash = 14695981039346656037ULL;
+			while (file) {
+				file.read(block.data(), static_cast<std::streamsize>(block.size()));
+				auto n = static_cast<std::size_t>(file.gcount());
+				for (std::size_t k = 0; k < n; ++k) {
+					hash = (hash ^ static_cast<unsigned char>(block[k])) * 1099511628211ULL;
+				}
+			}
+			return file.eof();
+		}
+
+		/**
+		 Whether two files (of the same size) hold the same bytes.
+		 */
+		bool same_content(const std::string& a, const std::string& b) {
+			std::ifstream fileA { a, std::ios::binary }, fileB { b, std::ios::binary };
+			if (!fileA.is_open() || !fileB.is_open()) {
+				return false;
+			}
+			std::vector<char> blockA(block_size), blockB(block_size);
+			while (fileA && fileB) {
+				fileA.read(blockA.data(), static_cast<std::streamsize>(blockA.size()));
+				fileB.read(blockB.data(), static_cast<std::streamsize>(blockB.size()));
+				if (fileA.gcount() != fileB.gcount()
+					|| std::memcmp(blockA.data(), blockB.data(), static_cast<std::size_t>(fileA.gcount())) != 0) {
+					return false;
+				}
+			}
+			return fileA.eof() && fileB.eof();
+		}
+	}
+
+	std::vector<Distinct_input> deduplicate_inputs(const std::vector<std::string>& filenames) {
+		// the same file, however it's spelled
+		std::vector<Distinct_input> byPath;
+		std::unordered_map<std::string, std::size_t> pathPositions;
+		for (auto& name : filenames) {
+			auto p = pathPositions.emplace(canonical_path(name), byPath.size());
+			if (p.second) {
+				byPath.push_back(Distinct_input { name, 1 });
+			}
+			else {
+				++byPath[p.first->second].copies;
+			}
+		}
+
+		// copies under other paths: only files of the same size are worth hashing
+		std::unordered_map<std::uint64_t, std::vector<std::size_t>> bySize;
+		for (std::size_t f = 0; f < byPath.size(); ++f) {
+			struct stat status;
+			if (::stat(byPath[f].filename.c_str(), &status) == 0 && S_ISREG(status.st_mode)) {
+				bySize[static_cast<std::uint64_t>(status.st_size)].push_back(f);
+			}
+		}
+		std::vector<bool> isCopy(byPath.size(), false);
+		for (auto& sized : bySize) {
+			auto& files = sized.second;
+			if (files.size() < 2) {
+				continue;
+			}
+			std::unordered_map<std::uint64_t, std::vector<std::size_t>> byHash; // hash -> the distinct contents with it
+			for (auto f : files) {
+				std::uint64_t hash;
+				if (!content_hash(byPath[f].filename, hash)) {
+					continue;
+				}
+				auto& originals = byHash[hash];
+				bool found = false;
+				for (auto o : originals) {
+					if (same_content(byPath[o].filename, byPath[f].filename)) {
+						byPath[o].copies += byPath[f].copies;
+						isCopy[f] = true;
+						found = true;
+						break;
+					}
+				}
+				if (!found) {
+					originals.push_back(f); // files are visited in list order, so this is the first name
+				}
+			}
+		}
+
+		std::vector<Distinct_input> distinct;
+		for (std::size_t f = 0; f < byPath.size(); ++f) {
+			if (!isCopy[f]) {
+				distinct.push_back(std::move(byPath[f]));
+			}
+		}
+		return distinct;
+	}
+
+}
@@ -0,0 +1,42 @@
+/**
+ *	@file Input_dedup.hpp
+ *
+ *	Finding the input files that are listed more than once,
+ *	or that are byte-identical copies of each other.
+ */
+
+#ifndef Input_dedup_hpp
+#define Input_dedup_hpp
+
+#include <string>
+#include <vector>
+#include "Token_count_map.hpp"
+
+namespace counterLib {
+
+	/**
+	 One distinct input file and how many times its content occurs in the input list.
+	 */
+	struct Distinct_input {
+		std::string filename; // the first listed name of the content
+		Count copies; // listed names (paths or copies) with this content
+	};
+
+	/**
+	 Groups the listed files by content, so each content need only be tokenized once,
+	 its counts multiplied by its number of copies.
+
+	 A file listed twice, however its path is spelled, is found by canonicalizing
+	 the paths (realpath()). Copies under different paths are found by size, then by
+	 a content hash, and are only taken to be copies once their bytes compare equal,
+	 so hash collisions can't change any count.
+	 Files that can't be opened are left as they are, to fail when they are counted.
+
+	 @param filenames [IN] Filenames (paths), in input list order.
+	 @return The distinct contents, in the order of their first name in the list.
+	 */
+	std::vector<Distinct_input> deduplicate_inputs(const std::vector<std::string>& filenames);
+
+}
+
+#endif /* Input_dedup_hpp */
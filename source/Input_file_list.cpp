@@ -6,6 +6,9 @@
 //
 
 #include "Input_file_list.hpp"
+#include <iterator>
+#include <vector>
+#include <sys/stat.h>
 
 namespace counterLib {
 
@@ -37,6 +40,22 @@ namespace counterLib {
 		return *this;
 	}
 
+	void Input_file_list::keep_shard(const Shard& shard) {
+		if (shard.whole()) {
+			return;
+		}
+		std::vector<std::uint64_t> sizes;
+		for (auto& fileName : _fileNameList) {
+			struct stat status;
+			sizes.push_back(::stat(fileName.c_str(), &status) == 0 ? static_cast<std::uint64_t>(status.st_size) : 0);
+		}
+		auto shards = assign_to_shards(sizes, shard.count());
+		std::size_t position = 0;
+		for (auto f = _fileNameList.begin(); f != _fileNameList.end(); ++position) {
+			f = shards[position] == shard.index() ? std::next(f) : _fileNameList.erase(f);
+		}
+	}
+
 	void Input_file_list::swap (Input_file_list& other) noexcept {
 		_iFile.swap(other._iFile);
 		_fileNameList.swap(other._fileNameList);
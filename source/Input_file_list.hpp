@@ -10,6 +10,7 @@
 #include <string>
 #include <stdexcept>
 #include <list>
+#include "Shard.hpp"
 
 namespace counterLib {
 	
@@ -120,6 +121,17 @@ namespace counterLib {
 			return _fileNameList.cend();
 		}
 		
+		/**
+		 Keeps only the files of one shard of the list, dropping the rest,
+		 for a count split by files between processes that each read the same list.
+		 The files are dealt out by size (see assign_to_shards()), so each shard
+		 gets about as many bytes; a file that can't be read counts as empty.
+		 The kept files stay in list order.
+
+		 @param shard [IN] The shard to keep.
+		 */
+		void keep_shard(const Shard& shard);
+		
 		/**
 		 Copy Assignment Operator (deleted)
 		 
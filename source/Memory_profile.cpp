@@ -0,0 +1,103 @@
+//
+//  Memory_profile.cpp
+//  counter
+//
+
+#include "Memory_profile.hpp"
+#include <iomanip>
+#include <ostream>
+
+namespace counterLib {
+
+	Counting_resource::Counting_resource(Memory_resource* upstream, Counting_resource* parent) noexcept :
+		_upstream { upstream },
+		_parent { parent } { }
+
+	Allocation_stats Counting_resource::stats() const noexcept {
+		Allocation_stats s;
+		s.live_bytes = _liveBytes.load(std::memory_order_relaxed);
+		s.peak_bytes = _peakBytes.load(std::memory_order_relaxed);
+		s.allocations = _allocations.load(std::memory_order_relaxed);
+		s.deallocations = _deallocations.load(std::memory_order_relaxed);
+		return s;
+	}
+
+	void Counting_resource::reset_peak() noexcept {
+		_peakBytes.store(_liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		_allocations.store(0, std::memory_order_relaxed);
+		_deallocations.store(0, std::memory_order_relaxed);
+	}
+
+	void* Counting_resource::do_allocate(std::size_t bytes, std::size_t alignment) {
+		void* p = _upstream->allocate(bytes, alignment);
+		record_allocation(bytes);
+		return p;
+	}
+
+	void Counting_resource::do_deallocate(void* p, std::size_t bytes, std::size_t alignment) {
+		_upstream->deallocate(p, bytes, alignment);
+		record_deallocation(bytes);
+	}
+
+	void Counting_resource::record_allocation(std::size_t bytes) noexcept {
+		std::size_t live = _liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		std::size_t peak = _peakBytes.load(std::memory_order_relaxed);
+		while (live > peak && !_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+		}
+		_allocations.fetch_add(1, std::memory_order_relaxed);
+		if (_parent) {
+			_parent->record_allocation(bytes);
+		}
+	}
+
+	void Counting_resource::record_deallocation(std::size_t bytes) noexcept {
+		_liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+		_deallocations.fetch_add(1, std::memory_order_relaxed);
+		if (_parent) {
+			_parent->record_deallocation(bytes);
+		}
+	}
+
+	void Memory_profile::record(std::string name, const Allocation_stats& allocation,
+								std::size_t entries, double loadFactor) {
+		Memory_record r;
+		r.name = std::move(name);
+		r.allocation = allocation;
+		r.entries = entries;
+		r.load_factor = loadFactor;
+		_records.push_back(std::move(r));
+	}
+
+	void Memory_profile::record(Stage stage, std::size_t entries, double loadFactor) {
+		record(stage_name(stage), _resources[stage].stats(), entries, loadFactor);
+	}
+
+	void Memory_profile::clear() noexcept {
+		_records.clear();
+		for (auto& r : _resources) {
+			r.reset_peak();
+		}
+	}
+
+	void Memory_profile::write(std::ostream& out) const {
+		auto flags = out.flags();
+		auto precision = out.precision();
+		out << "stage\tlive_bytes\tpeak_bytes\tallocations\tdeallocations\tentries\tload_factor\n";
+		for (auto& r : _records) {
+			out << r.name << '\t' << r.allocation.live_bytes << '\t' << r.allocation.peak_bytes
+				<< '\t' << r.allocation.allocations << '\t' << r.allocation.deallocations
+				<< '\t' << r.entries << '\t' << std::fixed << std::setprecision(3) << r.load_factor << '\n';
+		}
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+	const char* Memory_profile::stage_name(Stage stage) noexcept {
+		switch (stage) {
+			case tokenize: return "tokenize";
+			case merge: return "merge";
+			default: return "?";
+		}
+	}
+
+}
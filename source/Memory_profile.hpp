@@ -0,0 +1,169 @@
+/**
+ *	@file Memory_profile.hpp
+ *
+ *	Opt-in accounting of the memory used by each stage of a count.
+ */
+
+#ifndef Memory_profile_hpp
+#define Memory_profile_hpp
+
+#include <atomic>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "Memory_resource.hpp"
+
+namespace counterLib {
+
+	/**
+	 A snapshot of the allocations made through a Counting_resource.
+	 */
+	struct Allocation_stats {
+		std::size_t live_bytes = 0; // allocated and not yet given back
+		std::size_t peak_bytes = 0; // the most live at any one time
+		unsigned long long allocations = 0;
+		unsigned long long deallocations = 0;
+	};
+
+	/**
+	 Memory resource that forwards to an upstream resource,
+	 keeping count of the bytes and calls that pass through it.
+	 It may also report to a parent, so that the workers of a stage
+	 each have their own figures and the stage has their (concurrent) sum.
+	 Thread-safe, but only worth its atomic updates while profiling,
+	 so it is only put in place when profiling is asked for.
+	 */
+	class Counting_resource : public Memory_resource {
+	public:
+		/**
+		 Initializing Constructor
+
+		 @param upstream [IN] Where the memory really comes from. Must outlive this object.
+		 @param parent [IN] Optional resource to report the same allocations to.
+			Only its counts are used, not its upstream. Must outlive this object.
+		 */
+		explicit Counting_resource(Memory_resource* upstream = new_delete_resource(),
+								   Counting_resource* parent = nullptr) noexcept;
+
+		/**
+		 Copy constructor (deleted)
+
+		 Deleted because allocators refer to a resource by address.
+		 */
+		Counting_resource(const Counting_resource&) = delete;
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Counting_resource& operator= (const Counting_resource&) = delete;
+
+		/**
+		 Gets the counts so far.
+
+		 @return A snapshot of the counts.
+		 */
+		Allocation_stats stats() const noexcept;
+
+		/**
+		 Starts counting the peak (and the calls) again from the live bytes,
+		 for example at the start of each count.
+		 */
+		void reset_peak() noexcept;
+
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+		void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+
+	private:
+		void record_allocation(std::size_t bytes) noexcept;
+		void record_deallocation(std::size_t bytes) noexcept;
+
+		Memory_resource* _upstream;
+		Counting_resource* _parent;
+		std::atomic<std::size_t> _liveBytes { 0 };
+		std::atomic<std::size_t> _peakBytes { 0 };
+		std::atomic<unsigned long long> _allocations { 0 };
+		std::atomic<unsigned long long> _deallocations { 0 };
+	};
+
+	/**
+	 The memory figures of one stage of a count, or of one worker of a stage.
+	 */
+	struct Memory_record {
+		std::string name; // stage name, or "stage: worker"
+		Allocation_stats allocation;
+		std::size_t entries = 0; // entries of the stage's (or worker's) table
+		double load_factor = 0; // of the table's index, 0 for tables without one
+	};
+
+	/**
+	 Memory used by a Counter while counting, stage by stage:
+	 "tokenize" (the per-file or per-worker maps, with a record for each),
+	 "merge" (the overall map) and "sort" (the sorted output).
+	 See Counter::set_memory_profiling().
+
+	 The tokenize and merge figures are counted by the Counting_resources below.
+	 The sorted output lives in standard containers with the standard allocator,
+	 so its figures are computed from the containers after sorting.
+	 */
+	class Memory_profile {
+	public:
+		/**
+		 Stages with a Counting_resource of their own.
+		 */
+		enum Stage { tokenize, merge, counted_stage_count };
+
+		/**
+		 Gets the resource counting a stage's allocations.
+
+		 @param stage [IN] The stage.
+		 @return The stage's resource, forwarding to new_delete_resource().
+		 */
+		Counting_resource& resource(Stage stage) noexcept { return _resources[stage]; }
+
+		/**
+		 Adds a record of the given figures.
+
+		 @param name [IN] The stage or worker name.
+		 @param allocation [IN] Its allocations.
+		 @param entries [IN] The entries of its table.
+		 @param loadFactor [IN] The load factor of its table.
+		 */
+		void record(std::string name, const Allocation_stats& allocation,
+					std::size_t entries = 0, double loadFactor = 0);
+
+		/**
+		 Adds a record of the current figures of a counted stage.
+
+		 @param stage [IN] The stage.
+		 @param entries [IN] The entries of its table.
+		 @param loadFactor [IN] The load factor of its table.
+		 */
+		void record(Stage stage, std::size_t entries = 0, double loadFactor = 0);
+
+		/**
+		 Drops the records, and restarts the peaks, before a new count.
+		 */
+		void clear() noexcept;
+
+		const std::vector<Memory_record>& records() const noexcept { return _records; }
+
+		/**
+		 Writes the records, one per line, tab separated:
+		 name, live bytes, peak bytes, allocations, deallocations, entries and load factor.
+		 The first line names the columns.
+
+		 @param out [IN/OUT] The output stream to write to.
+		 */
+		void write(std::ostream& out) const;
+
+		static const char* stage_name(Stage stage) noexcept;
+
+	private:
+		Counting_resource _resources[counted_stage_count];
+		std::vector<Memory_record> _records;
+	};
+
+}
+
+#endif /* Memory_profile_hpp */
@@ -0,0 +1,136 @@
+//
+//  Memory_resource.cpp
+//  counter
+//
+
+#include "Memory_resource.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+namespace counterLib {
+	const std::size_t Memory_resource::max_align;
+	const std::size_t Monotonic_arena::max_chunk_size = 16 * 1024 * 1024;
+
+	namespace {
+		/**
+		 Memory_resource backed by the global operator new and delete.
+		 */
+		class New_delete_resource : public Memory_resource {
+		protected:
+			void* do_allocate(std::size_t bytes, std::size_t) override {
+				return ::operator new(bytes); // operator new already honours max_align
+			}
+			void do_deallocate(void* p, std::size_t, std::size_t) override {
+				::operator delete(p);
+			}
+		};
+	}
+
+	Memory_resource* new_delete_resource() noexcept {
+		static New_delete_resource instance; // thread-safe initialization in C++11
+		return &instance;
+	}
+
+	Monotonic_arena::Monotonic_arena(std::size_t initialChunkSize, Memory_resource* upstream) :
+		_upstream { upstream },
+		_initialChunkSize { initialChunkSize < sizeof(Chunk) * 2 ? sizeof(Chunk) * 2 : initialChunkSize },
+		_nextChunkSize { _initialChunkSize } { }
+
+	Monotonic_arena::~Monotonic_arena() {
+		release();
+	}
+
+	void Monotonic_arena::release() noexcept {
+		while (_chunks) {
+			Chunk* next = _chunks->next;
+			_upstream->deallocate(_chunks, _chunks->size);
+			_chunks = next;
+		}
+		_current = _end = nullptr;
+		_nextChunkSize = _initialChunkSize;
+		_bytesAllocated = 0;
+	}
+
+	void Monotonic_arena::reset() noexcept {
+		if (_chunks == nullptr) {
+			return;
+		}
+		Chunk* kept = _chunks; // the most recent chunk, normally the largest
+		_chunks = kept->next;
+		release();
+		kept->next = nullptr;
+		_chunks = kept;
+		_current = reinterpret_cast<char*>(kept + 1);
+		_end = reinterpret_cast<char*>(kept) + kept->size;
+		_nextChunkSize = std::min(kept->size * 2, std::max(_initialChunkSize, max_chunk_size));
+	}
+
+	void Monotonic_arena::swap(Monotonic_arena& other) noexcept {
+		std::swap(_upstream, other._upstream);
+		std::swap(_chunks, other._chunks);
+		std::swap(_current, other._current);
+		std::swap(_end, other._end);
+		std::swap(_initialChunkSize, other._initialChunkSize);
+		std::swap(_nextChunkSize, other._nextChunkSize);
+		std::swap(_bytesAllocated, other._bytesAllocated);
+	}
+
+	void* Monotonic_arena::do_allocate(std::size_t bytes, std::size_t alignment) {
+		auto aligned = [alignment](char* p) {
+			auto a = reinterpret_cast<std::uintptr_t>(p);
+			return reinterpret_cast<char*>((a + alignment - 1) & ~(std::uintptr_t(alignment) - 1));
+		};
+
+		char* p = aligned(_current);
+		if (_current == nullptr || p + bytes > _end) {
+			// get a new chunk big enough for this request, growing geometrically
+			std::size_t needed = sizeof(Chunk) + bytes + alignment;
+			std::size_t size = _nextChunkSize;
+			while (size < needed) {
+				size *= 2;
+			}
+
+			auto chunk = static_cast<Chunk*>(_upstream->allocate(size));
+			chunk->next = _chunks;
+			chunk->size = size;
+			_chunks = chunk;
+			_current = reinterpret_cast<char*>(chunk + 1);
+			_end = reinterpret_cast<char*>(chunk) + size;
+			_nextChunkSize = std::min(size * 2, std::max(_initialChunkSize, max_chunk_size));
+
+			p = aligned(_current);
+		}
+
+		_bytesAllocated += (p + bytes) - _current;
+		_current = p + bytes;
+		return p;
+	}
+
+	Arena_pool::Lease Arena_pool::acquire() {
+		std::lock_guard<std::mutex> lock { _mutex };
+		Monotonic_arena* arena;
+		if (_idle.empty()) {
+			_idle.reserve(_arenas.size() + 1); // so give_back() never needs to allocate
+			_arenas.emplace_back(new Monotonic_arena);
+			arena = _arenas.back().get();
+		}
+		else {
+			arena = _idle.back();
+			_idle.pop_back();
+		}
+		return Lease { arena, Give_back { this } };
+	}
+
+	std::size_t Arena_pool::arena_count() const {
+		std::lock_guard<std::mutex> lock { _mutex };
+		return _arenas.size();
+	}
+
+	void Arena_pool::give_back(Monotonic_arena* arena) noexcept {
+		arena->reset();
+		std::lock_guard<std::mutex> lock { _mutex };
+		_idle.push_back(arena);
+	}
+
+}
@@ -0,0 +1,313 @@
+/**
+ *	@file Memory_resource.hpp
+ *
+ *	A small, C++11 compatible take on the C++17 std::pmr facilities:
+ *	an abstract memory resource, a monotonic (bump pointer) arena
+ *	and an allocator that forwards to whichever resource it was given.
+ */
+
+#ifndef Memory_resource_hpp
+#define Memory_resource_hpp
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace counterLib {
+
+	/**
+	 Abstract source of raw memory.
+	 Mirrors std::pmr::memory_resource so that containers can be pointed at
+	 different allocation strategies at run time without changing their type.
+	 */
+	class Memory_resource {
+	public:
+		/**
+		 The strictest alignment any fundamental type needs.
+		 Used as the default alignment of allocate() and deallocate().
+		 */
+		static const std::size_t max_align = alignof(std::max_align_t);
+
+		virtual ~Memory_resource() { }
+
+		/**
+		 Allocates at least the given number of bytes.
+
+		 @param bytes [IN] The number of bytes wanted.
+		 @param alignment [IN] The alignment wanted, a power of two.
+		 @return Pointer to the new memory. Throws std::bad_alloc on failure.
+		 */
+		void* allocate(std::size_t bytes, std::size_t alignment = max_align) {
+			return do_allocate(bytes, alignment);
+		}
+
+		/**
+		 Gives back memory obtained from allocate() on this same resource.
+
+		 @param p [IN] Pointer returned by allocate().
+		 @param bytes [IN] The size passed to allocate().
+		 @param alignment [IN] The alignment passed to allocate().
+		 */
+		void deallocate(void* p, std::size_t bytes, std::size_t alignment = max_align) {
+			do_deallocate(p, bytes, alignment);
+		}
+
+		/**
+		 Two resources are equal when memory from one can be given back to the other.
+		 Only true for the very same object here.
+
+		 @param other [IN] Another Memory_resource.
+		 @return true if other is this object.
+		 */
+		bool is_equal(const Memory_resource& other) const noexcept { return this == &other; }
+
+	protected:
+		virtual void* do_allocate(std::size_t bytes, std::size_t alignment) = 0;
+		virtual void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) = 0;
+	};
+
+	/**
+	 Gets the process wide resource that forwards to global operator new and delete.
+	 Used by Arena_allocator when it is not given a resource.
+
+	 @return Pointer to a Memory_resource that lives for the whole program.
+	 */
+	Memory_resource* new_delete_resource() noexcept;
+
+	/**
+	 Memory resource that hands out memory by bumping a pointer through
+	 large chunks obtained from an upstream resource.
+	 deallocate() does nothing; everything is given back in one step
+	 by release() or the destructor.
+	 This makes allocation cheap and contention free when each thread
+	 has its own arena, and tearing down millions of small objects
+	 costs one free per chunk.
+	 Not thread-safe: an arena is meant to be used by one thread at a time.
+	 */
+	class Monotonic_arena : public Memory_resource {
+	public:
+		/**
+		 Chunks stop growing once they reach this size (16 MiB),
+		 unless a single request needs more.
+		 */
+		static const std::size_t max_chunk_size;
+
+		/**
+		 Initializing Constructor
+
+		 @param initialChunkSize [IN] Size in bytes of the first chunk.
+			Later chunks grow geometrically.
+		 @param upstream [IN] Where the chunks come from.
+		 */
+		explicit Monotonic_arena(std::size_t initialChunkSize = 64 * 1024,
+								 Memory_resource* upstream = new_delete_resource());
+
+		/**
+		 Copy constructor (deleted)
+
+		 Deleted because allocators and containers refer to an arena by address.
+		 */
+		Monotonic_arena(const Monotonic_arena&) = delete;
+
+		/**
+		 Destructor
+
+		 Gives all chunks back to the upstream resource.
+		 */
+		~Monotonic_arena();
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Monotonic_arena& operator= (const Monotonic_arena&) = delete;
+
+		/**
+		 Gives back all memory handed out so far, in one step.
+		 Any object still living in the arena is left dangling,
+		 so destroy (or forget) its users first.
+		 */
+		void release() noexcept;
+		
+		/**
+		 Like release(), but keeps the most recent (normally the largest) chunk
+		 and starts handing it out again from the beginning.
+		 A reset arena is warm: refilling it up to that size costs no upstream allocation.
+		 */
+		void reset() noexcept;
+
+		/**
+		 Gets the number of bytes handed out since construction or the last release().
+
+		 @return Bytes handed out, including alignment padding.
+		 */
+		std::size_t bytes_allocated() const noexcept { return _bytesAllocated; }
+		
+		/**
+		 Swaps the chunks (and upstream) of this arena with another's.
+		 Memory already handed out stays where it is, now owned by the other arena.
+		 Only safe when no allocator refers to either arena by address.
+		 
+		 @param other [IN/OUT] Reference to another Monotonic_arena.
+		 */
+		void swap(Monotonic_arena& other) noexcept;
+
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+		void do_deallocate(void*, std::size_t, std::size_t) override { } // monotonic
+
+	private:
+		/**
+		 Header placed at the start of every chunk.
+		 Links the chunks together so they can all be released.
+		 */
+		struct Chunk {
+			Chunk* next;
+			std::size_t size;
+		};
+
+		Memory_resource* _upstream;
+		Chunk* _chunks = nullptr; // most recent chunk first
+		char* _current = nullptr; // next free byte of the current chunk
+		char* _end = nullptr; // end of the current chunk
+		std::size_t _initialChunkSize;
+		std::size_t _nextChunkSize;
+		std::size_t _bytesAllocated = 0;
+	};
+
+	/**
+	 Standard library compatible allocator that forwards to a Memory_resource.
+	 Like std::pmr::polymorphic_allocator, the resource is part of the allocator's state,
+	 so containers of the same type can draw their memory from different places.
+	 A copy made by a container copy constructor falls back to new_delete_resource(),
+	 so copies never refer to an arena they do not own.
+	 */
+	template <class T>
+	class Arena_allocator {
+	public:
+		using value_type = T;
+
+		/**
+		 Default Constructor
+
+		 Uses new_delete_resource().
+		 */
+		Arena_allocator() noexcept : _resource { new_delete_resource() } { }
+
+		/**
+		 Initializing Constructor
+
+		 @param resource [IN] The resource to allocate from. Must outlive the allocator
+			and everything allocated with it.
+		 */
+		Arena_allocator(Memory_resource* resource) noexcept : _resource { resource } { }
+
+		/**
+		 Rebinding Constructor
+
+		 @param other [IN] An allocator of another value type. Shares its resource.
+		 */
+		template <class U>
+		Arena_allocator(const Arena_allocator<U>& other) noexcept : _resource { other.resource() } { }
+
+		T* allocate(std::size_t n) {
+			return static_cast<T*>(_resource->allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* p, std::size_t n) noexcept {
+			_resource->deallocate(p, n * sizeof(T), alignof(T));
+		}
+
+		/**
+		 Called by containers on copy construction.
+
+		 @return An allocator using new_delete_resource().
+		 */
+		Arena_allocator select_on_container_copy_construction() const { return Arena_allocator(); }
+
+		/**
+		 Gets the resource this allocator forwards to.
+
+		 @return Pointer to the Memory_resource.
+		 */
+		Memory_resource* resource() const noexcept { return _resource; }
+
+	private:
+		Memory_resource* _resource;
+	};
+
+	template <class T, class U>
+	bool operator== (const Arena_allocator<T>& a, const Arena_allocator<U>& b) noexcept {
+		return a.resource() == b.resource() || a.resource()->is_equal(*b.resource());
+	}
+
+	template <class T, class U>
+	bool operator!= (const Arena_allocator<T>& a, const Arena_allocator<U>& b) noexcept {
+		return !(a == b);
+	}
+	
+	/**
+	 Thread-safe supply of reusable Monotonic_arenas.
+	 An arena is leased with acquire() and comes back, reset() but with
+	 its memory kept, when the lease (a unique_ptr) goes away.
+	 Lets arenas stay warm from one counting job to the next.
+	 The pool must outlive all of its leases.
+	 */
+	class Arena_pool {
+	public:
+		/**
+		 Deleter of a lease: gives the arena back to its pool.
+		 */
+		struct Give_back {
+			Arena_pool* pool;
+			void operator() (Monotonic_arena* arena) const noexcept { pool->give_back(arena); }
+		};
+		
+		/**
+		 An arena on lease from the pool.
+		 */
+		using Lease = std::unique_ptr<Monotonic_arena, Give_back>;
+		
+		/**
+		 Default Constructor
+		 */
+		Arena_pool() = default;
+		
+		/**
+		 Copy constructor (deleted)
+		 
+		 Deleted because leases refer to their pool by address.
+		 */
+		Arena_pool(const Arena_pool&) = delete;
+		
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Arena_pool& operator= (const Arena_pool&) = delete;
+		
+		/**
+		 Leases an idle arena, making a new one if there is none.
+		 
+		 @return The lease. The arena is empty.
+		 */
+		Lease acquire();
+		
+		/**
+		 Gets the number of arenas the pool has made so far.
+		 
+		 @return The number of arenas, idle or leased.
+		 */
+		std::size_t arena_count() const;
+		
+	private:
+		void give_back(Monotonic_arena* arena) noexcept;
+		
+		mutable std::mutex _mutex; // guards both lists
+		std::vector<std::unique_ptr<Monotonic_arena>> _arenas; // all of them
+		std::vector<Monotonic_arena*> _idle;
+	};
+
+}
+
+#endif /* Memory_resource_hpp */
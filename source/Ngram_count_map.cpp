@@ -0,0 +1,109 @@
+//
+//  Ngram_count_map.cpp
+//  counter
+//
+
+#include "Ngram_count_map.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace counterLib {
+
+	const unsigned Ngram_count_map::max_n;
+
+	Ngram_count_map::Ngram_count_map(unsigned n, Memory_resource* resource) :
+		_n { n },
+		_vocabulary { resource },
+		_ngrams { resource } {
+		if (n == 0 || n > max_n) {
+			throw std::invalid_argument {"Ngram_count_map supports n from 1 to " + std::to_string(max_n) + ", not " + std::to_string(n)};
+		}
+	}
+
+	Ngram_count_map::Token_id Ngram_count_map::intern(Token_view token) {
+		auto entry = _vocabulary.try_emplace(token).first;
+		++entry->second;
+		return static_cast<Token_id>(entry - _vocabulary.begin());
+	}
+
+	void Ngram_count_map::add_batch(const Token_id* ids, size_type count) {
+		Token_view keys[Token_count_map::batch_size];
+		while (count > 0) {
+			size_type batched = std::min(count, Token_count_map::batch_size);
+			for (size_type k = 0; k < batched; ++k) {
+				keys[k] = key_of(ids + k * _n);
+			}
+			_ngrams.add_batch(keys, batched);
+			ids += batched * _n;
+			count -= batched;
+		}
+	}
+
+	void Ngram_count_map::add_map(const Ngram_count_map& other, size_type* positions) {
+		if (other._n != _n) {
+			throw std::invalid_argument {"Ngram_count_map can't add " + std::to_string(other._n) + "-grams to " + std::to_string(_n) + "-grams"};
+		}
+		// other's token ID -> this map's token ID
+		std::vector<Token_id> translated;
+		translated.reserve(other._vocabulary.size());
+		for (auto& tc : other._vocabulary) {
+			auto entry = _vocabulary.try_emplace(tc.first).first;
+			entry->second += tc.second;
+			translated.push_back(static_cast<Token_id>(entry - _vocabulary.begin()));
+		}
+
+		Token_id ids[max_n];
+		for (auto i = other.cbegin(); i != other.cend(); ++i) {
+			for (unsigned k = 0; k < _n; ++k) {
+				ids[k] = translated[other.id_of(i, k)];
+			}
+			auto entry = _ngrams.try_emplace(key_of(ids)).first;
+			entry->second += i->second;
+			if (positions) {
+				*positions++ = static_cast<size_type>(entry - _ngrams.begin());
+			}
+		}
+	}
+
+	Ngram_count_map::Token_id Ngram_count_map::id_of(const_iterator entry, unsigned k) const noexcept {
+		// keys are packed without alignment, so copy rather than cast
+		Token_id id;
+		std::memcpy(&id, entry->first.data() + k * sizeof(Token_id), sizeof(Token_id));
+		return id;
+	}
+
+	std::string Ngram_count_map::text_of(const_iterator entry) const {
+		std::string text;
+		for (unsigned k = 0; k < _n; ++k) {
+			Token_view t = token(id_of(entry, k));
+			if (k > 0) {
+				text += ' ';
+			}
+			text.append(t.data(), t.size());
+		}
+		return text;
+	}
+
+	void Ngram_count_map::clear() noexcept {
+		_vocabulary.clear();
+		_ngrams.clear();
+	}
+
+	void Ngram_count_map::scale(Count factor) noexcept {
+		_vocabulary.scale(factor);
+		_ngrams.scale(factor);
+	}
+
+	void Ngram_count_map::swap(Ngram_count_map& other) noexcept {
+		std::swap(_n, other._n);
+		_vocabulary.swap(other._vocabulary);
+		_ngrams.swap(other._ngrams);
+	}
+
+	void swap(Ngram_count_map& left, Ngram_count_map& right) noexcept {
+		left.swap(right);
+	}
+
+}
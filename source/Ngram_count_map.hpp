@@ -0,0 +1,192 @@
+/**
+ *	@file Ngram_count_map.hpp
+ *
+ *	Hash table from n-grams (runs of n consecutive tokens) to their frequency counts.
+ */
+
+#ifndef Ngram_count_map_hpp
+#define Ngram_count_map_hpp
+
+#include <cstdint>
+#include <string>
+#include "Token_count_map.hpp"
+
+namespace counterLib {
+
+	/**
+	 Counts n-grams without ever building their strings.
+
+	 Each distinct token is given a small integer ID the first time it is seen
+	 (its position in the vocabulary, a Token_count_map that also counts it as a single token).
+	 An n-gram is then keyed by its n token IDs packed together,
+	 4 bytes per token whatever the lengths of the tokens,
+	 and counted in a second Token_count_map. So counting an n-gram costs
+	 one vocabulary lookup for its newest token and one lookup of a short fixed-size key.
+	 The text of an n-gram ("token token ...") is only rebuilt, by text_of(),
+	 when the result is written out.
+
+	 Token IDs are local to a map. add_map() translates the other map's IDs into this one's,
+	 so maps counted separately (one per file, on different threads) can be merged.
+
+	 All memory comes from the Memory_resource given to the constructor.
+	 */
+	class Ngram_count_map {
+	public:
+		using Token_id = std::uint32_t;
+		using size_type = Token_count_map::size_type;
+		using const_iterator = Token_count_map::const_iterator;
+
+		/**
+		 The largest n supported.
+		 */
+		static const unsigned max_n = 8;
+
+		/**
+		 Initializing Constructor
+
+		 Throws std::invalid_argument if n is 0 or greater than max_n.
+
+		 @param n [IN] Number of tokens per n-gram, for example 2 for bigrams.
+		 @param resource [IN] Where the map's memory comes from. Must outlive the map.
+		 */
+		explicit Ngram_count_map(unsigned n = 2, Memory_resource* resource = new_delete_resource());
+
+		/**
+		 Gets the number of tokens per n-gram.
+
+		 @return n, as given to the constructor.
+		 */
+		unsigned n() const noexcept { return _n; }
+
+		size_type size() const noexcept { return _ngrams.size(); }
+		bool empty() const noexcept { return _ngrams.empty(); }
+
+		/**
+		 Iterators over the n-grams. Each entry's key is the packed token IDs,
+		 use text_of() or id_of() to read it, and its value is the n-gram's count.
+		 */
+		const_iterator cbegin() const noexcept { return _ngrams.cbegin(); }
+		const_iterator cend() const noexcept { return _ngrams.cend(); }
+		const_iterator begin() const noexcept { return _ngrams.cbegin(); }
+		const_iterator end() const noexcept { return _ngrams.cend(); }
+
+		/**
+		 Gets the ID of a token, adding it to the vocabulary if it is new,
+		 and adds one to its count as a single token.
+
+		 @param token [IN] The token. Copied into the map only when it is new.
+		 @return The token's ID.
+		 */
+		Token_id intern(Token_view token);
+
+		/**
+		 Gets the token with the given ID.
+
+		 @param id [IN] An ID returned by intern().
+		 @return View of the token, valid as long as the map (until clear()).
+		 */
+		Token_view token(Token_id id) const noexcept { return _vocabulary.cbegin()[id].first; }
+
+		/**
+		 Gets the vocabulary: every token seen, in ID order, with its count as a single token.
+
+		 @return The vocabulary map. Entry k has ID k.
+		 */
+		const Token_count_map& vocabulary() const noexcept { return _vocabulary; }
+
+		/**
+		 Adds one to the counts of the given n-grams, inserting new ones.
+		 Lookups are overlapped as in Token_count_map::add_batch().
+
+		 @param ids [IN] The token IDs of the n-grams, n per n-gram, one n-gram after another.
+		 @param count [IN] Number of n-grams (not IDs).
+		 */
+		void add_batch(const Token_id* ids, size_type count);
+
+		/**
+		 Adds the n-gram counts (and vocabulary counts) of another map to this one,
+		 translating its token IDs into this map's.
+
+		 Throws std::invalid_argument if the maps count different n.
+
+		 @param other [IN] The map to add. May be destroyed afterwards.
+		 @param positions [OUT] Optional, other.size() positions: where each n-gram
+			of other (in its order) is in this map, as with Token_count_map::add_batch().
+		 */
+		void add_map(const Ngram_count_map& other, size_type* positions = nullptr);
+
+		/**
+		 Gets one token ID of an n-gram.
+
+		 @param entry [IN] Iterator to an n-gram of this map.
+		 @param k [IN] Position of the token in the n-gram, from 0 to n - 1.
+		 @return The ID of the k'th token.
+		 */
+		Token_id id_of(const_iterator entry, unsigned k) const noexcept;
+
+		/**
+		 Rebuilds the text of an n-gram: its tokens separated by single spaces.
+
+		 @param entry [IN] Iterator to an n-gram of this map.
+		 @return A new string holding the n-gram.
+		 */
+		std::string text_of(const_iterator entry) const;
+
+		/**
+		 Removes all n-grams and tokens. Keeps capacity, as Token_count_map::clear() does.
+		 */
+		void clear() noexcept;
+		
+		/**
+		 Multiplies every count (of n-grams and of tokens), as Token_count_map::scale() does.
+
+		 @param factor [IN] The multiplier.
+		 */
+		void scale(Count factor) noexcept;
+
+		/**
+		 Member function that efficiently swaps the contents of two maps.
+
+		 @param other [IN/OUT] Reference to another Ngram_count_map.
+		 */
+		void swap(Ngram_count_map& other) noexcept;
+
+		/**
+		 Gets the resource the map allocates from.
+
+		 @return Pointer to the Memory_resource.
+		 */
+		Memory_resource* resource() const noexcept { return _vocabulary.resource(); }
+		
+		/**
+		 Gets the fraction of the n-gram index slots in use.
+
+		 @return The load factor of the n-gram table.
+		 */
+		double load_factor() const noexcept { return _ngrams.load_factor(); }
+
+	private:
+		/**
+		 Views n packed token IDs as a key of _ngrams.
+		 */
+		Token_view key_of(const Token_id* ids) const noexcept {
+			return Token_view { reinterpret_cast<const char*>(ids), _n * sizeof(Token_id) };
+		}
+
+		unsigned _n;
+		Token_count_map _vocabulary; // token -> count; the entry position is the token's ID
+		Token_count_map _ngrams; // packed token IDs -> count
+	};
+
+	/**
+	 Forwards swapping to the member function
+	 that implements the operation most efficiently.
+
+	 @param left [IN/OUT] First Ngram_count_map. When done this will have the right values.
+	 @param right [IN/OUT] Second Ngram_count_map. When done this will have the left values
+	 */
+	void swap(Ngram_count_map& left, Ngram_count_map& right) noexcept;
+
+}
+
+#endif /* Ngram_count_map_hpp */
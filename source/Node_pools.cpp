@@ -0,0 +1,21 @@
+//
+//  Node_pools.cpp
+//  counter
+//
+
+#include "Node_pools.hpp"
+
+namespace counterLib {
+
+	Node_pools::Node_pools(const Cpu_topology& topology, bool pinWorkers) :
+		_topology { topology } {
+		for (std::size_t node = 0; node < _topology.node_count(); ++node) {
+			const auto& cpus = _topology.cpus(node);
+			_pools.emplace_back(pinWorkers
+				? new Thread_pool { 0, cpus }
+				: new Thread_pool { static_cast<unsigned>(cpus.size()) });
+			_arenas.emplace_back(new Arena_pool {});
+		}
+	}
+
+}
@@ -0,0 +1,80 @@
+/**
+ *	@file Node_pools.hpp
+ *
+ *	A thread pool and an arena pool for each NUMA node.
+ */
+
+#ifndef Node_pools_hpp
+#define Node_pools_hpp
+
+#include <memory>
+#include <vector>
+#include "Cpu_topology.hpp"
+#include "Memory_resource.hpp"
+#include "Thread_pool.hpp"
+
+namespace counterLib {
+
+	/**
+	 Per NUMA node worker threads and arenas, for counting that keeps
+	 each worker's table in memory local to the worker
+	 (see Counter::set_node_pools()).
+
+	 Each node gets a Thread_pool with one worker per CPU of the node,
+	 each pinned to its CPU, and an Arena_pool whose arenas are only
+	 used by that node's workers. As Linux places a page on the node of
+	 the thread that first touches it, the arenas' blocks end up local.
+	 On a single-node machine (or off Linux) this is just a pinned pool,
+	 or an unpinned one.
+	 */
+	class Node_pools {
+	public:
+		/**
+		 Initializing Constructor
+
+		 Starts the worker threads of every node.
+
+		 @param topology [IN] The nodes and their CPUs.
+		 @param pinWorkers [IN] Whether to pin each worker to its CPU.
+		 */
+		explicit Node_pools(const Cpu_topology& topology = Cpu_topology::detect(), bool pinWorkers = true);
+
+		/**
+		 Copy constructor (deleted)
+		 */
+		Node_pools(const Node_pools&) = delete;
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Node_pools& operator= (const Node_pools&) = delete;
+
+		std::size_t node_count() const noexcept { return _pools.size(); }
+
+		/**
+		 Gets the worker threads of a node.
+
+		 @param node [IN] Node position, from 0 to node_count() - 1.
+		 @return The node's thread pool.
+		 */
+		Thread_pool& pool(std::size_t node) { return *_pools.at(node); }
+
+		/**
+		 Gets the arenas of a node, for the tables of its workers.
+
+		 @param node [IN] Node position, from 0 to node_count() - 1.
+		 @return The node's arena pool.
+		 */
+		Arena_pool& arenas(std::size_t node) { return *_arenas.at(node); }
+
+		const Cpu_topology& topology() const noexcept { return _topology; }
+
+	private:
+		Cpu_topology _topology;
+		std::vector<std::unique_ptr<Thread_pool>> _pools; // neither can be moved
+		std::vector<std::unique_ptr<Arena_pool>> _arenas;
+	};
+
+}
+
+#endif /* Node_pools_hpp */
@@ -6,10 +6,14 @@
 //
 
 #include "Output_sorting_file.hpp"
+#include <cerrno>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace counterLib {
 
-	bool Output_sorting_file::TC_compare::operator() (const Token_count& a, const Token_count& b) {
+	bool Output_sorting_file::TC_compare::operator() (const Token_count& a, const Token_count& b) const {
 		bool AIsGreaterThanB = false;
 		if (a.second > b.second) {
 			AIsGreaterThanB = true;
@@ -20,7 +24,8 @@ namespace counterLib {
 		return AIsGreaterThanB;
 	}
 
-	Output_sorting_file::Output_sorting_file(const std::string& outputFileName) {
+	Output_sorting_file::Output_sorting_file(const std::string& outputFileName) :
+		_fileName { outputFileName } {
 		_oFile.open(outputFileName);
 		if (!_oFile.is_open()) {
 			throw std::invalid_argument {"Output_sorting_file_unable to open output file: " + outputFileName};
@@ -30,6 +35,7 @@ namespace counterLib {
 	Output_sorting_file::Output_sorting_file (Output_sorting_file&& other) noexcept {
 		_oFile = std::move(other._oFile);
 		_tcSet = std::move(other._tcSet);
+		_fileName = std::move(other._fileName);
 	}
 
 	Output_sorting_file::~Output_sorting_file() {
@@ -38,9 +44,19 @@ namespace counterLib {
 		// But this makes things explicit if the _oFile implementation is ever changed.
 	}
 
-	void Output_sorting_file::set_sorted(Token_count_map& wcm) {
+	void Output_sorting_file::set_sorted(Token_count_map& wcm, Count minCount) {
 		for(auto i = wcm.begin(); i != wcm.end(); ++i) {
-			_tcSet.emplace(*i);
+			if (i->second >= minCount) {
+				_tcSet.emplace(std::string { i->first.data(), i->first.size() }, i->second);
+			}
+		}
+	}
+
+	void Output_sorting_file::set_sorted(const Ngram_count_map& ncm, Count minCount) {
+		for(auto i = ncm.cbegin(); i != ncm.cend(); ++i) {
+			if (i->second >= minCount) {
+				_tcSet.emplace(ncm.text_of(i), i->second);
+			}
 		}
 	}
 
@@ -55,9 +71,28 @@ namespace counterLib {
 		write_to_output(_oFile);
 	}
 	
+	void Output_sorting_file::write_to_file(const Sorted_runs& runs, bool estimated, Thread_pool* pool) {
+		_oFile.flush(); // nothing of an earlier write_to_file() may land after this one
+		int fd = ::open(_fileName.c_str(), O_WRONLY | O_CLOEXEC);
+		if (fd < 0) {
+			throw std::system_error {errno, std::generic_category(), "Output_sorting_file unable to open output file: " + _fileName};
+		}
+		try {
+			runs.write_file(fd, estimated, pool);
+		}
+		catch (...) {
+			::close(fd);
+			throw;
+		}
+		if (::close(fd) != 0) {
+			throw std::system_error {errno, std::generic_category(), "Output_sorting_file unable to write output file: " + _fileName};
+		}
+	}
+	
 	void Output_sorting_file::swap (Output_sorting_file& other) noexcept {
 		_tcSet.swap(other._tcSet);
 		_oFile.swap(other._oFile);
+		_fileName.swap(other._fileName);
 	}
 	
 	void swap(Output_sorting_file& left, Output_sorting_file& right ) noexcept {
@@ -9,6 +9,7 @@
 
 #include <set>
 #include "File_token_counter.hpp"
+#include "Sorted_runs.hpp"
 
 namespace counterLib {
 
@@ -24,7 +25,7 @@ namespace counterLib {
 		/**
 		 Holds the token and its frequency.
 		 */
-		using Token_count = std::pair<std::string, int>;
+		using Token_count = std::pair<std::string, Count>;
 		
 		/**
 		 Constant iterator to traverse internal set of sorted Token_count's.
@@ -38,6 +39,16 @@ namespace counterLib {
 		 */
 		using TC_set_iter = std::set<Token_count>::iterator;
 		
+		/**
+		 Sorting functor for the token count set.
+		 Sorts the set by the frequency of the token, largest first and
+		 also then by token itself in alphabetical order.
+		 Public so that other sorted results (see Count_result) use the same order.
+		 */
+		struct TC_compare {
+			bool operator() (const Token_count& a, const Token_count& b) const;
+		};
+		
 		/**
 		 Initializing Constructor
 		 
@@ -76,8 +87,20 @@ namespace counterLib {
 		 This does not write to the file of the object.
 		 
 		 @param tcm [IN] A map of unique token counts - unsorted.
+		 @param minCount [IN] Tokens counted fewer times are pruned before sorting.
+		 */
+		void set_sorted(Token_count_map& tcm, Count minCount = 1);
+		
+		/**
+		 Sets this object to the n-grams and counts of the given Ngram_count_map,
+		 sorted as set_sorted() above sorts tokens.
+		 This is where the text of each n-gram is rebuilt from its token IDs,
+		 its tokens separated by single spaces.
+		 
+		 @param ncm [IN] A map of unique n-gram counts - unsorted.
+		 @param minCount [IN] N-grams counted fewer times are pruned before their text is even rebuilt.
 		 */
-		void set_sorted(Token_count_map& tcm);
+		void set_sorted(const Ngram_count_map& ncm, Count minCount = 1);
 		
 		/**
 		 Gets the starting iterator of this object's current sorted data output.
@@ -122,6 +145,19 @@ namespace counterLib {
 		 */
 		void write_to_file();
 		
+		/**
+		 Writes the given sorted runs to the file of this object,
+		 instead of the data of this object, replacing whatever it held.
+		 The lines are formatted concurrently and written by vectored writes
+		 (see Sorted_runs::write_file()).
+		 Throws std::system_error if the file can't be written.
+
+		 @param runs [IN] The sorted runs to write.
+		 @param estimated [IN] Whether to mark the counts as estimates (see Sorted_runs::write()).
+		 @param pool [IN] Optional thread pool to format on. If null, std::async is used.
+		 */
+		void write_to_file(const Sorted_runs& runs, bool estimated = false, Thread_pool* pool = nullptr);
+		
 		/**
 		 Gets the number of unique tokens currently stored in the object.
 		 Will return 0 initially until after a call to set_sorted(). 
@@ -145,17 +181,9 @@ namespace counterLib {
 		void swap (Output_sorting_file& other) noexcept;
 		
 	private:
-		/**
-		 Sorting functor for the token count set.
-		 Sorts the set by the frequency of the token, largest first and
-		 also then by token itself in alphabetical order.
-		 */
-		struct TC_compare {
-			bool operator() (const Token_count& a, const Token_count& b);
-		};
-		
 		std::set<Token_count, TC_compare> _tcSet; // token count set
 		std::ofstream _oFile; // output file
+		std::string _fileName; // of _oFile, for writing it through a descriptor
 	};
 	
 	/**
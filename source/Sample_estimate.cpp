@@ -0,0 +1,87 @@
+//
+//  Sample_estimate.cpp
+//  counter
+//
+
+#include "Sample_estimate.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace counterLib {
+
+	namespace {
+		const double z_95 = 1.96; // standard deviations of a two-sided 95% interval
+	}
+
+	void Sample_estimator::add(const Token_sample& sample, const Token_count_map::size_type* positions) {
+		const double n = static_cast<double>(sample.blocks.block_count);
+		const double k = static_cast<double>(sample.blocks.sampled_count);
+		_blockCount += sample.blocks.block_count;
+		_sampledBlockCount += sample.blocks.sampled_count;
+		if (sample.counts.empty()) {
+			return;
+		}
+		const double weight = n / k;
+		const double correction = 1 - k / n; // finite population correction
+		for (Token_count_map::size_type e = 0; e < sample.counts.size(); ++e) {
+			auto p = positions[e];
+			if (p >= _estimates.size()) {
+				_estimates.resize(p + 1);
+				_variances.resize(p + 1);
+			}
+			const double c = static_cast<double>(sample.counts.cbegin()[e].second);
+			const double q = static_cast<double>(sample.squares[e]);
+			const double spread = k > 1 ? std::max(0.0, (q - c * c / k) / (k - 1)) : q;
+			_estimates[p] += weight * c;
+			_variances[p] += n * n * correction * spread / k;
+		}
+	}
+
+	void Sample_estimator::apply(Token_count_map& tcm) {
+		_estimates.resize(tcm.size());
+		_variances.resize(tcm.size());
+		_sampled.resize(tcm.size());
+		auto entry = tcm.begin();
+		for (Token_count_map::size_type p = 0; p < tcm.size(); ++p, ++entry) {
+			_sampled[p] = entry->second;
+			entry->second = std::max(entry->second, static_cast<Count>(std::llround(_estimates[p])));
+		}
+	}
+
+	std::vector<Count_estimate> Sample_estimator::top(const Token_count_map& tcm, std::size_t k) const {
+		auto entries = tcm.cbegin();
+		std::vector<Token_count_map::size_type> order(std::min<std::size_t>(tcm.size(), _sampled.size()));
+		for (Token_count_map::size_type p = 0; p < order.size(); ++p) {
+			order[p] = p;
+		}
+		k = std::min(k, order.size());
+		std::partial_sort(order.begin(), order.begin() + k, order.end(),
+						  [entries](Token_count_map::size_type a, Token_count_map::size_type b) {
+			return entries[a].second > entries[b].second
+				|| (entries[a].second == entries[b].second && entries[a].first < entries[b].first);
+		});
+		std::vector<Count_estimate> estimates;
+		estimates.reserve(k);
+		for (std::size_t r = 0; r < k; ++r) {
+			auto p = order[r];
+			const double margin = z_95 * std::sqrt(_variances[p]);
+			Count_estimate e;
+			e.token = entries[p].first.str();
+			e.estimate = entries[p].second;
+			e.sampled = _sampled[p];
+			e.low = std::max(e.sampled, static_cast<Count>(std::llround(_estimates[p] - margin)));
+			e.high = std::max(e.estimate, static_cast<Count>(std::llround(_estimates[p] + margin)));
+			estimates.push_back(std::move(e));
+		}
+		return estimates;
+	}
+
+	void Sample_estimator::clear() noexcept {
+		_estimates.clear();
+		_variances.clear();
+		_sampled.clear();
+		_blockCount = 0;
+		_sampledBlockCount = 0;
+	}
+
+}
@@ -0,0 +1,101 @@
+/**
+ *	@file Sample_estimate.hpp
+ *
+ *	Token counts of a whole corpus estimated from random blocks of its files,
+ *	with confidence intervals (see Counter::set_sampling()).
+ */
+
+#ifndef Sample_estimate_hpp
+#define Sample_estimate_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "File_token_counter.hpp"
+#include "Token_count_map.hpp"
+
+namespace counterLib {
+
+	/**
+	 The sampled counts of one file, as File_token_counter::add_sample_to_map() makes them.
+	 */
+	struct Token_sample {
+		Token_count_map counts; // summed over the sampled blocks
+		std::vector<Count> squares; // per position in counts, the sum of the squared per-block counts
+		Block_sample blocks;
+
+		explicit Token_sample(Memory_resource* resource = new_delete_resource()) : counts { resource } { }
+
+		Token_count_map::size_type size() const noexcept { return counts.size(); }
+		double load_factor() const noexcept { return counts.load_factor(); }
+	};
+
+	/**
+	 The estimated count of one token, with its 95% confidence interval.
+	 */
+	struct Count_estimate {
+		std::string token;
+		Count estimate;
+		Count low; // never below the count actually sampled
+		Count high;
+		Count sampled; // occurrences in the sampled blocks
+	};
+
+	/**
+	 Extrapolates the sampled counts of the files to the whole files.
+
+	 Each file is a stratum whose blocks were sampled at random without replacement,
+	 so a token's total in the file is estimated as its sampled count times
+	 blocks / sampled blocks. The variance of that estimate comes from how much
+	 the token's count varies between the sampled blocks (with the finite population
+	 correction, so a fully read file adds none). Estimates and variances are summed
+	 over the files, and the interval is the normal one, 1.96 standard deviations wide.
+	 With one sampled block there is no spread to measure, so the squared count
+	 stands in for the variance, erring wide.
+	 */
+	class Sample_estimator {
+	public:
+		/**
+		 Adds a file's sample, once its counts have been merged into the counting map.
+
+		 @param sample [IN] The file's sample.
+		 @param positions [IN] The position in the counting map of each of the sample's tokens.
+		 */
+		void add(const Token_sample& sample, const Token_count_map::size_type* positions);
+
+		/**
+		 Replaces each count of the counting map (the sum of the samples) by its estimate.
+		 Call once, after every file is added.
+
+		 @param tcm [IN/OUT] The counting map.
+		 */
+		void apply(Token_count_map& tcm);
+
+		/**
+		 Gets the tokens with the highest estimates, after apply().
+
+		 @param tcm [IN] The counting map, as apply() left it.
+		 @param k [IN] Most tokens to get.
+		 @return Up to k estimates, in output order.
+		 */
+		std::vector<Count_estimate> top(const Token_count_map& tcm, std::size_t k) const;
+
+		std::uint64_t block_count() const noexcept { return _blockCount; }
+		std::uint64_t sampled_block_count() const noexcept { return _sampledBlockCount; }
+
+		/**
+		 Forgets every sample.
+		 */
+		void clear() noexcept;
+
+	private:
+		std::vector<double> _estimates; // per position in the counting map
+		std::vector<double> _variances;
+		std::vector<Count> _sampled;
+		std::uint64_t _blockCount = 0;
+		std::uint64_t _sampledBlockCount = 0;
+	};
+
+}
+
+#endif /* Sample_estimate_hpp */
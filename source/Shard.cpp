@@ -0,0 +1,284 @@
+//
+//  Shard.cpp
+//  counter
+//
+
+#include "Shard.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Output_sorting_file.hpp"
+#include "Sorted_runs.hpp"
+#include "Token_count_map.hpp"
+
+extern char** environ;
+
+namespace counterLib {
+
+	namespace {
+		/**
+		 Splits an output line "token, count" at its last ", ".
+		 Tokens are trimmed of punctuation, so none ends with a comma,
+		 and an n-gram (tokens joined by spaces) can't hold ", " either.
+		 */
+		bool parse_output_line(const std::string& line, Output_sorting_file::Token_count& tc) {
+			auto comma = line.rfind(", ");
+			if (comma == std::string::npos || comma + 2 == line.size()) {
+				return false;
+			}
+			char* end = nullptr;
+			const char* digits = line.c_str() + comma + 2;
+			long long count = std::strtoll(digits, &end, 10);
+			if (end == digits || *end != '\0') {
+				return false;
+			}
+			tc.first.assign(line, 0, comma);
+			tc.second = static_cast<Count>(count);
+			return true;
+		}
+
+		/**
+		 One shard's output, read a line at a time.
+		 */
+		class Shard_reader {
+		public:
+			explicit Shard_reader(const std::string& fileName) : _fileName { fileName } {
+				_file.open(fileName);
+				if (!_file.is_open()) {
+					throw std::invalid_argument {"Shard unable to open shard output: " + fileName};
+				}
+			}
+
+			/**
+			 Reads the next line into next(); false at the end of the file.
+			 */
+			bool advance() {
+				std::string line;
+				if (!std::getline(_file, line)) {
+					return false;
+				}
+				if (!parse_output_line(line, _next)) {
+					throw std::invalid_argument {"Shard unable to read the line \"" + line + "\" of " + _fileName};
+				}
+				return true;
+			}
+
+			const Output_sorting_file::Token_count& next() const noexcept { return _next; }
+
+		private:
+			std::string _fileName;
+			std::ifstream _file;
+			Output_sorting_file::Token_count _next;
+		};
+
+		std::uint64_t merge_disjoint(const std::vector<std::string>& shardFileNames, const std::string& outputFileName,
+									 Count minCount) {
+			std::vector<Shard_reader> readers;
+			readers.reserve(shardFileNames.size());
+			for (auto& fileName : shardFileNames) {
+				readers.emplace_back(fileName);
+			}
+			std::ofstream out { outputFileName };
+			if (!out.is_open()) {
+				throw std::invalid_argument {"Shard unable to open output file: " + outputFileName};
+			}
+			// a heap of the readers by their next lines, the first in output order on top
+			auto later = [&readers](std::size_t a, std::size_t b) {
+				return Output_sorting_file::TC_compare()(readers[b].next(), readers[a].next());
+			};
+			std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)> heap { later };
+			for (std::size_t r = 0; r < readers.size(); ++r) {
+				if (readers[r].advance()) {
+					heap.push(r);
+				}
+			}
+			std::uint64_t written = 0;
+			while (!heap.empty()) {
+				std::size_t r = heap.top();
+				heap.pop();
+				const auto& tc = readers[r].next();
+				if (tc.second < minCount) {
+					continue; // the rest of this shard is rarer still
+				}
+				out << tc.first << ", " << tc.second << '\n';
+				++written;
+				if (readers[r].advance()) {
+					heap.push(r);
+				}
+			}
+			out.flush();
+			if (!out) {
+				throw std::runtime_error {"Shard unable to write output file: " + outputFileName};
+			}
+			return written;
+		}
+
+		std::uint64_t merge_overlapping(const std::vector<std::string>& shardFileNames, const std::string& outputFileName,
+										Count minCount) {
+			Token_count_map tcm;
+			for (auto& fileName : shardFileNames) {
+				Shard_reader reader { fileName };
+				while (reader.advance()) {
+					tcm[reader.next().first] += reader.next().second;
+				}
+			}
+			Sorted_runs runs;
+			runs.sort(tcm, minCount);
+			Output_sorting_file out { outputFileName };
+			out.write_to_file(runs);
+			return runs.size();
+		}
+
+		/**
+		 Waits for a process, returning its exit status (128 plus the signal, if killed).
+		 */
+		int wait_for(pid_t pid) {
+			int status = 0;
+			while (::waitpid(pid, &status, 0) < 0) {
+				if (errno != EINTR) {
+					return -1;
+				}
+			}
+			return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + (WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+		}
+
+		/**
+		 Starts program with the given arguments, its standard output and error going to logFileName.
+		 */
+		pid_t spawn(const std::string& program, const std::vector<std::string>& arguments, const std::string& logFileName) {
+			std::vector<char*> argv;
+			argv.push_back(const_cast<char*>(program.c_str()));
+			for (auto& a : arguments) {
+				argv.push_back(const_cast<char*>(a.c_str()));
+			}
+			argv.push_back(nullptr);
+
+			posix_spawn_file_actions_t actions;
+			posix_spawn_file_actions_init(&actions);
+			posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, logFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+			pid_t pid = 0;
+			int error = posix_spawnp(&pid, program.c_str(), &actions, nullptr, argv.data(), environ);
+			posix_spawn_file_actions_destroy(&actions);
+			if (error != 0) {
+				throw std::system_error {error, std::generic_category(), "Shard unable to start " + program};
+			}
+			return pid;
+		}
+	}
+
+	Shard::Shard(unsigned index, unsigned count) :
+		_index { index },
+		_count { count } {
+		if (count == 0 || index >= count) {
+			throw std::invalid_argument {"Shard needs an index below a count of at least 1."};
+		}
+	}
+
+	bool Shard::owns(Token_view token) const noexcept {
+		return _count == 1 || mix_hash(hash_token(token.data(), token.size())) % _count == _index;
+	}
+
+	Shard parse_shard(const std::string& text) {
+		char* end = nullptr;
+		unsigned long index = std::strtoul(text.c_str(), &end, 10);
+		if (end == text.c_str() || *end != '/') {
+			throw std::invalid_argument {"Shard unable to read \"" + text + "\"; write it as index/count, as in 0/4."};
+		}
+		const char* countStart = end + 1;
+		unsigned long count = std::strtoul(countStart, &end, 10);
+		if (end == countStart || *end != '\0' || count > 65536) {
+			throw std::invalid_argument {"Shard unable to read \"" + text + "\"; write it as index/count, as in 0/4."};
+		}
+		return Shard { static_cast<unsigned>(index), static_cast<unsigned>(count) };
+	}
+
+	std::vector<unsigned> assign_to_shards(const std::vector<std::uint64_t>& sizes, unsigned count) {
+		std::vector<unsigned> shards(sizes.size(), 0);
+		if (count <= 1) {
+			return shards;
+		}
+		std::vector<std::size_t> order(sizes.size());
+		for (std::size_t i = 0; i < order.size(); ++i) {
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&sizes](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; });
+		// the least loaded shard on top; of equal loads, the lowest numbered
+		using Load = std::pair<std::uint64_t, unsigned>;
+		std::priority_queue<Load, std::vector<Load>, std::greater<Load>> loads;
+		for (unsigned s = 0; s < count; ++s) {
+			loads.emplace(0, s);
+		}
+		for (auto i : order) {
+			Load least = loads.top();
+			loads.pop();
+			shards[i] = least.second;
+			loads.emplace(least.first + sizes[i], least.second);
+		}
+		return shards;
+	}
+
+	std::string shard_file_name(const std::string& outputFileName, const Shard& shard) {
+		return outputFileName + ".shard-" + std::to_string(shard.index()) + "-of-" + std::to_string(shard.count());
+	}
+
+	std::uint64_t merge_shard_outputs(const std::vector<std::string>& shardFileNames, const std::string& outputFileName,
+									  Shard_mode mode, Count minCount) {
+		return mode == Shard_mode::tokens
+			? merge_disjoint(shardFileNames, outputFileName, minCount)
+			: merge_overlapping(shardFileNames, outputFileName, minCount);
+	}
+
+	std::uint64_t launch_shards(const std::string& program, const std::vector<std::string>& options, unsigned count,
+								Shard_mode mode, const std::string& inputFileName, const std::string& outputFileName,
+								Count minCount) {
+		if (count == 0) {
+			throw std::invalid_argument {"Shard needs at least one shard to launch."};
+		}
+		std::vector<std::string> shardFileNames;
+		std::vector<pid_t> pids;
+		std::string failure;
+		for (unsigned s = 0; s < count && failure.empty(); ++s) {
+			shardFileNames.push_back(shard_file_name(outputFileName, Shard { s, count }));
+			std::vector<std::string> arguments { options };
+			if (mode == Shard_mode::tokens && minCount > 1) {
+				arguments.insert(arguments.end(), { "--min-count", std::to_string(minCount) }); // exact within a shard
+			}
+			arguments.insert(arguments.end(), { "--shard", std::to_string(s) + "/" + std::to_string(count),
+				"--shard-by", mode == Shard_mode::tokens ? "tokens" : "files", inputFileName, shardFileNames.back() });
+			try {
+				pids.push_back(spawn(program, arguments, shardFileNames.back() + ".log"));
+			}
+			catch (std::system_error& e) {
+				failure = e.what();
+			}
+		}
+		// wait for every started shard, even after a failure, so none is left running unwatched
+		for (std::size_t s = 0; s < pids.size(); ++s) {
+			int status = wait_for(pids[s]);
+			if (status != 0 && failure.empty()) {
+				failure = "Shard " + std::to_string(s) + "/" + std::to_string(count) + " failed with exit status "
+					+ std::to_string(status) + "; see " + shardFileNames[s] + ".log";
+			}
+		}
+		if (!failure.empty()) {
+			throw std::runtime_error {failure};
+		}
+		std::uint64_t written = merge_shard_outputs(shardFileNames, outputFileName, mode, minCount);
+		for (auto& fileName : shardFileNames) {
+			std::remove(fileName.c_str());
+			std::remove((fileName + ".log").c_str());
+		}
+		return written;
+	}
+
+}
@@ -0,0 +1,140 @@
+/**
+ *	@file Shard.hpp
+ *
+ *	Splitting one count across several processes, each counting a shard of it,
+ *	and collecting their outputs into one.
+ */
+
+#ifndef Shard_hpp
+#define Shard_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "String_utils.hpp"
+#include "Token_count_map.hpp"
+
+namespace counterLib {
+
+	/**
+	 How a count is split between shards.
+	 */
+	enum class Shard_mode {
+		files, // each shard counts a share of the input files, so their counts overlap and add up
+		tokens // each shard counts every file but only its share of the tokens, so their outputs are disjoint
+	};
+
+	/**
+	 One of count equal parts of a count, numbered from 0.
+	 The default shard is the whole count (0 of 1).
+	 */
+	class Shard {
+	public:
+		/**
+		 Default Constructor
+
+		 Makes the whole count, which owns every token.
+		 */
+		Shard() = default;
+
+		/**
+		 Initializing Constructor
+
+		 Throws std::invalid_argument if the count is 0 or the index isn't below it.
+
+		 @param index [IN] Which shard, from 0 to count - 1.
+		 @param count [IN] Number of shards.
+		 */
+		Shard(unsigned index, unsigned count);
+
+		unsigned index() const noexcept { return _index; }
+		unsigned count() const noexcept { return _count; }
+		bool whole() const noexcept { return _count == 1; }
+
+		/**
+		 Checks whether a (cleaned) token falls in this shard.
+		 The token's hash (hash_token(), FNV-1a) is the same on every machine and build,
+		 so the shards of processes anywhere split the tokens alike: each token is in exactly one.
+
+		 @param token [IN] The token.
+		 @return Whether the token is this shard's.
+		 */
+		bool owns(Token_view token) const noexcept;
+
+	private:
+		unsigned _index = 0;
+		unsigned _count = 1;
+	};
+
+	/**
+	 Reads a shard written "index/count", as in "2/8".
+	 Throws std::invalid_argument if it isn't one.
+
+	 @param text [IN] The text.
+	 @return The shard.
+	 */
+	Shard parse_shard(const std::string& text);
+
+	/**
+	 Deals inputs out to shards so that each gets about as many bytes:
+	 largest first, each to the shard with the fewest bytes so far
+	 (the lowest numbered of any tied, and inputs of the same size in list order).
+	 Every process given the same sizes gets the same split.
+
+	 @param sizes [IN] Size of each input, in bytes.
+	 @param count [IN] Number of shards.
+	 @return The shard of each input.
+	 */
+	std::vector<unsigned> assign_to_shards(const std::vector<std::uint64_t>& sizes, unsigned count);
+
+	/**
+	 Gets the name of the output file a shard of a run writes, as in "output.txt.shard-2-of-8".
+
+	 @param outputFileName [IN] Filename (path) of the run's output.
+	 @param shard [IN] The shard.
+	 @return The shard's output filename.
+	 */
+	std::string shard_file_name(const std::string& outputFileName, const Shard& shard);
+
+	/**
+	 Collects the outputs of the shards of a run into one output file, in output order.
+	 Outputs by tokens are disjoint and already sorted, so they are merged line by line
+	 without holding more than a line of each. Outputs by files overlap,
+	 so their counts are added up in a Token_count_map and sorted again.
+	 Throws std::invalid_argument if a file can't be opened or a line isn't "token, count".
+
+	 @param shardFileNames [IN] Filenames (paths) of the shards' outputs.
+	 @param outputFileName [IN] Filename (path) of the output to write.
+	 @param mode [IN] How the run was split.
+	 @param minCount [IN] Tokens counted fewer times in all are left out.
+	 @return The number of tokens (or n-grams) written.
+	 */
+	std::uint64_t merge_shard_outputs(const std::vector<std::string>& shardFileNames, const std::string& outputFileName,
+									  Shard_mode mode, Count minCount = 1);
+
+	/**
+	 Runs a count as count processes of the given program on this machine, and collects their outputs.
+	 Shard i runs "program options... --shard i/count --shard-by mode input output.shard-i-of-count",
+	 with its standard output and error going to the shard's output name plus ".log".
+	 Once all have exited successfully, their outputs are merged (see merge_shard_outputs())
+	 and the shards' files removed. The minimum count is applied by the shards of a run
+	 by tokens, as theirs are whole counts, but only by the merge of a run by files,
+	 so options shouldn't hold one. Throws std::runtime_error if a process
+	 can't be started or fails; the shards' files are then kept.
+
+	 @param program [IN] The counter program, as a path or a name found on the PATH.
+	 @param options [IN] Options for every shard, before the shard's own.
+	 @param count [IN] Number of shards (processes).
+	 @param mode [IN] How to split the count.
+	 @param inputFileName [IN] Filename (path) of the input file list.
+	 @param outputFileName [IN] Filename (path) of the output to write.
+	 @param minCount [IN] Smallest count written out.
+	 @return The number of tokens (or n-grams) written.
+	 */
+	std::uint64_t launch_shards(const std::string& program, const std::vector<std::string>& options, unsigned count,
+								Shard_mode mode, const std::string& inputFileName, const std::string& outputFileName,
+								Count minCount = 1);
+
+}
+
+#endif /* Shard_hpp */
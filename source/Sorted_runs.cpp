@@ -0,0 +1,316 @@
+//
+//  Sorted_runs.cpp
+//  counter
+//
+
+#include "Sorted_runs.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace counterLib {
+
+	const std::size_t Sorted_runs::min_run_size = 16 * 1024;
+	const std::size_t Sorted_runs::chunk_size = 64 * 1024;
+
+	namespace {
+		/**
+		 Output order of entries: the order of Output_sorting_file::TC_compare.
+		 */
+		struct Entry_order {
+			bool operator() (const Sorted_runs::Entry* a, const Sorted_runs::Entry* b) const noexcept {
+				return a->second > b->second || (a->second == b->second && a->first < b->first);
+			}
+		};
+
+		using Cursor = std::pair<std::vector<const Sorted_runs::Entry*>::const_iterator,
+								 std::vector<const Sorted_runs::Entry*>::const_iterator>;
+		
+		/**
+		 Merges runs (each a cursor over a range of sorted entries), handing each entry
+		 to line in output order.
+		 */
+		template <class Line>
+		void merge_runs(std::vector<Cursor>& heap, Line line) {
+			// a heap of the runs' next entries, the first in output order on top
+			auto after = [](const Cursor& a, const Cursor& b) { return Entry_order()(*b.first, *a.first); };
+			heap.erase(std::remove_if(heap.begin(), heap.end(), [](const Cursor& c) { return c.first == c.second; }), heap.end());
+			std::make_heap(heap.begin(), heap.end(), after);
+			while (!heap.empty()) {
+				std::pop_heap(heap.begin(), heap.end(), after);
+				Cursor& next = heap.back();
+				line(**next.first);
+				if (++next.first == next.second) {
+					heap.pop_back();
+				}
+				else {
+					std::push_heap(heap.begin(), heap.end(), after);
+				}
+			}
+		}
+		
+		/**
+		 Digits in a count, with its sign.
+		 */
+		std::size_t digit_count(Count count) noexcept {
+			std::size_t digits = count < 0 ? 2 : 1;
+			std::uint64_t magnitude = count < 0 ? 0 - static_cast<std::uint64_t>(count) : static_cast<std::uint64_t>(count);
+			while (magnitude >= 10) {
+				magnitude /= 10;
+				++digits;
+			}
+			return digits;
+		}
+		
+		/**
+		 Length of an entry's line, as append_line() writes it.
+		 */
+		std::size_t line_length(const Sorted_runs::Entry& entry, bool estimated) noexcept {
+			return entry.first.size() + (estimated ? 3 : 2) + digit_count(entry.second) + 1;
+		}
+		
+		/**
+		 Appends "token, count\n" (or "token, ~count\n" for an estimate) to the line buffer.
+		 */
+		void append_line(std::string& lines, const Sorted_runs::Entry& entry, bool estimated) {
+			char digits[24];
+			char* d = digits + sizeof(digits);
+			// negated as unsigned, so even the most negative count has digits
+			std::uint64_t count = entry.second < 0 ? 0 - static_cast<std::uint64_t>(entry.second) : static_cast<std::uint64_t>(entry.second);
+			do {
+				*--d = static_cast<char>('0' + count % 10);
+				count /= 10;
+			} while (count != 0);
+			if (entry.second < 0) {
+				*--d = '-';
+			}
+			lines.append(entry.first.data(), entry.first.size());
+			lines.append(estimated ? ", ~" : ", ", estimated ? 3 : 2);
+			lines.append(d, digits + sizeof(digits) - d);
+			lines.push_back('\n');
+		}
+
+		const std::size_t flush_size = 64 * 1024; // bytes of lines written at a time
+		const std::size_t write_size = 8 * 1024 * 1024; // bytes of chunks write_file() gathers into one write
+		const std::size_t max_iovecs = 1024; // buffers in one writev(), within IOV_MAX
+		
+		/**
+		 Writes the buffers, in order, with as few writev() calls as they allow, then empties them.
+		 */
+		void write_buffers(int fd, std::vector<std::string>& buffers) {
+			std::vector<iovec> iovecs;
+			iovecs.reserve(buffers.size());
+			for (auto& b : buffers) {
+				if (!b.empty()) {
+					iovecs.push_back(iovec { &b[0], b.size() });
+				}
+			}
+			for (std::size_t first = 0; first < iovecs.size(); ) {
+				ssize_t written = ::writev(fd, iovecs.data() + first, static_cast<int>(std::min(iovecs.size() - first, max_iovecs)));
+				if (written < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					throw std::system_error {errno, std::generic_category(), "Sorted_runs unable to write output file"};
+				}
+				// a short write leaves the rest of a buffer for the next call
+				auto left = static_cast<std::size_t>(written);
+				while (first < iovecs.size() && left >= iovecs[first].iov_len) {
+					left -= iovecs[first++].iov_len;
+				}
+				if (left > 0) {
+					iovecs[first].iov_base = static_cast<char*>(iovecs[first].iov_base) + left;
+					iovecs[first].iov_len -= left;
+				}
+			}
+			buffers.clear();
+		}
+	}
+
+	void Sorted_runs::sort(const Token_count_map& tcm, Count minCount, Thread_pool* pool, unsigned runCount) {
+		clear();
+		_entries.reserve(tcm.size());
+		for (auto& entry : tcm) {
+			if (entry.second >= minCount) {
+				_entries.push_back(&entry);
+			}
+		}
+		
+		if (runCount == 0) {
+			runCount = pool ? pool->thread_count() : std::thread::hardware_concurrency();
+		}
+		std::size_t most = _entries.size() / min_run_size;
+		runCount = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(runCount, most)));
+		
+		// the entries are already unique, so contiguous slices are disjoint shards
+		_runStarts.reserve(runCount + 1);
+		for (unsigned r = 0; r <= runCount; ++r) {
+			_runStarts.push_back(_entries.size() * r / runCount);
+		}
+		if (runCount == 1) {
+			std::sort(_entries.begin(), _entries.end(), Entry_order());
+			return;
+		}
+		std::vector<std::future<void>> sorted;
+		for (unsigned r = 0; r < runCount; ++r) {
+			auto first = _entries.begin() + _runStarts[r];
+			auto last = _entries.begin() + _runStarts[r + 1];
+			auto sortRun = [first, last]() { std::sort(first, last, Entry_order()); };
+			sorted.push_back(pool ? pool->async(sortRun) : std::async(std::launch::async, sortRun));
+		}
+		for (auto& s : sorted) {
+			s.wait();
+		}
+		for (auto& s : sorted) {
+			s.get();
+		}
+	}
+
+	void Sorted_runs::write(std::ostream& out, bool estimated) const {
+		std::string lines;
+		lines.reserve(flush_size + 256);
+		auto flush = [&out, &lines]() {
+			out.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+			lines.clear();
+		};
+		
+		std::vector<Cursor> heap;
+		for (std::size_t r = 0; r + 1 < _runStarts.size(); ++r) {
+			heap.emplace_back(_entries.cbegin() + _runStarts[r], _entries.cbegin() + _runStarts[r + 1]);
+		}
+		merge_runs(heap, [&lines, &flush, estimated](const Entry& entry) {
+			append_line(lines, entry, estimated);
+			if (lines.size() >= flush_size) {
+				flush();
+			}
+		});
+		flush();
+	}
+	
+	std::uint64_t Sorted_runs::write_file(int fd, bool estimated, Thread_pool* pool) const {
+		const std::size_t runCount = run_count();
+		if (_entries.empty()) {
+			if (::ftruncate(fd, 0) != 0) {
+				throw std::system_error {errno, std::generic_category(), "Sorted_runs unable to set the output file's length"};
+			}
+			return 0;
+		}
+		
+		// the output's length, measured a run per task, so the file can be preallocated
+		std::vector<std::future<std::uint64_t>> lengths;
+		for (std::size_t r = 0; r < runCount; ++r) {
+			auto measure = [this, r, estimated]() {
+				std::uint64_t length = 0;
+				for (std::size_t e = _runStarts[r]; e < _runStarts[r + 1]; ++e) {
+					length += line_length(*_entries[e], estimated);
+				}
+				return length;
+			};
+			lengths.push_back(pool ? pool->async(measure) : std::async(std::launch::async, measure));
+		}
+		std::uint64_t total = 0;
+		for (auto& l : lengths) {
+			total += l.get();
+		}
+		if (::lseek(fd, 0, SEEK_SET) < 0) {
+			throw std::system_error {errno, std::generic_category(), "Sorted_runs unable to rewind output file"};
+		}
+#if defined(__linux__)
+		if (total > 0) {
+			::posix_fallocate(fd, 0, static_cast<off_t>(total)); // only a hint: the writes work without it
+		}
+#endif
+		
+		const std::size_t chunkCount = std::max<std::size_t>(1, (_entries.size() + chunk_size - 1) / chunk_size);
+		const std::vector<std::size_t> bounds = chunk_bounds(chunkCount);
+		const std::size_t lineBytes = static_cast<std::size_t>(total / _entries.size()) + 1; // on average, to size the buffers
+		auto format = [this, &bounds, runCount, estimated, lineBytes](std::size_t c) {
+			return format_chunk(&bounds[c * runCount], &bounds[(c + 1) * runCount], estimated, lineBytes);
+		};
+		
+		// chunks are formatted a bounded distance ahead of the one being written
+		unsigned workers = pool ? pool->thread_count() : std::thread::hardware_concurrency();
+		const std::size_t ahead = 2 * std::max(1u, workers);
+		std::vector<std::future<std::string>> chunks(chunkCount);
+		std::size_t queued = 0;
+		std::vector<std::string> buffers;
+		std::size_t buffered = 0;
+		try {
+			for (std::size_t c = 0; c < chunkCount; ++c) {
+				for (; queued < chunkCount && queued <= c + ahead; ++queued) {
+					chunks[queued] = pool ? pool->async(format, queued) : std::async(std::launch::async, format, queued);
+				}
+				buffers.push_back(chunks[c].get());
+				buffered += buffers.back().size();
+				if (buffered >= write_size || buffers.size() == max_iovecs || c + 1 == chunkCount) {
+					write_buffers(fd, buffers);
+					buffered = 0;
+				}
+			}
+		}
+		catch (...) {
+			for (auto& c : chunks) {
+				if (c.valid()) {
+					c.wait(); // the tasks use bounds and this object
+				}
+			}
+			throw;
+		}
+		if (::ftruncate(fd, static_cast<off_t>(total)) != 0) {
+			throw std::system_error {errno, std::generic_category(), "Sorted_runs unable to set the output file's length"};
+		}
+		return total;
+	}
+	
+	std::vector<std::size_t> Sorted_runs::chunk_bounds(std::size_t chunkCount) const {
+		// bounds[c * runCount + r] is where chunk c starts in run r; the last chunk ends where the runs do
+		const std::size_t runCount = run_count();
+		std::vector<std::size_t> bounds((chunkCount + 1) * runCount);
+		std::size_t longest = 0;
+		for (std::size_t r = 0; r < runCount; ++r) {
+			bounds[r] = _runStarts[r];
+			bounds[chunkCount * runCount + r] = _runStarts[r + 1];
+			if (_runStarts[r + 1] - _runStarts[r] > _runStarts[longest + 1] - _runStarts[longest]) {
+				longest = r;
+			}
+		}
+		// the runs are slices of a hash table, so they spread alike:
+		// evenly spaced splitters from the longest cut every run into chunks of about the same size
+		const std::size_t longestSize = runCount ? _runStarts[longest + 1] - _runStarts[longest] : 0;
+		for (std::size_t c = 1; c < chunkCount; ++c) {
+			const Entry* splitter = _entries[_runStarts[longest] + longestSize * c / chunkCount];
+			for (std::size_t r = 0; r < runCount; ++r) {
+				auto first = _entries.cbegin() + _runStarts[r];
+				auto last = _entries.cbegin() + _runStarts[r + 1];
+				bounds[c * runCount + r] = static_cast<std::size_t>(std::lower_bound(first, last, splitter, Entry_order()) - _entries.cbegin());
+			}
+		}
+		return bounds;
+	}
+	
+	std::string Sorted_runs::format_chunk(const std::size_t* first, const std::size_t* last, bool estimated,
+										  std::size_t lineBytes) const {
+		std::vector<Cursor> heap;
+		std::size_t entries = 0;
+		for (std::size_t r = 0; r < run_count(); ++r) {
+			heap.emplace_back(_entries.cbegin() + first[r], _entries.cbegin() + last[r]);
+			entries += last[r] - first[r];
+		}
+		std::string lines;
+		lines.reserve(entries * lineBytes);
+		merge_runs(heap, [&lines, estimated](const Entry& entry) { append_line(lines, entry, estimated); });
+		return lines;
+	}
+
+	void Sorted_runs::clear() noexcept {
+		_entries.clear();
+		_runStarts.clear();
+	}
+
+}
@@ -0,0 +1,119 @@
+/**
+ *	@file Sorted_runs.hpp
+ *
+ *	Sorted output written straight from a Token_count_map,
+ *	by sorting slices of it concurrently and merging them as they are written.
+ */
+
+#ifndef Sorted_runs_hpp
+#define Sorted_runs_hpp
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Thread_pool.hpp"
+#include "Token_count_map.hpp"
+
+namespace counterLib {
+
+	/**
+	 The entries of a Token_count_map in output order (most frequent first,
+	 then alphabetical, as Output_sorting_file::TC_compare), kept as sorted runs.
+
+	 sort() splits the map's entries into disjoint slices, one per worker,
+	 and sorts each slice on its own task. write() then merges the runs
+	 k ways as it writes, so output starts as soon as the runs are sorted,
+	 rather than once the whole vocabulary is in one sorted container.
+	 Only pointers to the entries are kept: the tokens aren't copied,
+	 so the map must outlive this object's use and not change meanwhile.
+	 */
+	class Sorted_runs {
+	public:
+		using Entry = Token_count_map::value_type;
+		
+		/**
+		 Maps with fewer entries than this are sorted as one run.
+		 */
+		static const std::size_t min_run_size;
+		
+		/**
+		 Sorts the entries of a map into runs, replacing any earlier ones.
+
+		 @param tcm [IN] The map. Must outlive the use of the runs, unchanged.
+		 @param minCount [IN] Entries counted fewer times are left out.
+		 @param pool [IN] Optional thread pool to sort the runs on.
+			If null, std::async is used.
+		 @param runCount [IN] Number of runs. 0 means one per pool thread
+			(or hardware thread), fewer for small maps.
+		 */
+		void sort(const Token_count_map& tcm, Count minCount = 1, Thread_pool* pool = nullptr, unsigned runCount = 0);
+		
+		/**
+		 Merges the runs into the given stream, one "token, count" line per entry.
+		 Can be called any number of times.
+
+		 @param out [IN/OUT] The output stream to write to.
+		 @param estimated [IN] Whether the counts are estimates, written "token, ~count".
+		 */
+		void write(std::ostream& out, bool estimated = false) const;
+		
+		/**
+		 Writes the runs to a file, in the same format as write() above,
+		 formatting the lines on several threads.
+		 The output order is cut into chunks of about chunk_size entries
+		 (by binary searching every run for splitters taken from the longest),
+		 each chunk is merged and formatted into its own buffer by a task,
+		 and the buffers are written in order, several at a time, by vectored writes.
+		 The file is preallocated to the length of the output (where possible)
+		 and cut to it, so anything it held before is overwritten.
+		 Only a bounded number of chunks is formatted ahead of the writing.
+		 Throws std::system_error if writing fails.
+
+		 @param fd [IN] Descriptor of the file, open for writing. Written from its start.
+		 @param estimated [IN] Whether the counts are estimates, written "token, ~count".
+		 @param pool [IN] Optional thread pool to format the chunks on.
+			If null, std::async is used.
+		 @return The number of bytes written.
+		 */
+		std::uint64_t write_file(int fd, bool estimated = false, Thread_pool* pool = nullptr) const;
+		
+		/**
+		 Entries formatted by each task of write_file().
+		 */
+		static const std::size_t chunk_size;
+		
+		/**
+		 Gets the number of entries sorted.
+
+		 @return The number of entries over all runs.
+		 */
+		std::size_t size() const noexcept { return _entries.size(); }
+		
+		std::size_t run_count() const noexcept { return _runStarts.empty() ? 0 : _runStarts.size() - 1; }
+		
+		/**
+		 Gets the bytes held for the runs: all the output order costs besides the map.
+
+		 @return The capacity of the run storage, in bytes.
+		 */
+		std::size_t memory_bytes() const noexcept {
+			return _entries.capacity() * sizeof(const Entry*) + _runStarts.capacity() * sizeof(std::size_t);
+		}
+		
+		/**
+		 Forgets the runs (keeping their memory).
+		 */
+		void clear() noexcept;
+		
+	private:
+		std::vector<std::size_t> chunk_bounds(std::size_t chunkCount) const; // see write_file()
+		std::string format_chunk(const std::size_t* first, const std::size_t* last, bool estimated, std::size_t lineBytes) const;
+		
+		std::vector<const Entry*> _entries; // the runs back to back
+		std::vector<std::size_t> _runStarts; // run r is [_runStarts[r], _runStarts[r + 1])
+	};
+
+}
+
+#endif /* Sorted_runs_hpp */
@@ -0,0 +1,120 @@
+//
+//  Stopword_set.cpp
+//  counter
+//
+
+#include "Stopword_set.hpp"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace counterLib {
+
+	const std::uint32_t Stopword_set::empty_slot;
+
+	namespace {
+		inline std::uint64_t word_hash(Token_view word) noexcept {
+			return mix_hash(hash_token(word.data(), word.size()));
+		}
+
+		const std::uint32_t max_displacement = 1 << 16;
+	}
+
+	Stopword_set::Stopword_set(const std::vector<std::string>& words) {
+		for (auto& w : words) {
+			std::string cleaned = clean_word(w);
+			if (!cleaned.empty()) {
+				_words.push_back(std::move(cleaned));
+			}
+		}
+		std::sort(_words.begin(), _words.end());
+		_words.erase(std::unique(_words.begin(), _words.end()), _words.end());
+		build();
+	}
+
+	void Stopword_set::build() {
+		if (_words.empty()) {
+			return;
+		}
+		std::size_t slotCount = 8;
+		while (slotCount < 2 * _words.size()) {
+			slotCount *= 2;
+		}
+		while (!try_build(slotCount)) {
+			slotCount *= 2; // practically never needed
+		}
+	}
+
+	std::size_t Stopword_set::slot_of(std::uint64_t hash) const noexcept {
+		// the bucket comes from the low bits, the position within the table from the high ones
+		std::uint32_t d = _displacements[hash % _displacements.size()];
+		std::uint64_t step = mix_hash(hash) | 1; // odd, so every slot is reachable
+		return static_cast<std::size_t>(((hash >> 32) + d * step) & (_slots.size() - 1));
+	}
+
+	bool Stopword_set::try_build(std::size_t slotCount) {
+		_displacements.assign(_words.size() / 2 + 1, 0);
+		_slots.assign(slotCount, empty_slot);
+
+		// group the words by bucket, and place the biggest buckets first, while there's room
+		std::vector<std::vector<std::uint32_t>> buckets(_displacements.size());
+		for (std::uint32_t w = 0; w < _words.size(); ++w) {
+			buckets[word_hash(_words[w]) % buckets.size()].push_back(w);
+		}
+		std::vector<std::size_t> order(buckets.size());
+		for (std::size_t b = 0; b < order.size(); ++b) {
+			order[b] = b;
+		}
+		std::stable_sort(order.begin(), order.end(), [&buckets](std::size_t a, std::size_t b) {
+			return buckets[a].size() > buckets[b].size();
+		});
+
+		std::vector<std::size_t> positions;
+		for (auto b : order) {
+			auto& bucket = buckets[b];
+			bool placed = bucket.empty();
+			for (std::uint32_t d = 0; !placed && d < max_displacement; ++d) {
+				_displacements[b] = d;
+				positions.clear();
+				placed = true;
+				for (auto w : bucket) {
+					std::size_t p = slot_of(word_hash(_words[w]));
+					if (_slots[p] != empty_slot || std::find(positions.begin(), positions.end(), p) != positions.end()) {
+						placed = false;
+						break;
+					}
+					positions.push_back(p);
+				}
+			}
+			if (!placed) {
+				return false;
+			}
+			for (std::size_t k = 0; k < bucket.size(); ++k) {
+				_slots[positions[k]] = bucket[k];
+			}
+		}
+		return true;
+	}
+
+	bool Stopword_set::contains(Token_view token) const noexcept {
+		if (_words.empty()) {
+			return false;
+		}
+		std::uint32_t w = _slots[slot_of(word_hash(token))];
+		return w != empty_slot && Token_view { _words[w] } == token;
+	}
+
+	Stopword_set load_stopwords(const std::string& stopwordFileName) {
+		std::ifstream file { stopwordFileName };
+		if (!file.is_open()) {
+			throw std::invalid_argument {"Stopword_set unable to open the stopword file: " + stopwordFileName};
+		}
+		std::vector<std::string> words;
+		std::string word;
+		while (file >> word) {
+			words.push_back(word);
+		}
+		return Stopword_set { words };
+	}
+
+}
@@ -0,0 +1,89 @@
+/**
+ *	@file Stopword_set.hpp
+ *
+ *	Fixed set of tokens to leave out of the counts, with constant-time lookup.
+ */
+
+#ifndef Stopword_set_hpp
+#define Stopword_set_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "String_utils.hpp"
+
+namespace counterLib {
+
+	/**
+	 A set of stopwords (such as "the", "a", "of") to drop while tokenizing.
+
+	 The set never changes after construction, so it is built as a perfect hash
+	 (hash and displace): each word hashes to a bucket, and each bucket has a
+	 displacement chosen so that all words land in different slots.
+	 A lookup is then one hash, one slot and at most one comparison,
+	 with no probing, which keeps it cheap enough for the tokenizer's hot loop.
+
+	 Words are cleaned as tokens are (punctuation trimmed, lowercased),
+	 so "The" in a stopword list drops "the".
+	 */
+	class Stopword_set {
+	public:
+		/**
+		 Default Constructor
+
+		 Makes an empty set, which drops nothing.
+		 */
+		Stopword_set() = default;
+
+		/**
+		 Initializing Constructor
+
+		 @param words [IN] The stopwords. Duplicates are fine.
+		 */
+		explicit Stopword_set(const std::vector<std::string>& words);
+
+		/**
+		 Checks whether a (cleaned) token is a stopword.
+
+		 @param token [IN] The token.
+		 @return Whether the token is in the set.
+		 */
+		bool contains(Token_view token) const noexcept;
+
+		std::size_t size() const noexcept { return _words.size(); }
+		bool empty() const noexcept { return _words.empty(); }
+
+	private:
+		/**
+		 Places every word, trying larger tables until it works.
+		 */
+		void build();
+
+		/**
+		 Tries to place every word in a table of the given number of slots.
+
+		 @return false if some bucket couldn't be placed.
+		 */
+		bool try_build(std::size_t slotCount);
+
+		std::size_t slot_of(std::uint64_t hash) const noexcept;
+
+		static const std::uint32_t empty_slot = 0xFFFFFFFF;
+
+		std::vector<std::string> _words;
+		std::vector<std::uint32_t> _displacements; // one per bucket
+		std::vector<std::uint32_t> _slots; // index into _words, or empty_slot
+	};
+
+	/**
+	 Reads a stopword list: words separated by whitespace (for example one per line).
+	 Throws std::invalid_argument if the file can't be opened.
+
+	 @param stopwordFileName [IN] Filename (path) of the stopword list.
+	 @return The set of the listed words.
+	 */
+	Stopword_set load_stopwords(const std::string& stopwordFileName);
+
+}
+
+#endif /* Stopword_set_hpp */
@@ -48,4 +48,26 @@ namespace counterLib {
 		return w;
 	}
 
+	Token_view clean_token (char* first, char* last) noexcept {
+		while (first != last && ispunct(static_cast<unsigned char>(*first))) {
+			++first;
+		}
+		while (last != first && ispunct(static_cast<unsigned char>(*(last - 1)))) {
+			--last;
+		}
+		for (char* c = first; c != last; ++c) {
+			*c = static_cast<char>(tolower(static_cast<unsigned char>(*c)));
+		}
+		return Token_view { first, static_cast<std::size_t>(last - first) };
+	}
+
+	std::size_t hash_token (const char* chars, std::size_t length) noexcept {
+		unsigned long long h = 14695981039346656037ULL; // FNV offset basis
+		for (std::size_t k = 0; k < length; ++k) {
+			h ^= static_cast<unsigned char>(chars[k]);
+			h *= 1099511628211ULL; // FNV prime
+		}
+		return static_cast<std::size_t>(h);
+	}
+
 }
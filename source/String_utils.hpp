@@ -7,10 +7,90 @@
 #ifndef String_utils_hpp
 #define String_utils_hpp
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
 #include <string>
 
 namespace counterLib {
 	
+	/**
+	 Non-owning, read-only view of a run of characters (a token).
+	 A C++11 stand-in for std::string_view. Copying it never allocates.
+	 The characters must outlive the view.
+	 */
+	class Token_view {
+	public:
+		/**
+		 Default Constructor
+		 
+		 Makes an empty view.
+		 */
+		Token_view() noexcept : _data { nullptr }, _size { 0 } { }
+		
+		/**
+		 Initializing Constructor
+		 
+		 @param data [IN] Pointer to the first character.
+		 @param size [IN] Number of characters.
+		 */
+		Token_view(const char* data, std::size_t size) noexcept : _data { data }, _size { size } { }
+		
+		/**
+		 Views the characters of a std::string.
+		 
+		 @param s [IN] The string to view. Must outlive the view.
+		 */
+		Token_view(const std::string& s) noexcept : _data { s.data() }, _size { s.size() } { }
+		
+		/**
+		 Views a null terminated string.
+		 
+		 @param cstr [IN] The string to view. Must outlive the view.
+		 */
+		Token_view(const char* cstr) noexcept : _data { cstr }, _size { std::strlen(cstr) } { }
+		
+		const char* data() const noexcept { return _data; }
+		std::size_t size() const noexcept { return _size; }
+		bool empty() const noexcept { return _size == 0; }
+		const char* begin() const noexcept { return _data; }
+		const char* end() const noexcept { return _data + _size; }
+		char operator[] (std::size_t k) const noexcept { return _data[k]; }
+		
+		/**
+		 Makes an owning copy of the viewed characters.
+		 
+		 @return A new std::string.
+		 */
+		std::string str() const { return std::string(_data, _size); }
+		
+	private:
+		const char* _data;
+		std::size_t _size;
+	};
+	
+	inline bool operator== (Token_view a, Token_view b) noexcept {
+		return a.size() == b.size() && (a.size() == 0 || std::memcmp(a.data(), b.data(), a.size()) == 0);
+	}
+	
+	inline bool operator!= (Token_view a, Token_view b) noexcept {
+		return !(a == b);
+	}
+	
+	/**
+	 Orders views as std::string orders their characters.
+	 */
+	inline bool operator< (Token_view a, Token_view b) noexcept {
+		std::size_t common = a.size() < b.size() ? a.size() : b.size();
+		int c = common == 0 ? 0 : std::char_traits<char>::compare(a.data(), b.data(), common);
+		return c < 0 || (c == 0 && a.size() < b.size());
+	}
+	
+	inline std::ostream& operator<< (std::ostream& out, Token_view t) {
+		return out.write(t.data(), t.size());
+	}
+	
 	/**
 	 Trims punctuation from both ends of the given word string.
 	 
@@ -36,6 +116,45 @@ namespace counterLib {
 	 Note that the string is moved, not copied, in C++11.
 	 */
 	std::string clean_word (const std::string& aWord);
+	
+	/**
+	 In-place, allocation-free version of clean_word().
+	 Trims punctuation from both ends of the characters [first, last)
+	 and lowercases what remains, in the given buffer.
+	 
+	 @param first [IN/OUT] Pointer to the first character of a word (no whitespace).
+	 @param last [IN/OUT] Pointer to just past the last character of the word.
+	 @return A view of the cleaned token inside [first, last). Empty if nothing was left.
+	 */
+	Token_view clean_token (char* first, char* last) noexcept;
+	
+	/**
+	 Hashes the characters of a token (64-bit FNV-1a).
+	 Used by the token count map so that all token string types hash alike.
+	 
+	 @param chars [IN] Pointer to the first character of the token.
+	 @param length [IN] Number of characters in the token.
+	 @return The hash value.
+	 */
+	std::size_t hash_token (const char* chars, std::size_t length) noexcept;
+	
+	/**
+	 Spreads the bits of a hash_token() value (MurmurHash3's 64-bit finalizer),
+	 as FNV-1a's low bits alone split similar tokens unevenly.
+	 Its low and high halves can serve as independent hashes.
+	 Shards and stopword sets both hash tokens this way.
+	 
+	 @param h [IN] A hash_token() value.
+	 @return The mixed value.
+	 */
+	inline std::uint64_t mix_hash (std::uint64_t h) noexcept {
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
 
 }
 
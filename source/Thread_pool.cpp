@@ -0,0 +1,74 @@
+//
+//  Thread_pool.cpp
+//  counter
+//
+
+#include "Thread_pool.hpp"
+#include "Cpu_topology.hpp"
+
+namespace counterLib {
+
+	Thread_pool::Thread_pool(unsigned threadCount) {
+		if (threadCount == 0) {
+			threadCount = std::thread::hardware_concurrency();
+		}
+		start(threadCount, std::vector<unsigned> {});
+	}
+
+	Thread_pool::Thread_pool(unsigned threadCount, const std::vector<unsigned>& cpus) {
+		if (threadCount == 0) {
+			threadCount = static_cast<unsigned>(cpus.size());
+		}
+		start(threadCount, cpus);
+	}
+
+	void Thread_pool::start(unsigned threadCount, const std::vector<unsigned>& cpus) {
+		if (threadCount == 0) {
+			threadCount = 1; // hardware_concurrency() may not know
+		}
+		_cpus = cpus;
+		_threads.reserve(threadCount);
+		for (unsigned t = 0; t < threadCount; ++t) {
+			_threads.emplace_back(&Thread_pool::work, this, t);
+		}
+	}
+
+	Thread_pool::~Thread_pool() {
+		{
+			std::lock_guard<std::mutex> lock { _mutex };
+			_stopping = true;
+		}
+		_taskReady.notify_all();
+		for (auto& t : _threads) {
+			t.join();
+		}
+	}
+
+	void Thread_pool::enqueue(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock { _mutex };
+			_tasks.push_back(std::move(task));
+		}
+		_taskReady.notify_one();
+	}
+
+	void Thread_pool::work(unsigned worker) {
+		if (!_cpus.empty()) {
+			pin_current_thread(_cpus[worker % _cpus.size()]); // unpinned, where that's unsupported
+		}
+		for (;;) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock { _mutex };
+				_taskReady.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+				if (_tasks.empty()) {
+					return; // stopping, and nothing left to do
+				}
+				task = std::move(_tasks.front());
+				_tasks.pop_front();
+			}
+			task(); // exceptions end up in the task's future
+		}
+	}
+
+}
@@ -0,0 +1,116 @@
+/**
+ *	@file Thread_pool.hpp
+ *
+ *	A fixed set of worker threads that run submitted tasks.
+ */
+
+#ifndef Thread_pool_hpp
+#define Thread_pool_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace counterLib {
+
+	/**
+	 Runs tasks on a fixed set of long-lived worker threads.
+	 A drop-in for std::async when the same threads should be reused
+	 from job to job (std::async may start a new thread for every call).
+	 Tasks are run in the order they are submitted.
+	 Following RAII, the threads are started by the constructor and
+	 joined by the destructor, after every queued task has run.
+	 Because threads can't be copied, neither can this class.
+	 */
+	class Thread_pool {
+	public:
+		/**
+		 Initializing Constructor
+
+		 Starts the worker threads.
+
+		 @param threadCount [IN] Number of worker threads.
+			0 means one per hardware thread.
+		 */
+		explicit Thread_pool(unsigned threadCount = 0);
+
+		/**
+		 Pinning Constructor
+
+		 Starts the worker threads, each pinned to one of the given CPUs
+		 (see pin_current_thread()), so that the memory a worker's tasks
+		 first touch stays on the worker's NUMA node.
+
+		 @param threadCount [IN] Number of worker threads.
+			0 means one per given CPU.
+		 @param cpus [IN] CPUs to pin to, worker k to cpus[k % cpus.size()].
+			If empty, the workers aren't pinned.
+		 */
+		Thread_pool(unsigned threadCount, const std::vector<unsigned>& cpus);
+
+		/**
+		 Copy constructor (deleted)
+		 */
+		Thread_pool(const Thread_pool&) = delete;
+
+		/**
+		 Destructor
+
+		 Runs the tasks still queued, then joins the worker threads.
+		 */
+		~Thread_pool();
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Thread_pool& operator= (const Thread_pool&) = delete;
+
+		/**
+		 Queues a task, like std::async(std::launch::async, f, args...),
+		 but runs it on one of the pool's threads.
+		 Waiting on the future from inside another task of the same pool
+		 can deadlock, so don't.
+
+		 @param f [IN] The function to call.
+		 @param args [IN] Its arguments, copied (or moved) into the task.
+		 @return A future for the function's result (or exception).
+		 */
+		template <class F, class... Args>
+		std::future<typename std::result_of<F(Args...)>::type> async(F&& f, Args&&... args) {
+			using Result = typename std::result_of<F(Args...)>::type;
+			auto task = std::make_shared<std::packaged_task<Result()>>(
+				std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+			std::future<Result> result = task->get_future();
+			enqueue([task]() { (*task)(); });
+			return result;
+		}
+
+		/**
+		 Gets the number of worker threads.
+
+		 @return The number of threads tasks are spread over.
+		 */
+		unsigned thread_count() const noexcept { return static_cast<unsigned>(_threads.size()); }
+
+	private:
+		void enqueue(std::function<void()> task);
+		void start(unsigned threadCount, const std::vector<unsigned>& cpus);
+		void work(unsigned worker); // body of each worker thread
+
+		std::vector<unsigned> _cpus; // to pin the workers to, if any
+		std::vector<std::thread> _threads;
+		std::deque<std::function<void()>> _tasks;
+		std::mutex _mutex; // guards _tasks and _stopping
+		std::condition_variable _taskReady;
+		bool _stopping = false;
+	};
+
+}
+
+#endif /* Thread_pool_hpp */
@@ -0,0 +1,226 @@
+//
+//  Time_window.cpp
+//  counter
+//
+
+#include "Time_window.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+namespace counterLib {
+
+	namespace {
+		/**
+		 Output order of two entries: the higher count first, then the token.
+		 */
+		bool comes_before(const Token_count_map::value_type* a, const Token_count_map::value_type* b) noexcept {
+			if (a->second != b->second) {
+				return a->second > b->second;
+			}
+			int order = std::memcmp(a->first.data(), b->first.data(), std::min(a->first.size(), b->first.size()));
+			return order < 0 || (order == 0 && a->first.size() < b->first.size());
+		}
+
+		/**
+		 Days from 1970-01-01 to the given date of the (proleptic) Gregorian calendar.
+		 */
+		std::int64_t days_from_civil(std::int64_t year, unsigned month, unsigned day) noexcept {
+			year -= month <= 2 ? 1 : 0;
+			const std::int64_t era = (year >= 0 ? year : year - 399) / 400;
+			const unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+			const unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+			const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+			return era * 146097 + static_cast<std::int64_t>(dayOfEra) - 719468;
+		}
+
+		bool is_digit(char c) noexcept {
+			return c >= '0' && c <= '9';
+		}
+
+		/**
+		 Reads exactly n digits at line[pos], moving pos past them.
+		 */
+		bool read_digits(Token_view line, std::size_t& pos, std::size_t n, std::int64_t& value) noexcept {
+			if (pos + n > line.size()) {
+				return false;
+			}
+			value = 0;
+			for (std::size_t end = pos + n; pos < end; ++pos) {
+				if (!is_digit(line[pos])) {
+					return false;
+				}
+				value = value * 10 + (line[pos] - '0');
+			}
+			return true;
+		}
+
+		/**
+		 Reads the literal character c at line[pos], moving pos past it.
+		 */
+		bool read_char(Token_view line, std::size_t& pos, char c) noexcept {
+			if (pos < line.size() && line[pos] == c) {
+				++pos;
+				return true;
+			}
+			return false;
+		}
+
+		void skip_digits(Token_view line, std::size_t& pos) noexcept {
+			while (pos < line.size() && is_digit(line[pos])) {
+				++pos;
+			}
+		}
+	}
+
+	Time_window::Time_window(std::int64_t span, std::size_t sliceCount) :
+		_sliceSeconds { sliceCount ? (span + static_cast<std::int64_t>(sliceCount) - 1) / static_cast<std::int64_t>(sliceCount) : 0 },
+		_newest { 0 } {
+		if (span <= 0 || sliceCount == 0 || span < static_cast<std::int64_t>(sliceCount)) {
+			throw std::invalid_argument {"Time_window needs a positive span of at least one second a slice."};
+		}
+		_slices.resize(sliceCount);
+	}
+
+	bool Time_window::add(std::int64_t time, const Token_count_map& counts) {
+		const std::int64_t s = slice_of(time);
+		if (!_started || s > _newest) {
+			advance(time);
+		}
+		else if (s <= _newest - static_cast<std::int64_t>(_slices.size())) {
+			return false; // already expired
+		}
+		const auto n = static_cast<std::int64_t>(_slices.size());
+		_slices[static_cast<std::size_t>(((s % n) + n) % n)].add_batch(counts.cbegin(), counts.cend());
+		_total.add_batch(counts.cbegin(), counts.cend());
+		return true;
+	}
+
+	bool Time_window::advance(std::int64_t now) {
+		const std::int64_t s = slice_of(now);
+		if (!_started) {
+			_newest = s;
+			_started = true;
+			return false;
+		}
+		if (s <= _newest) {
+			return false;
+		}
+		// each slice moved into reuses the ring position of the one expiring
+		const auto n = static_cast<std::int64_t>(_slices.size());
+		bool expired = false;
+		for (std::int64_t i = _newest + 1; i <= std::min(s, _newest + n); ++i) {
+			Token_count_map& slice = _slices[static_cast<std::size_t>(((i % n) + n) % n)];
+			expired = expired || !slice.empty();
+			expire(slice);
+		}
+		_newest = s;
+
+		if (_zeroes > _total.size() / 2) {
+			_total.drop_zeroes();
+			_zeroes = 0;
+		}
+		return expired;
+	}
+
+	std::vector<Output_sorting_file::Token_count> Time_window::top(std::size_t k) const {
+		std::vector<const Token_count_map::value_type*> entries;
+		entries.reserve(_total.size());
+		for (auto& tc : _total) {
+			if (tc.second != 0) {
+				entries.push_back(&tc);
+			}
+		}
+		k = std::min(k, entries.size());
+		std::partial_sort(entries.begin(), entries.begin() + static_cast<std::ptrdiff_t>(k), entries.end(), comes_before);
+		std::vector<Output_sorting_file::Token_count> leaders;
+		leaders.reserve(k);
+		for (std::size_t r = 0; r < k; ++r) {
+			leaders.emplace_back(entries[r]->first.str(), entries[r]->second);
+		}
+		return leaders;
+	}
+
+	std::int64_t Time_window::slice_of(std::int64_t time) const noexcept {
+		return time >= 0 ? time / _sliceSeconds : -((-time + _sliceSeconds - 1) / _sliceSeconds);
+	}
+
+	void Time_window::expire(Token_count_map& slice) {
+		for (auto& tc : slice) {
+			auto total = _total.find(tc.first);
+			total->second -= tc.second;
+			if (total->second == 0) {
+				++_zeroes;
+			}
+		}
+		slice.clear();
+	}
+
+	bool parse_line_time(Token_view line, std::int64_t& time, std::size_t& length) noexcept {
+		std::size_t pos = 0;
+		const bool bracketed = read_char(line, pos, '[');
+		const std::size_t start = pos;
+		skip_digits(line, pos);
+		if (pos - start >= 9 && (pos == line.size() || line[pos] != '-')) {
+			// seconds since the epoch
+			if (pos - start > 18) {
+				return false; // more than an int64_t holds
+			}
+			time = 0;
+			for (std::size_t d = start; d < pos; ++d) {
+				time = time * 10 + (line[d] - '0');
+			}
+			if (read_char(line, pos, '.')) {
+				skip_digits(line, pos);
+			}
+		}
+		else {
+			// ISO 8601
+			pos = start;
+			std::int64_t year, month, day, hour, minute, second;
+			if (!(read_digits(line, pos, 4, year) && read_char(line, pos, '-')
+				  && read_digits(line, pos, 2, month) && read_char(line, pos, '-')
+				  && read_digits(line, pos, 2, day)
+				  && (read_char(line, pos, 'T') || read_char(line, pos, ' '))
+				  && read_digits(line, pos, 2, hour) && read_char(line, pos, ':')
+				  && read_digits(line, pos, 2, minute) && read_char(line, pos, ':')
+				  && read_digits(line, pos, 2, second))) {
+				return false;
+			}
+			if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+				return false;
+			}
+			if (read_char(line, pos, '.') || read_char(line, pos, ',')) {
+				skip_digits(line, pos);
+			}
+			std::int64_t offset = 0; // of the zone from UTC, in seconds
+			if (!read_char(line, pos, 'Z') && pos < line.size() && (line[pos] == '+' || line[pos] == '-')) {
+				const bool east = line[pos++] == '+';
+				std::int64_t zoneHours, zoneMinutes = 0;
+				if (!read_digits(line, pos, 2, zoneHours)) {
+					return false;
+				}
+				read_char(line, pos, ':');
+				if (!read_digits(line, pos, 2, zoneMinutes)) {
+					return false;
+				}
+				offset = (zoneHours * 60 + zoneMinutes) * 60 * (east ? 1 : -1);
+			}
+			time = days_from_civil(year, static_cast<unsigned>(month), static_cast<unsigned>(day)) * 86400
+				+ hour * 3600 + minute * 60 + second - offset;
+		}
+		if (bracketed && !read_char(line, pos, ']')) {
+			return false;
+		}
+		if (pos < line.size() && !std::isspace(static_cast<unsigned char>(line[pos]))) {
+			return false; // runs on into something else
+		}
+		while (pos < line.size() && std::isspace(static_cast<unsigned char>(line[pos]))) {
+			++pos;
+		}
+		length = pos;
+		return true;
+	}
+
+}
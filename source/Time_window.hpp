@@ -0,0 +1,122 @@
+/**
+ *	@file Time_window.hpp
+ *
+ *	Token counts over a sliding window of time, for watching growing inputs
+ *	such as logs (see Watch_counter).
+ */
+
+#ifndef Time_window_hpp
+#define Time_window_hpp
+
+#include <cstdint>
+#include <vector>
+#include "Output_sorting_file.hpp"
+#include "Token_count_map.hpp"
+
+namespace counterLib {
+
+	/**
+	 Token counts of the last span seconds, kept as a ring of time slices.
+
+	 Counts are added to the slice of their time (seconds since the epoch),
+	 and to the window's total. As time moves on, each slice that falls out of
+	 the window has its counts subtracted from the total and is emptied for reuse,
+	 so expiring costs time in the slice's vocabulary, not in the window's.
+	 Memory is bounded by the number of slices times the vocabulary of a slice,
+	 plus the total. The window moves in whole slices, so it covers between
+	 span - span / slices and span seconds.
+	 */
+	class Time_window {
+	public:
+		/**
+		 Initializing Constructor
+
+		 Throws std::invalid_argument if the span or the slice count is 0,
+		 or the span is shorter than the slice count.
+
+		 @param span [IN] Length of the window, in seconds.
+		 @param sliceCount [IN] Number of slices the window is divided into.
+		 */
+		Time_window(std::int64_t span, std::size_t sliceCount);
+
+		/**
+		 Copy constructor (deleted)
+
+		 Deleted since the slices may be large; move the window instead.
+		 */
+		Time_window(const Time_window&) = delete;
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Time_window& operator= (const Time_window&) = delete;
+
+		/**
+		 Adds counts seen at the given time. A time later than any before
+		 moves the window on (see advance()); counts older than the window are dropped.
+
+		 @param time [IN] When the tokens were seen, in seconds since the epoch.
+		 @param counts [IN] The tokens and their counts.
+		 @return false if the counts were too old to add.
+		 */
+		bool add(std::int64_t time, const Token_count_map& counts);
+
+		/**
+		 Moves the window on to end at the given time, expiring the slices that fall out of it.
+		 Earlier times than the window's end are ignored.
+
+		 @param now [IN] The time, in seconds since the epoch.
+		 @return Whether any counts expired.
+		 */
+		bool advance(std::int64_t now);
+
+		/**
+		 Gets the window's counts. Tokens whose counts have all expired
+		 may be present with a count of 0.
+
+		 @return The total of the slices in the window.
+		 */
+		const Token_count_map& counts() const noexcept { return _total; }
+
+		/**
+		 Gets the most frequent tokens of the window.
+
+		 @param k [IN] Most tokens to get.
+		 @return Up to k tokens and their counts, in output order (see Output_sorting_file::TC_compare).
+		 */
+		std::vector<Output_sorting_file::Token_count> top(std::size_t k) const;
+
+		/**
+		 Gets the number of seconds each slice covers: the span divided by the slice count, rounded up.
+		 */
+		std::int64_t slice_seconds() const noexcept { return _sliceSeconds; }
+
+	private:
+		std::int64_t slice_of(std::int64_t time) const noexcept; // floor(time / _sliceSeconds)
+		void expire(Token_count_map& slice);
+
+		std::int64_t _sliceSeconds;
+		std::vector<Token_count_map> _slices; // ring; slice index i is at i % _slices.size()
+		std::int64_t _newest; // index of the newest slice in the window
+		bool _started = false; // whether _newest has been set by the first add or advance
+		Token_count_map _total;
+		std::size_t _zeroes = 0; // counts of _total that have dropped to 0
+	};
+
+	/**
+	 Reads the timestamp at the start of a log line: seconds since the epoch
+	 (at least 9 digits, as in "1700000000.25"), or an ISO 8601 date and time
+	 ("2024-05-01T12:30:00", with a space for the T allowed, an optional fraction,
+	 and a "Z" or "+hh:mm" zone; UTC if none is given).
+	 Either may be wrapped in brackets, as in "[2024-05-01 12:30:00]".
+
+	 @param line [IN] The line.
+	 @param time [OUT] The time, in whole seconds since the epoch.
+	 @param length [OUT] The length of the timestamp and any whitespace after it.
+	 @return false if the line doesn't start with a timestamp.
+	 */
+	bool parse_line_time(Token_view line, std::int64_t& time, std::size_t& length) noexcept;
+
+}
+
+#endif /* Time_window_hpp */
@@ -0,0 +1,301 @@
+//
+//  Token_count_map.cpp
+//  counter
+//
+
+#include "Token_count_map.hpp"
+#include <cstring>
+#include <memory>
+
+namespace counterLib {
+
+	const std::size_t Token_count_map::batch_size;
+
+	namespace {
+		const std::size_t key_arena_chunk_size = 4 * 1024;
+		const std::size_t min_slot_count = 16;
+
+		/**
+		 Hints the processor to start loading the given address into cache.
+		 */
+		inline void prefetch(const void* address) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+			__builtin_prefetch(address);
+#else
+			(void)address;
+#endif
+		}
+	}
+
+	Token_count_map::Token_count_map(Memory_resource* resource) :
+		_resource { resource },
+		_keyArena { key_arena_chunk_size, resource } { }
+
+	Token_count_map::Token_count_map(const Token_count_map& other) :
+		Token_count_map { new_delete_resource() } {
+		reserve(other.size());
+		for (auto& tc : other) {
+			try_emplace(tc.first, tc.second);
+		}
+	}
+
+	Token_count_map::Token_count_map(Token_count_map&& other) noexcept :
+		_resource { other._resource },
+		_keyArena { key_arena_chunk_size, other._resource } {
+		swap(other);
+	}
+
+	Token_count_map::~Token_count_map() {
+		deallocate();
+	}
+
+	Token_count_map& Token_count_map::operator= (const Token_count_map& other) {
+		Token_count_map copy { other };
+		swap(copy);
+		return *this;
+	}
+
+	Token_count_map& Token_count_map::operator= (Token_count_map&& other) noexcept {
+		Token_count_map moved { std::move(other) };
+		swap(moved);
+		return *this;
+	}
+
+	void Token_count_map::swap(Token_count_map& other) noexcept {
+		std::swap(_resource, other._resource);
+		_keyArena.swap(other._keyArena);
+		std::swap(_entries, other._entries);
+		std::swap(_size, other._size);
+		std::swap(_capacity, other._capacity);
+		std::swap(_slots, other._slots);
+		std::swap(_slotCount, other._slotCount);
+	}
+
+	std::size_t Token_count_map::probe(Token_view key, std::size_t hash) const noexcept {
+		const std::size_t mask = _slotCount - 1;
+		const std::uint32_t tag = tag_of(hash);
+		std::size_t s = hash & mask;
+		while (_slots[s].entry != 0) {
+			if (_slots[s].tag == tag && _entries[_slots[s].entry - 1].first == key) {
+				break;
+			}
+			s = (s + 1) & mask; // linear probing
+		}
+		return s;
+	}
+
+	Token_count_map::iterator Token_count_map::find(Token_view key) noexcept {
+		if (_size == 0) {
+			return end();
+		}
+		const Slot& slot = _slots[probe(key, hash_token(key.data(), key.size()))];
+		return slot.entry == 0 ? end() : _entries + (slot.entry - 1);
+	}
+
+	Token_count_map::const_iterator Token_count_map::find(Token_view key) const noexcept {
+		return const_cast<Token_count_map*>(this)->find(key);
+	}
+
+	std::pair<Token_count_map::iterator, bool> Token_count_map::try_emplace(Token_view key, Count count) {
+		return try_emplace_hashed(key, hash_token(key.data(), key.size()), count);
+	}
+
+	std::pair<Token_count_map::iterator, bool> Token_count_map::try_emplace_hashed(Token_view key, std::size_t hash, Count count) {
+		if (_slotCount != 0) {
+			const Slot& slot = _slots[probe(key, hash)];
+			if (slot.entry != 0) {
+				return { _entries + (slot.entry - 1), false }; // the common case: no allocation
+			}
+		}
+
+		// a new token: make room, then copy its characters into the key arena
+		grow_for_insert();
+		Slot& slot = _slots[probe(key, hash)];
+
+		char* chars = nullptr;
+		if (!key.empty()) {
+			chars = static_cast<char*>(_keyArena.allocate(key.size(), 1));
+			std::memcpy(chars, key.data(), key.size());
+		}
+		::new (static_cast<void*>(_entries + _size)) value_type { Token_view { chars, key.size() }, count };
+		++_size;
+		slot.entry = static_cast<std::uint32_t>(_size);
+		slot.tag = tag_of(hash);
+		return { _entries + (_size - 1), true };
+	}
+
+	template <class Key_of>
+	void Token_count_map::prepare_batch(Key_of key, size_type n, std::size_t* hashes) const noexcept {
+		// first pass: hash everything and start loading each key's home slot
+		const std::size_t mask = _slotCount - 1;
+		for (size_type k = 0; k < n; ++k) {
+			const Token_view t = key(k);
+			hashes[k] = hash_token(t.data(), t.size());
+			if (_slotCount != 0) {
+				prefetch(_slots + (hashes[k] & mask));
+			}
+		}
+		// second pass: the slots should be arriving; start loading the entries they point at
+		if (_slotCount != 0) {
+			for (size_type k = 0; k < n; ++k) {
+				const Slot& slot = _slots[hashes[k] & mask];
+				if (slot.entry != 0) {
+					prefetch(_entries + (slot.entry - 1));
+				}
+			}
+		}
+	}
+
+	void Token_count_map::add_batch(const Token_view* keys, size_type n, size_type* positions) {
+		std::size_t hashes[batch_size];
+		while (n > 0) {
+			const size_type b = n < batch_size ? n : batch_size;
+			prepare_batch([keys](size_type k) { return keys[k]; }, b, hashes);
+			for (size_type k = 0; k < b; ++k) {
+				iterator entry = try_emplace_hashed(keys[k], hashes[k], 0).first;
+				++entry->second;
+				if (positions) {
+					*positions++ = static_cast<size_type>(entry - _entries);
+				}
+			}
+			keys += b;
+			n -= b;
+		}
+	}
+
+	void Token_count_map::add_batch(const_iterator first, const_iterator last, size_type* positions) {
+		std::size_t hashes[batch_size];
+		while (first != last) {
+			const size_type n = static_cast<size_type>(last - first);
+			const size_type b = n < batch_size ? n : batch_size;
+			prepare_batch([first](size_type k) { return first[k].first; }, b, hashes);
+			for (size_type k = 0; k < b; ++k) {
+				iterator entry = try_emplace_hashed(first[k].first, hashes[k], 0).first;
+				entry->second += first[k].second;
+				if (positions) {
+					*positions++ = static_cast<size_type>(entry - _entries);
+				}
+			}
+			first += b;
+		}
+	}
+
+	void Token_count_map::reserve(size_type n) {
+		if (n > _capacity) {
+			reallocate_entries(n);
+		}
+		size_type slotCount = _slotCount < min_slot_count ? min_slot_count : _slotCount;
+		while (slotCount * 3 < n * 4) { // keep the load factor at or below 3/4
+			slotCount *= 2;
+		}
+		if (slotCount != _slotCount) {
+			rehash(slotCount);
+		}
+	}
+
+	void Token_count_map::clear() noexcept {
+		// entries are trivially destructible
+		_size = 0;
+		if (_slots) {
+			std::memset(_slots, 0, _slotCount * sizeof(Slot));
+		}
+		_keyArena.reset();
+	}
+	
+	void Token_count_map::scale(Count factor) noexcept {
+		for (auto& entry : *this) {
+			entry.second *= factor;
+		}
+	}
+
+	void Token_count_map::drop_zeroes() {
+		size_type live = 0;
+		for (auto& entry : *this) {
+			live += entry.second != 0 ? 1 : 0;
+		}
+		if (live == _size) {
+			return;
+		}
+		Token_count_map rebuilt { _resource };
+		rebuilt.reserve(live);
+		for (auto& entry : *this) {
+			if (entry.second != 0) {
+				rebuilt.try_emplace(entry.first, entry.second);
+			}
+		}
+		swap(rebuilt);
+	}
+
+	void Token_count_map::grow_for_insert() {
+		if (_size == _capacity) {
+			reallocate_entries(_capacity < min_slot_count ? min_slot_count : _capacity * 2);
+		}
+		if ((_size + 1) * 4 > _slotCount * 3) {
+			rehash(_slotCount < min_slot_count ? min_slot_count : _slotCount * 2);
+		}
+	}
+
+	void Token_count_map::rehash(size_type slotCount) {
+		auto slots = static_cast<Slot*>(_resource->allocate(slotCount * sizeof(Slot), alignof(Slot)));
+		std::memset(slots, 0, slotCount * sizeof(Slot));
+		if (_slots) {
+			_resource->deallocate(_slots, _slotCount * sizeof(Slot), alignof(Slot));
+		}
+		_slots = slots;
+		_slotCount = slotCount;
+
+		// re-insert every entry; keys are unique, so just look for an empty slot
+		const std::size_t mask = _slotCount - 1;
+		for (size_type e = 0; e < _size; ++e) {
+			const Token_view key = _entries[e].first;
+			const std::size_t hash = hash_token(key.data(), key.size());
+			std::size_t s = hash & mask;
+			while (_slots[s].entry != 0) {
+				s = (s + 1) & mask;
+			}
+			_slots[s].entry = static_cast<std::uint32_t>(e + 1);
+			_slots[s].tag = tag_of(hash);
+		}
+	}
+
+	void Token_count_map::reallocate_entries(size_type capacity) {
+		auto entries = static_cast<value_type*>(_resource->allocate(capacity * sizeof(value_type), alignof(value_type)));
+		if (_entries) {
+			std::uninitialized_copy(_entries, _entries + _size, entries);
+			_resource->deallocate(_entries, _capacity * sizeof(value_type), alignof(value_type));
+		}
+		_entries = entries;
+		_capacity = capacity;
+	}
+
+	void Token_count_map::deallocate() noexcept {
+		if (_entries) {
+			_resource->deallocate(_entries, _capacity * sizeof(value_type), alignof(value_type));
+		}
+		if (_slots) {
+			_resource->deallocate(_slots, _slotCount * sizeof(Slot), alignof(Slot));
+		}
+		_entries = nullptr;
+		_slots = nullptr;
+		_size = _capacity = _slotCount = 0;
+		_keyArena.release();
+	}
+
+	bool operator== (const Token_count_map& a, const Token_count_map& b) noexcept {
+		if (a.size() != b.size()) {
+			return false;
+		}
+		for (auto& tc : a) {
+			auto i = b.find(tc.first);
+			if (i == b.end() || i->second != tc.second) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void swap(Token_count_map& left, Token_count_map& right) noexcept {
+		left.swap(right);
+	}
+
+}
@@ -0,0 +1,310 @@
+/**
+ *	@file Token_count_map.hpp
+ *
+ *	Hash table from tokens to their frequency counts.
+ */
+
+#ifndef Token_count_map_hpp
+#define Token_count_map_hpp
+
+#include <cstdint>
+#include <utility>
+#include "String_utils.hpp"
+#include "Memory_resource.hpp"
+
+namespace counterLib {
+
+	/**
+	 The count of a token (or n-gram).
+	 64 bits, so that the commonest tokens of the largest corpora can't wrap.
+	 An entry of a Token_count_map is a Token_view (two words) and its count,
+	 so on 64-bit platforms the wider count only fills what would otherwise be padding.
+	 */
+	using Count = std::int64_t;
+
+	/**
+	 Hash table mapping tokens to their counts, built for the tokenizer's hot loop.
+
+	 Lookups take a Token_view, so a token can be looked up straight out of
+	 a read buffer without first being copied into a string (heterogeneous lookup).
+	 try_emplace() and operator[] hash the key once, whether or not it is already present,
+	 and only a genuinely new token costs an allocation: its characters are copied
+	 into a key arena owned by the map.
+
+	 Entries are kept densely in insertion order and found through an
+	 open-addressing (linear probing) index, so iteration is a linear walk.
+	 Otherwise the interface follows std::unordered_map:
+	 each entry is a std::pair of the token and its count.
+	 Iterators and references are invalidated by insertion of a new token.
+
+	 All memory (entries, index and key chunks) comes from the Memory_resource
+	 given to the constructor, typically a per-thread Monotonic_arena.
+	 */
+	class Token_count_map {
+	public:
+		using key_type = Token_view;
+		using mapped_type = Count;
+		using value_type = std::pair<const Token_view, Count>;
+		using size_type = std::size_t;
+		using iterator = value_type*;
+		using const_iterator = const value_type*;
+
+		/**
+		 Initializing Constructor
+
+		 @param resource [IN] Where the map's memory comes from. Must outlive the map.
+		 */
+		explicit Token_count_map(Memory_resource* resource = new_delete_resource());
+
+		/**
+		 Copy constructor
+
+		 Like copies of an Arena_allocator, the copy uses new_delete_resource(),
+		 so it never refers to an arena it does not own.
+
+		 @param other [IN] The map to copy, keys included.
+		 */
+		Token_count_map(const Token_count_map& other);
+
+		/**
+		 Move constructor
+
+		 Takes over other's memory and resource. Leaves other empty.
+
+		 @param other [IN] rvalue of another Token_count_map.
+		 */
+		Token_count_map(Token_count_map&& other) noexcept;
+
+		/**
+		 Destructor
+
+		 Gives all memory back to the resource.
+		 */
+		~Token_count_map();
+
+		/**
+		 Copy Assignment Operator
+
+		 @param other [IN] The map to copy.
+		 @return reference to this map, now using new_delete_resource().
+		 */
+		Token_count_map& operator= (const Token_count_map& other);
+
+		/**
+		 Move Assignment Operator
+
+		 @param other [IN] rvalue of another Token_count_map.
+		 @return reference to this map, now using other's resource.
+		 */
+		Token_count_map& operator= (Token_count_map&& other) noexcept;
+
+		/**
+		 Member function that efficiently swaps the contents (and resources) of two maps.
+
+		 @param other [IN/OUT] Reference to another Token_count_map.
+		 */
+		void swap(Token_count_map& other) noexcept;
+
+		size_type size() const noexcept { return _size; }
+		bool empty() const noexcept { return _size == 0; }
+		
+		/**
+		 Gets the fraction of index slots in use.
+
+		 @return size() over the slot count, 0 if there is no index yet.
+		 */
+		double load_factor() const noexcept { return _slotCount ? static_cast<double>(_size) / _slotCount : 0; }
+
+		iterator begin() noexcept { return _entries; }
+		iterator end() noexcept { return _entries + _size; }
+		const_iterator begin() const noexcept { return _entries; }
+		const_iterator end() const noexcept { return _entries + _size; }
+		const_iterator cbegin() const noexcept { return _entries; }
+		const_iterator cend() const noexcept { return _entries + _size; }
+
+		/**
+		 Looks up a token.
+
+		 @param key [IN] The token. Need not be stored anywhere in particular.
+		 @return Iterator to the token's entry, or end() if not present.
+		 */
+		iterator find(Token_view key) noexcept;
+
+		/**
+		 Const version of find().
+
+		 @param key [IN] The token.
+		 @return Iterator to the token's entry, or end() if not present.
+		 */
+		const_iterator find(Token_view key) const noexcept;
+
+		/**
+		 Inserts the token with the given count if it is not present yet.
+		 Hashes the key only once either way.
+
+		 @param key [IN] The token. Copied into the map only when it is new.
+		 @param count [IN] The count of a new entry.
+		 @return Iterator to the token's entry, and whether it was inserted.
+		 */
+		std::pair<iterator, bool> try_emplace(Token_view key, Count count = 0);
+
+		/**
+		 Gets the count of a token, inserting it with a count of 0 if not present.
+		 Allows single-hash upserts such as ++tcm[token].
+
+		 @param key [IN] The token.
+		 @return Reference to the token's count.
+		 */
+		Count& operator[] (Token_view key) { return try_emplace(key).first->second; }
+
+		/**
+		 The number of tokens add_batch() works on at a time.
+		 */
+		static const std::size_t batch_size = 64;
+		
+		/**
+		 Adds one to the count of each of the given tokens, inserting new ones.
+		 Equivalent to ++(*this)[key] for each key in turn, but latency-bound
+		 lookups are overlapped: the keys are hashed and their index slots and
+		 entries prefetched batch_size at a time, before any count is touched.
+		 
+		 @param keys [IN] Pointer to the first of the tokens.
+		 @param n [IN] Number of tokens.
+		 @param positions [OUT] Optional. If given, receives the position in this map
+			(begin() + position) of each key, n of them.
+		 */
+		void add_batch(const Token_view* keys, size_type n, size_type* positions = nullptr);
+		
+		/**
+		 Adds the counts of the given entries (for example those of another map)
+		 to this map, a batch at a time, as add_batch() above.
+		 
+		 @param first [IN] Iterator to the first entry to add.
+		 @param last [IN] Iterator to just past the last entry to add.
+		 @param positions [OUT] Optional. If given, receives the position in this map
+			(begin() + position) of each added entry's token, last - first of them.
+			Positions stay valid as tokens are added, until clear().
+		 */
+		void add_batch(const_iterator first, const_iterator last, size_type* positions = nullptr);
+		
+		/**
+		 Makes room for at least n tokens without rehashing.
+
+		 @param n [IN] Number of tokens expected.
+		 */
+		void reserve(size_type n);
+
+		/**
+		 Removes all tokens. Keeps the entry and index capacity,
+		 and the most recent chunk of key memory, so that a reused map
+		 doesn't need to allocate again until it outgrows its last use.
+		 */
+		void clear() noexcept;
+		
+		/**
+		 Multiplies every count, as if the counted text had been seen factor times.
+
+		 @param factor [IN] The multiplier.
+		 */
+		void scale(Count factor) noexcept;
+		
+		/**
+		 Removes the tokens counted 0 (as by subtracting counts), which there is
+		 no erasing one at a time: the map is rebuilt from the rest, in their order,
+		 on the same resource. Positions from add_batch() don't hold afterwards.
+		 */
+		void drop_zeroes();
+
+		/**
+		 Gets the resource the map allocates from.
+
+		 @return Pointer to the Memory_resource.
+		 */
+		Memory_resource* resource() const noexcept { return _resource; }
+
+	private:
+		/**
+		 One position of the open-addressing index.
+		 entry is 1 + the position of the entry in _entries, or 0 when the slot is empty.
+		 tag holds the upper hash bits, to skip most key comparisons.
+		 */
+		struct Slot {
+			std::uint32_t entry;
+			std::uint32_t tag;
+		};
+
+		/**
+		 try_emplace() for a key whose hash is already known.
+		 */
+		std::pair<iterator, bool> try_emplace_hashed(Token_view key, std::size_t hash, Count count);
+		
+		/**
+		 Hashes the keys of one batch and prefetches the memory their lookups will touch.
+		 
+		 @param key [IN] Function giving the i'th key of the batch.
+		 @param n [IN] Number of keys, at most batch_size.
+		 @param hashes [OUT] The hash of each key.
+		 */
+		template <class Key_of>
+		void prepare_batch(Key_of key, size_type n, std::size_t* hashes) const noexcept;
+		
+		/**
+		 Finds the slot holding the given key, or the empty slot where it would go.
+		 */
+		std::size_t probe(Token_view key, std::size_t hash) const noexcept;
+
+		/**
+		 Makes room for one more entry, growing the entries array and index as needed.
+		 */
+		void grow_for_insert();
+
+		/**
+		 Rebuilds the index with the given number of slots (a power of two).
+		 */
+		void rehash(size_type slotCount);
+
+		/**
+		 Grows the entries array to the given capacity.
+		 */
+		void reallocate_entries(size_type capacity);
+
+		/**
+		 Frees the entries and the index.
+		 */
+		void deallocate() noexcept;
+
+		static std::uint32_t tag_of(std::size_t hash) noexcept {
+			return static_cast<std::uint32_t>(static_cast<unsigned long long>(hash) >> 32);
+		}
+
+		Memory_resource* _resource;
+		Monotonic_arena _keyArena; // characters of the keys, upstream is _resource
+		value_type* _entries = nullptr;
+		size_type _size = 0;
+		size_type _capacity = 0;
+		Slot* _slots = nullptr;
+		size_type _slotCount = 0; // zero or a power of two
+	};
+
+	/**
+	 Two maps are equal when they hold the same tokens with the same counts,
+	 in any order.
+	 */
+	bool operator== (const Token_count_map& a, const Token_count_map& b) noexcept;
+
+	inline bool operator!= (const Token_count_map& a, const Token_count_map& b) noexcept {
+		return !(a == b);
+	}
+
+	/**
+	 Forwards swapping to the member function
+	 that implements the operation most efficiently.
+
+	 @param left [IN/OUT] First Token_count_map. When done this will have the right values.
+	 @param right [IN/OUT] Second Token_count_map. When done this will have the left values
+	 */
+	void swap(Token_count_map& left, Token_count_map& right) noexcept;
+
+}
+
+#endif /* Token_count_map_hpp */
@@ -0,0 +1,102 @@
+//
+//  Token_ids.cpp
+//  counter
+//
+
+#include "Token_ids.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace counterLib {
+
+	const std::size_t Id_file_writer::buffer_size = 64 * 1024;
+
+	Id_file_writer::Id_file_writer(const std::string& fileName) :
+		_fileName { fileName },
+		_file { fileName, std::ios::binary | std::ios::trunc } {
+		if (!_file.is_open()) {
+			throw std::invalid_argument {"Id_file_writer unable to open token ID file: " + fileName};
+		}
+		_buffer.reserve(buffer_size + max_varint_bytes);
+	}
+
+	Id_file_writer::~Id_file_writer() {
+		try {
+			flush();
+		}
+		catch (std::exception&) {
+			// nothing to be done about it here; call flush() to find out
+		}
+	}
+
+	void Id_file_writer::flush() {
+		_file.write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+		_buffer.clear();
+		if (!_file) {
+			throw std::runtime_error {"Id_file_writer unable to write token ID file: " + _fileName};
+		}
+	}
+
+	Id_file_reader::Id_file_reader(const std::string& fileName) :
+		_fileName { fileName },
+		_file { fileName, std::ios::binary },
+		_buffer(Id_file_writer::buffer_size) {
+		if (!_file.is_open()) {
+			throw std::invalid_argument {"Unable to open token ID file: " + fileName};
+		}
+	}
+
+	void Id_file_reader::fill() {
+		std::copy(_buffer.begin() + _next, _buffer.begin() + _end, _buffer.begin());
+		_end -= _next;
+		_next = 0;
+		_file.read(reinterpret_cast<char*>(_buffer.data() + _end), static_cast<std::streamsize>(_buffer.size() - _end));
+		_end += static_cast<std::size_t>(_file.gcount());
+		_ended = !_file;
+	}
+
+	bool Id_file_reader::get(std::uint32_t& id) {
+		if (_end - _next < max_varint_bytes && !_ended) {
+			fill(); // so a whole ID is buffered, unless the file ends first
+		}
+		if (_next == _end) {
+			return false;
+		}
+		const unsigned char* p = _buffer.data() + _next;
+		std::uint64_t value;
+		if (!read_varint(p, _buffer.data() + _end, value)) {
+			if (p == _buffer.data() + _end) {
+				throw std::invalid_argument {"Token ID file ends within an ID: " + _fileName};
+			}
+			throw std::invalid_argument {"Token ID file holds an ID of more than 32 bits: " + _fileName};
+		}
+		if (value > UINT32_MAX) {
+			throw std::invalid_argument {"Token ID file holds an ID of more than 32 bits: " + _fileName};
+		}
+		_next = static_cast<std::size_t>(p - _buffer.data());
+		id = static_cast<std::uint32_t>(value);
+		return true;
+	}
+
+	std::vector<std::uint32_t> read_id_file(const std::string& fileName) {
+		Id_file_reader reader { fileName };
+		std::vector<std::uint32_t> ids;
+		for (std::uint32_t id; reader.get(id); ) {
+			ids.push_back(id);
+		}
+		return ids;
+	}
+
+	std::string id_file_name(const std::string& directory, std::size_t position) {
+		return directory + "/" + std::to_string(position) + ".ids";
+	}
+
+	std::string spill_file_name(const std::string& directory, std::size_t number) {
+		return id_file_name(directory, number) + ".tmp";
+	}
+
+	std::string vocabulary_file_name(const std::string& directory) {
+		return directory + "/vocabulary.txt";
+	}
+
+}
@@ -0,0 +1,191 @@
+/**
+ *	@file Token_ids.hpp
+ *
+ *	Inputs written as streams of dense token IDs, so that a corpus
+ *	counted once needn't be tokenized again downstream.
+ */
+
+#ifndef Token_ids_hpp
+#define Token_ids_hpp
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Token_count_map.hpp"
+#include "Varint.hpp"
+
+namespace counterLib {
+
+	/**
+	 The counts of one input along with the file its tokens were spilled to, in order,
+	 each as a position in the counts (begin() + position), in the format of Id_file_writer.
+	 */
+	struct Token_stream {
+		Token_count_map counts;
+		std::string spill_file_name; // empty if the input was skipped
+
+		explicit Token_stream(Memory_resource* resource = new_delete_resource()) : counts { resource } { }
+
+		Token_count_map::size_type size() const noexcept { return counts.size(); }
+		double load_factor() const noexcept { return counts.load_factor(); }
+	};
+
+	/**
+	 A Token_stream once its counts are merged: the file it was spilled to,
+	 and the position in the merged counts of each token of the input's own counts,
+	 by which the spilled positions are translated.
+	 */
+	struct Spilled_stream {
+		std::string file_name;
+		std::vector<std::uint32_t> positions; // in the merged counts, by position in the input's counts
+	};
+
+	/**
+	 Writes a file of token IDs, each as an unsigned LEB128 varint (see Varint.hpp),
+	 so with IDs given in order of frequency most tokens take one or two bytes.
+	 */
+	class Id_file_writer {
+	public:
+		/**
+		 Initializing Constructor
+
+		 Opens (truncates) the file. Throws std::invalid_argument if it can't be opened.
+
+		 @param fileName [IN] Filename (path) of the file to write.
+		 */
+		explicit Id_file_writer(const std::string& fileName);
+
+		/**
+		 Copy constructor (deleted)
+
+		 Deleted because the file stream can't be copied.
+		 */
+		Id_file_writer(const Id_file_writer&) = delete;
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Id_file_writer& operator= (const Id_file_writer&) = delete;
+
+		/**
+		 Destructor
+
+		 Writes what is buffered and closes the file.
+		 */
+		~Id_file_writer();
+
+		/**
+		 Appends one ID.
+
+		 @param id [IN] The token ID.
+		 */
+		void put(std::uint32_t id) {
+			append_varint(_buffer, id);
+			if (_buffer.size() >= buffer_size) {
+				flush();
+			}
+		}
+
+		/**
+		 Writes what is buffered. Throws std::runtime_error if writing fails.
+		 */
+		void flush();
+
+		/**
+		 Bytes buffered before they are written.
+		 */
+		static const std::size_t buffer_size;
+
+	private:
+		std::string _fileName;
+		std::ofstream _file;
+		std::string _buffer;
+	};
+
+	/**
+	 Reads a file written by Id_file_writer, an ID at a time,
+	 so a file of any length is read in the memory of its buffer.
+	 */
+	class Id_file_reader {
+	public:
+		/**
+		 Initializing Constructor
+
+		 Opens the file. Throws std::invalid_argument if it can't be opened.
+
+		 @param fileName [IN] Filename (path) of the file to read.
+		 */
+		explicit Id_file_reader(const std::string& fileName);
+
+		/**
+		 Copy constructor (deleted)
+
+		 Deleted because the file stream can't be copied.
+		 */
+		Id_file_reader(const Id_file_reader&) = delete;
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Id_file_reader& operator= (const Id_file_reader&) = delete;
+
+		/**
+		 Reads the next ID.
+		 Throws std::invalid_argument if the file ends within an ID or holds one of more than 32 bits.
+
+		 @param id [OUT] The token ID, if there was one.
+		 @return false at the end of the file.
+		 */
+		bool get(std::uint32_t& id);
+
+	private:
+		void fill(); // moves the unread bytes to the front of the buffer and reads more after them
+
+		std::string _fileName;
+		std::ifstream _file;
+		std::vector<unsigned char> _buffer;
+		std::size_t _next = 0; // of the unread bytes in _buffer
+		std::size_t _end = 0;
+		bool _ended = false; // whether the whole file has been read into _buffer
+	};
+
+	/**
+	 Reads a file written by Id_file_writer.
+	 Throws std::invalid_argument if it can't be opened or ends within an ID.
+
+	 @param fileName [IN] Filename (path) of the file.
+	 @return The token IDs, in order.
+	 */
+	std::vector<std::uint32_t> read_id_file(const std::string& fileName);
+
+	/**
+	 Names the token ID file of an input: "position.ids" in the directory.
+
+	 @param directory [IN] The output directory.
+	 @param position [IN] The input's position in its list, from 0.
+	 @return The filename (path).
+	 */
+	std::string id_file_name(const std::string& directory, std::size_t position);
+
+	/**
+	 Names a temporary file of token positions, spilled while counting: "number.ids.tmp" in the directory.
+
+	 @param directory [IN] The output directory.
+	 @param number [IN] The spill's number, from 0.
+	 @return The filename (path).
+	 */
+	std::string spill_file_name(const std::string& directory, std::size_t number);
+
+	/**
+	 Names the vocabulary file of token ID output: "vocabulary.txt" in the directory,
+	 which holds each token on the line of its ID (the first line being ID 0).
+
+	 @param directory [IN] The output directory.
+	 @return The filename (path).
+	 */
+	std::string vocabulary_file_name(const std::string& directory);
+
+}
+
+#endif /* Token_ids_hpp */
@@ -0,0 +1,327 @@
+//
+//  Token_index.cpp
+//  counter
+//
+
+#include "Token_index.hpp"
+#include "Varint.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace counterLib {
+
+	const std::size_t Token_index::block_size = 32;
+
+	namespace {
+		const char index_magic[8] = { 'C', 'N', 'T', 'I', 'D', 'X', '1', '\n' };
+		const std::size_t header_size = sizeof(index_magic) + 3 * sizeof(std::uint64_t); // magic, entries, blocks, table offset
+		const std::size_t table_entry_size = 2 * sizeof(std::uint64_t); // block offset, highest count
+		const std::size_t write_buffer_size = 64 * 1024;
+
+		/**
+		 Bytewise order of tokens, shorter first on a tie (as std::string orders them).
+		 */
+		int compare(Token_view a, Token_view b) noexcept {
+			int order = std::memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+			return order != 0 ? order : (a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0));
+		}
+
+		bool starts_with(Token_view token, Token_view prefix) noexcept {
+			return token.size() >= prefix.size() && std::memcmp(token.data(), prefix.data(), prefix.size()) == 0;
+		}
+
+		void append_word(std::string& bytes, std::uint64_t value) {
+			char word[sizeof(value)];
+			std::memcpy(word, &value, sizeof(value));
+			bytes.append(word, sizeof(value));
+		}
+
+		std::uint64_t read_word(const unsigned char* p) noexcept {
+			std::uint64_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		/**
+		 Reads a varint of a block at p, moving p past it.
+		 Throws std::runtime_error if it runs past end or is too long.
+		 */
+		std::uint64_t read_block_varint(const unsigned char*& p, const unsigned char* end) {
+			std::uint64_t value;
+			if (!read_varint(p, end, value)) {
+				throw std::runtime_error {"Token_index found a corrupt block"};
+			}
+			return value;
+		}
+
+		void require_bytes(const unsigned char* p, std::uint64_t n, const unsigned char* end) {
+			if (n > static_cast<std::uint64_t>(end - p)) {
+				throw std::runtime_error {"Token_index found a corrupt block"};
+			}
+		}
+	}
+
+	void write_token_index(const std::string& fileName, const Token_count_map& tcm, Count minCount) {
+		std::vector<const Token_count_map::value_type*> entries;
+		entries.reserve(tcm.size());
+		for (auto& entry : tcm) {
+			if (entry.second >= minCount) {
+				entries.push_back(&entry);
+			}
+		}
+		std::sort(entries.begin(), entries.end(), [](const Token_count_map::value_type* a, const Token_count_map::value_type* b) {
+			return compare(a->first, b->first) < 0;
+		});
+
+		std::ofstream file { fileName, std::ios::binary | std::ios::trunc };
+		if (!file.is_open()) {
+			throw std::invalid_argument {"Unable to open index file: " + fileName};
+		}
+		const std::uint64_t blockCount = (entries.size() + Token_index::block_size - 1) / Token_index::block_size;
+		std::string bytes(index_magic, sizeof(index_magic));
+		append_word(bytes, entries.size());
+		append_word(bytes, blockCount);
+		append_word(bytes, 0); // the table offset, once known
+		std::uint64_t offset = 0; // of bytes[0] in the file
+		std::string table;
+		table.reserve(blockCount * table_entry_size);
+		for (std::uint64_t b = 0; b < blockCount; ++b) {
+			append_word(table, offset + bytes.size());
+			Count highest = 0;
+			Token_view previous;
+			auto last = std::min<std::size_t>(entries.size(), (b + 1) * Token_index::block_size);
+			for (std::size_t e = b * Token_index::block_size; e < last; ++e) {
+				Token_view token = entries[e]->first;
+				if (e == b * Token_index::block_size) {
+					append_varint(bytes, token.size());
+					bytes.append(token.data(), token.size());
+				}
+				else {
+					std::size_t shared = 0;
+					while (shared < previous.size() && shared < token.size() && previous[shared] == token[shared]) {
+						++shared;
+					}
+					append_varint(bytes, shared);
+					append_varint(bytes, token.size() - shared);
+					bytes.append(token.data() + shared, token.size() - shared);
+				}
+				append_varint(bytes, static_cast<std::uint64_t>(entries[e]->second));
+				highest = std::max(highest, entries[e]->second);
+				previous = token;
+			}
+			append_word(table, static_cast<std::uint64_t>(highest));
+			if (bytes.size() >= write_buffer_size) {
+				file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+				offset += bytes.size();
+				bytes.clear();
+			}
+		}
+		file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+		const std::uint64_t tableOffset = offset + bytes.size();
+		file.write(table.data(), static_cast<std::streamsize>(table.size()));
+		file.seekp(static_cast<std::streamoff>(header_size - sizeof(std::uint64_t)));
+		bytes.clear();
+		append_word(bytes, tableOffset);
+		file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+		file.flush();
+		if (!file) {
+			throw std::runtime_error {"Unable to write index file: " + fileName};
+		}
+	}
+
+	Token_index::Token_index(const std::string& fileName) {
+		int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			throw std::invalid_argument {"Token_index unable to open index file: " + fileName};
+		}
+		struct stat status;
+		void* mapped = MAP_FAILED;
+		if (::fstat(fd, &status) == 0 && static_cast<std::size_t>(status.st_size) >= header_size) {
+			mapped = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		}
+		::close(fd); // the mapping keeps the file
+		if (mapped == MAP_FAILED) {
+			throw std::invalid_argument {"Token_index unable to map index file: " + fileName};
+		}
+		_data = static_cast<const unsigned char*>(mapped);
+		_size = static_cast<std::size_t>(status.st_size);
+
+		_entryCount = read_word(_data + sizeof(index_magic));
+		_blockCount = read_word(_data + sizeof(index_magic) + sizeof(std::uint64_t));
+		const std::uint64_t tableOffset = read_word(_data + sizeof(index_magic) + 2 * sizeof(std::uint64_t));
+		if (std::memcmp(_data, index_magic, sizeof(index_magic)) != 0
+			|| tableOffset < header_size || tableOffset > _size
+			|| _blockCount != (_entryCount + block_size - 1) / block_size
+			|| _blockCount > (_size - tableOffset) / table_entry_size) {
+			::munmap(const_cast<unsigned char*>(_data), _size);
+			throw std::invalid_argument {"Token_index found no index in file: " + fileName};
+		}
+		_table = _data + tableOffset;
+	}
+
+	Token_index::~Token_index() {
+		::munmap(const_cast<unsigned char*>(_data), _size);
+	}
+
+	Count Token_index::count(Token_view token) const {
+		Count found = 0;
+		scan_block(first_block_of(token), [token, &found](Token_view t, Count c) {
+			int order = compare(t, token);
+			if (order == 0) {
+				found = c;
+			}
+			return order < 0;
+		});
+		return found;
+	}
+
+	std::vector<Output_sorting_file::Token_count> Token_index::with_prefix(Token_view prefix, std::size_t limit) const {
+		std::vector<Output_sorting_file::Token_count> matches;
+		if (limit == 0) {
+			return matches;
+		}
+		auto visit = [prefix, limit, &matches](Token_view t, Count c) {
+			if (starts_with(t, prefix)) {
+				matches.emplace_back(t.str(), c);
+				return matches.size() < limit;
+			}
+			return compare(t, prefix) < 0; // before the range, or past it
+		};
+		for (std::uint64_t b = first_block_of(prefix); b < _blockCount; ++b) {
+			if (!scan_block(b, visit)) {
+				break;
+			}
+		}
+		return matches;
+	}
+
+	std::vector<Output_sorting_file::Token_count> Token_index::top_with_prefix(Token_view prefix, std::size_t k) const {
+		using Token_count = Output_sorting_file::Token_count;
+		// the k best so far, the worst of them on top
+		std::priority_queue<Token_count, std::vector<Token_count>, Output_sorting_file::TC_compare> best;
+		if (k > 0 && _blockCount > 0) {
+			// the range's blocks, the one with the highest count on top
+			std::vector<std::uint64_t> blocks;
+			for (std::uint64_t b = first_block_of(prefix), end = end_block_of(prefix); b < end; ++b) {
+				blocks.push_back(b);
+			}
+			auto lower = [this](std::uint64_t a, std::uint64_t b) { return block_max(a) < block_max(b); };
+			std::make_heap(blocks.begin(), blocks.end(), lower);
+			auto visit = [prefix, k, &best](Token_view t, Count c) {
+				if (starts_with(t, prefix) && (best.size() < k || c >= best.top().second)) {
+					Token_count tc { t.str(), c };
+					if (best.size() < k) {
+						best.push(std::move(tc));
+					}
+					else if (Output_sorting_file::TC_compare()(tc, best.top())) {
+						best.pop();
+						best.push(std::move(tc));
+					}
+				}
+				return true;
+			};
+			while (!blocks.empty()) {
+				std::pop_heap(blocks.begin(), blocks.end(), lower);
+				std::uint64_t b = blocks.back();
+				blocks.pop_back();
+				if (best.size() == k && block_max(b) < best.top().second) {
+					break; // nothing left can make the k
+				}
+				scan_block(b, visit);
+			}
+		}
+		std::vector<Token_count> top;
+		top.reserve(best.size());
+		for (; !best.empty(); best.pop()) {
+			top.push_back(best.top());
+		}
+		std::reverse(top.begin(), top.end());
+		return top;
+	}
+
+	Token_view Token_index::first_token(std::uint64_t block) const noexcept {
+		const unsigned char* p = _data + read_word(_table + block * table_entry_size);
+		const unsigned char* end = _table;
+		std::uint64_t length = 0;
+		for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+			unsigned char byte = *p++;
+			length |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) {
+				break;
+			}
+		}
+		length = std::min<std::uint64_t>(length, static_cast<std::uint64_t>(end - p));
+		return Token_view { reinterpret_cast<const char*>(p), static_cast<std::size_t>(length) };
+	}
+
+	std::uint64_t Token_index::first_block_of(Token_view prefix) const noexcept {
+		// the last block starting at or before prefix
+		std::uint64_t low = 0, high = _blockCount; // the first block starting after prefix is in [low, high]
+		while (low < high) {
+			std::uint64_t middle = low + (high - low) / 2;
+			if (compare(first_token(middle), prefix) <= 0) {
+				low = middle + 1;
+			}
+			else {
+				high = middle;
+			}
+		}
+		return low > 0 ? low - 1 : 0;
+	}
+
+	std::uint64_t Token_index::end_block_of(Token_view prefix) const noexcept {
+		// the first block starting past every token with the prefix
+		std::uint64_t low = 0, high = _blockCount;
+		while (low < high) {
+			std::uint64_t middle = low + (high - low) / 2;
+			Token_view first = first_token(middle);
+			if (compare(first, prefix) < 0 || starts_with(first, prefix)) {
+				low = middle + 1;
+			}
+			else {
+				high = middle;
+			}
+		}
+		return low;
+	}
+
+	Count Token_index::block_max(std::uint64_t block) const noexcept {
+		return static_cast<Count>(read_word(_table + block * table_entry_size + sizeof(std::uint64_t)));
+	}
+
+	template <class Visit>
+	bool Token_index::scan_block(std::uint64_t block, Visit visit) const {
+		if (block >= _blockCount) {
+			return true;
+		}
+		const unsigned char* p = _data + read_word(_table + block * table_entry_size);
+		const unsigned char* end = _table;
+		require_bytes(_data, static_cast<std::uint64_t>(p - _data), end);
+		const std::uint64_t entries = std::min<std::uint64_t>(block_size, _entryCount - block * block_size);
+		std::string token;
+		for (std::uint64_t e = 0; e < entries; ++e) {
+			std::uint64_t shared = e == 0 ? 0 : read_block_varint(p, end);
+			std::uint64_t rest = read_block_varint(p, end);
+			require_bytes(p, rest, end);
+			if (shared > token.size()) {
+				throw std::runtime_error {"Token_index found a corrupt block"};
+			}
+			token.resize(static_cast<std::size_t>(shared));
+			token.append(reinterpret_cast<const char*>(p), static_cast<std::size_t>(rest));
+			p += rest;
+			auto count = static_cast<Count>(read_block_varint(p, end));
+			if (!visit(Token_view { token }, count)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+}
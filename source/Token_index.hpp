@@ -0,0 +1,137 @@
+/**
+ *	@file Token_index.hpp
+ *
+ *	A compact, immutable index of the final counts, queried in place
+ *	(exact lookups, prefix ranges, top-K by prefix) rather than grepping the output.
+ */
+
+#ifndef Token_index_hpp
+#define Token_index_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Output_sorting_file.hpp"
+#include "Token_count_map.hpp"
+
+namespace counterLib {
+
+	/**
+	 Writes an index file of the tokens of a map and their counts.
+
+	 The tokens are sorted bytewise and front coded in blocks of Token_index::block_size:
+	 each block starts with a whole token, and every later token is stored as
+	 the length of the prefix it shares with the token before and the rest of it.
+	 Lengths and counts are varints (see Id_file_writer). A table at the end gives
+	 each block's offset and the highest count in it. All numbers outside the
+	 blocks are 64-bit and in the byte order of the machine that wrote the file.
+	 Throws std::invalid_argument if the file can't be opened,
+	 or std::runtime_error if it can't be written.
+
+	 @param fileName [IN] Filename (path) of the index file to write.
+	 @param tcm [IN] The tokens and counts.
+	 @param minCount [IN] Tokens counted fewer times are left out.
+	 */
+	void write_token_index(const std::string& fileName, const Token_count_map& tcm, Count minCount = 1);
+
+	/**
+	 An index file written by write_token_index(), memory mapped and read in place,
+	 so only the pages a query touches are ever read.
+
+	 A lookup binary searches the block table on the blocks' first tokens
+	 and decodes one block. A prefix query decodes the blocks holding the prefix's range.
+	 A top-K query visits the range's blocks in order of their highest count
+	 and stops once no block left can beat the K found, so on a skewed vocabulary
+	 only a few blocks are decoded however wide the range.
+	 */
+	class Token_index {
+	public:
+		/**
+		 Initializing Constructor
+
+		 Maps the file. Throws std::invalid_argument if it can't be opened
+		 or isn't an index file.
+
+		 @param fileName [IN] Filename (path) of the index file.
+		 */
+		explicit Token_index(const std::string& fileName);
+
+		/**
+		 Copy constructor (deleted)
+
+		 Deleted because the mapping can't be shared.
+		 */
+		Token_index(const Token_index&) = delete;
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Token_index& operator= (const Token_index&) = delete;
+
+		/**
+		 Destructor
+
+		 Unmaps the file.
+		 */
+		~Token_index();
+
+		/**
+		 Gets the number of tokens in the index.
+		 */
+		std::uint64_t size() const noexcept { return _entryCount; }
+
+		/**
+		 Looks up the count of a token.
+
+		 @param token [IN] The token, as it is written in the output (cleaned and lowercase).
+		 @return Its count; 0 if it isn't in the index.
+		 */
+		Count count(Token_view token) const;
+
+		/**
+		 Gets the tokens starting with a prefix, in bytewise token order.
+
+		 @param prefix [IN] The prefix. Empty matches every token.
+		 @param limit [IN] Most tokens to get.
+		 @return Up to limit tokens and their counts.
+		 */
+		std::vector<Output_sorting_file::Token_count> with_prefix(Token_view prefix, std::size_t limit) const;
+
+		/**
+		 Gets the most frequent tokens starting with a prefix.
+
+		 @param prefix [IN] The prefix. Empty matches every token.
+		 @param k [IN] Most tokens to get.
+		 @return Up to k tokens and their counts, in output order (see Output_sorting_file::TC_compare).
+		 */
+		std::vector<Output_sorting_file::Token_count> top_with_prefix(Token_view prefix, std::size_t k) const;
+
+		/**
+		 Tokens in a block of an index file.
+		 */
+		static const std::size_t block_size;
+
+	private:
+		Token_view first_token(std::uint64_t block) const noexcept;
+		std::uint64_t first_block_of(Token_view prefix) const noexcept; // the block where tokens >= prefix start
+		std::uint64_t end_block_of(Token_view prefix) const noexcept; // the first block past the tokens starting with prefix
+		Count block_max(std::uint64_t block) const noexcept;
+
+		/**
+		 Decodes a block, calling visit(token, count) for each entry until it returns false.
+
+		 @return false if visit() stopped it.
+		 */
+		template <class Visit>
+		bool scan_block(std::uint64_t block, Visit visit) const;
+
+		const unsigned char* _data = nullptr; // the mapped file
+		std::size_t _size = 0;
+		std::uint64_t _entryCount = 0;
+		std::uint64_t _blockCount = 0;
+		const unsigned char* _table = nullptr; // per block: offset, highest count
+	};
+
+}
+
+#endif /* Token_index_hpp */
@@ -0,0 +1,64 @@
+/**
+ *	@file Varint.hpp
+ *
+ *	Unsigned LEB128 varints, as the token ID, index and checkpoint files hold numbers:
+ *	seven bits a byte, low bits first, the high bit set on all but the last byte.
+ *	Numbers below 128 take one byte, below 16384 two, and so on, up to ten for 64 bits.
+ */
+
+#ifndef Varint_hpp
+#define Varint_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace counterLib {
+
+	/**
+	 The most bytes a varint of 64 bits takes.
+	 */
+	const std::size_t max_varint_bytes = 10;
+
+	/**
+	 Appends a number as a varint.
+
+	 @param bytes [IN/OUT] The bytes to append to.
+	 @param value [IN] The number.
+	 */
+	inline void append_varint(std::string& bytes, std::uint64_t value) {
+		while (value >= 0x80) {
+			bytes.push_back(static_cast<char>(value | 0x80));
+			value >>= 7;
+		}
+		bytes.push_back(static_cast<char>(value));
+	}
+
+	/**
+	 Reads a varint from the bytes at p, moving p past it.
+	 Fails if the varint runs past end, or holds more than 64 bits
+	 (a tenth byte with more than its lowest bit set).
+
+	 @param p [IN/OUT] The first byte of the varint; then the byte after it, or where reading stopped.
+	 @param end [IN] Past the last byte that may be read.
+	 @param value [OUT] The number, if it was read.
+	 @return false if the varint was cut short or too long.
+	 */
+	inline bool read_varint(const unsigned char*& p, const unsigned char* end, std::uint64_t& value) noexcept {
+		value = 0;
+		for (unsigned shift = 0; p < end; shift += 7) {
+			unsigned char byte = *p++;
+			if (shift == 63 && byte > 1) {
+				return false; // more than 64 bits
+			}
+			value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+}
+
+#endif /* Varint_hpp */
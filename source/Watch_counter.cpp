@@ -0,0 +1,373 @@
+//
+//  Watch_counter.cpp
+//  counter
+//
+
+#include "Watch_counter.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include "Input_file_list.hpp"
+#include "File_token_counter.hpp"
+#include "Sorted_runs.hpp"
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+namespace counterLib {
+
+	const std::size_t Watch_counter::tail_size = 64;
+	const std::size_t Watch_counter::line_chunk_size = 1024 * 1024;
+
+	namespace {
+		const int poll_interval_ms = 100; // how often run() checks for stop()
+
+		/**
+		 Splits a path into its directory ("." if none) and its name.
+		 */
+		std::pair<std::string, std::string> split_path(const std::string& path) {
+			auto slash = path.find_last_of('/');
+			if (slash == std::string::npos) {
+				return { ".", path };
+			}
+			return { slash == 0 ? "/" : path.substr(0, slash), path.substr(slash + 1) };
+		}
+
+		/**
+		 Reads up to size bytes of the named file, starting at offset.
+		 */
+		std::string read_bytes(const std::string& fileName, std::uint64_t offset, std::size_t size) {
+			std::string bytes(size, '\0');
+			std::ifstream file { fileName, std::ios::binary };
+			file.seekg(static_cast<std::streamoff>(offset));
+			file.read(&bytes[0], static_cast<std::streamsize>(size));
+			bytes.resize(file ? size : static_cast<std::size_t>(file.gcount()));
+			return bytes;
+		}
+
+		/**
+		 The time now, in seconds since the epoch.
+		 */
+		std::int64_t now_seconds() {
+			return static_cast<std::int64_t>(std::time(nullptr));
+		}
+	}
+
+	Watch_counter::Watch_counter(const std::string& inputFileName, const std::string& outputFileName,
+								 std::chrono::milliseconds refreshInterval, const Watch_window& window) :
+		_outputFileName { outputFileName },
+		_refreshInterval { refreshInterval },
+		_windowOptions { window } {
+		if (window.span > 0) {
+			_window.reset(new Time_window { window.span, window.slices });
+			_window->advance(now_seconds());
+		}
+		Input_file_list ifl { inputFileName };
+		_files.resize(ifl.file_count());
+		std::size_t f = 0;
+		for (auto& name : ifl) {
+			_files[f].name = name;
+			auto path = split_path(name);
+			_filesByPath[path.first + '/' + path.second].push_back(f);
+			++f;
+		}
+		watch_directories();
+		if (!refresh()) {
+			write_output(); // nothing to count yet, but the output should exist
+		}
+		_starting = false;
+	}
+
+	Watch_counter::~Watch_counter() {
+		if (_watchFd >= 0) {
+			::close(_watchFd);
+		}
+	}
+
+	void Watch_counter::run() {
+		auto nextRefresh = std::chrono::steady_clock::now() + _refreshInterval;
+		while (!_stopping) {
+			read_events(poll_interval_ms);
+			auto now = std::chrono::steady_clock::now();
+			if (now >= nextRefresh) {
+				refresh();
+				nextRefresh = now + _refreshInterval;
+			}
+		}
+	}
+
+	bool Watch_counter::refresh() {
+		read_events(0);
+		bool changed = false;
+		for (auto& file : _files) {
+			if (file.changed || file.polled) {
+				file.changed = false;
+				changed = update(file) || changed;
+			}
+		}
+		if (_window) {
+			changed = _window->advance(now_seconds()) || changed;
+		}
+		if (changed) {
+			write_output();
+		}
+		return changed;
+	}
+
+	std::size_t Watch_counter::present_file_count() const noexcept {
+		std::size_t present = 0;
+		for (auto& file : _files) {
+			present += file.present ? 1 : 0;
+		}
+		return present;
+	}
+
+	bool Watch_counter::update(Watched_file& file) {
+		struct stat status;
+		if (::stat(file.name.c_str(), &status) != 0 || !S_ISREG(status.st_mode)) {
+			if (!file.present) {
+				return false;
+			}
+			subtract(file); // deleted (or renamed away)
+			file.present = false;
+			return true;
+		}
+
+		const std::uint64_t inode = static_cast<std::uint64_t>(status.st_ino);
+		const std::uint64_t size = static_cast<std::uint64_t>(status.st_size);
+		const std::int64_t modified = static_cast<std::int64_t>(status.st_mtime);
+		if (file.present && inode == file.inode && size == file.size && modified == file.modified) {
+			return false;
+		}
+
+		// an append only adds bytes, leaving those already counted as they were
+		bool appended = file.present && inode == file.inode && size > file.size && size >= file.counted
+			&& read_bytes(file.name, file.counted - file.tail.size(), file.tail.size()) == file.tail;
+		if (file.present && !appended) {
+			subtract(file); // rewritten: count it again from the start
+		}
+		file.present = true;
+		file.inode = inode;
+		file.size = size;
+		file.modified = modified;
+		try {
+			count_from(file, file.counted);
+		}
+		catch (std::invalid_argument&) {
+			file.present = false; // deleted again before it could be opened
+		}
+		return true;
+	}
+
+	void Watch_counter::count_from(Watched_file& file, std::uint64_t offset) {
+		if (_window && _windowOptions.line_times) {
+			count_lines(file, offset);
+			return;
+		}
+		if (_window && _starting) {
+			skip_existing(file);
+			return;
+		}
+		Token_count_map added;
+		File_token_counter ftc(file.name);
+		file.counted = ftc.add_appended_to_map(added, offset);
+
+		if (_window) {
+			_window->add(now_seconds(), added);
+		}
+		else {
+			file.counts.add_batch(added.cbegin(), added.cend());
+			_total.add_batch(added.cbegin(), added.cend());
+		}
+
+		std::size_t tail = static_cast<std::size_t>(std::min<std::uint64_t>(file.counted, tail_size));
+		file.tail = read_bytes(file.name, file.counted - tail, tail);
+	}
+
+	void Watch_counter::count_lines(Watched_file& file, std::uint64_t offset) {
+		if (offset == 0) {
+			file.lineTime = now_seconds();
+		}
+		// lines in a row in the same slice are tokenized together, as one text
+		std::string run;
+		std::int64_t runSlice = file.lineTime / _window->slice_seconds();
+		Token_count_map added;
+		auto add_run = [this, &run, &added, &file]() {
+			if (!run.empty()) {
+				added.clear();
+				add_text_to_map(run, added, _textBuffer);
+				_window->add(file.lineTime, added);
+				run.clear();
+			}
+		};
+		file.counted = offset;
+		std::size_t chunkSize = line_chunk_size;
+		for (;;) {
+			std::string chunk = read_bytes(file.name, file.counted, chunkSize);
+			auto lastLine = chunk.rfind('\n');
+			if (lastLine == std::string::npos) {
+				if (chunk.size() < chunkSize) {
+					break; // no whole line yet
+				}
+				chunkSize *= 2; // a line longer than a chunk, so read on to its end
+				continue;
+			}
+			for (std::size_t begin = 0; begin <= lastLine; ) {
+				std::size_t end = chunk.find('\n', begin) + 1;
+				Token_view line { chunk.data() + begin, end - begin };
+				std::int64_t time;
+				std::size_t length = 0;
+				if (parse_line_time(line, time, length)) {
+					std::int64_t slice = time / _window->slice_seconds();
+					if (slice != runSlice) {
+						add_run();
+						runSlice = slice;
+					}
+					file.lineTime = time;
+				}
+				run.append(line.data() + length, line.size() - length);
+				begin = end;
+			}
+			file.counted += lastLine + 1;
+			if (chunk.size() < chunkSize) {
+				break;
+			}
+			chunkSize = line_chunk_size;
+		}
+		add_run();
+
+		std::size_t tail = static_cast<std::size_t>(std::min<std::uint64_t>(file.counted, tail_size));
+		file.tail = read_bytes(file.name, file.counted - tail, tail);
+	}
+
+	void Watch_counter::skip_existing(Watched_file& file) {
+		// back from the end to the last whitespace, so a token being written is counted whole
+		std::size_t back = static_cast<std::size_t>(std::min<std::uint64_t>(file.size, File_token_counter::read_buffer_size));
+		std::string last = read_bytes(file.name, file.size - back, back);
+		std::size_t unfinished = 0;
+		while (unfinished < last.size() && !std::isspace(static_cast<unsigned char>(last[last.size() - 1 - unfinished]))) {
+			++unfinished;
+		}
+		file.counted = file.size - unfinished;
+		std::size_t tail = static_cast<std::size_t>(std::min<std::uint64_t>(file.counted, tail_size));
+		file.tail = read_bytes(file.name, file.counted - tail, tail);
+	}
+
+	void Watch_counter::subtract(Watched_file& file) {
+		// in window mode the counts leave the window with their slices instead
+		for (auto& tc : file.counts) {
+			auto total = _total.find(tc.first);
+			total->second -= tc.second;
+			if (total->second == 0) {
+				_hasZeroes = true;
+			}
+		}
+		file.counts.clear();
+		file.counted = 0;
+		file.tail.clear();
+	}
+
+	void Watch_counter::write_output() {
+		if (_hasZeroes) {
+			_total.drop_zeroes();
+			_hasZeroes = false;
+		}
+
+		const std::string temporary = _outputFileName + ".tmp";
+		{
+			std::ofstream out { temporary };
+			if (!out.is_open()) {
+				throw std::invalid_argument {"Watch_counter unable to open output file: " + temporary};
+			}
+			if (_window) {
+				for (auto& tc : _window->top(_windowOptions.top_k ? _windowOptions.top_k : _window->counts().size())) {
+					out << tc.first << ", " << tc.second << '\n';
+				}
+			}
+			else {
+				Sorted_runs runs;
+				runs.sort(_total);
+				runs.write(out);
+			}
+		}
+		if (std::rename(temporary.c_str(), _outputFileName.c_str()) != 0) {
+			throw std::system_error {errno, std::generic_category(), "Watch_counter unable to replace output file: " + _outputFileName};
+		}
+	}
+
+	void Watch_counter::watch_directories() {
+#if defined(__linux__)
+		_watchFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (_watchFd < 0) {
+			throw std::system_error {errno, std::generic_category(), "Watch_counter unable to start inotify"};
+		}
+		const std::uint32_t events = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE
+			| IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+		std::unordered_map<std::string, int> directories; // directory -> watch descriptor, -1 if unwatchable
+		for (auto& file : _files) {
+			auto directory = split_path(file.name).first;
+			auto d = directories.find(directory);
+			if (d == directories.end()) {
+				int wd = ::inotify_add_watch(_watchFd, directory.c_str(), events);
+				if (wd >= 0) {
+					_watchedDirectories[wd].push_back(directory); // the same directory may be spelled two ways
+				}
+				d = directories.emplace(directory, wd).first;
+			}
+			file.polled = d->second < 0; // e.g. the directory doesn't exist yet
+		}
+#endif
+	}
+
+	void Watch_counter::read_events(int timeoutMs) {
+#if defined(__linux__)
+		pollfd watch { _watchFd, POLLIN, 0 };
+		if (::poll(&watch, 1, timeoutMs) <= 0) {
+			return;
+		}
+		alignas(inotify_event) char buffer[16 * 1024];
+		ssize_t n;
+		while ((n = ::read(_watchFd, buffer, sizeof(buffer))) > 0) {
+			for (char* p = buffer; p < buffer + n; ) {
+				auto event = reinterpret_cast<const inotify_event*>(p);
+				if (event->mask & IN_Q_OVERFLOW) {
+					mark_all_changed(); // events were lost
+				}
+				else if (event->len > 0) {
+					auto directories = _watchedDirectories.find(event->wd);
+					if (directories != _watchedDirectories.end()) {
+						for (auto& directory : directories->second) {
+							auto files = _filesByPath.find(directory + '/' + event->name);
+							if (files != _filesByPath.end()) {
+								for (auto f : files->second) {
+									_files[f].changed = true;
+								}
+							}
+						}
+					}
+				}
+				p += sizeof(inotify_event) + event->len;
+			}
+		}
+#else
+		// no change notification here: every file is polled at each refresh
+		std::this_thread::sleep_for(std::chrono::milliseconds { timeoutMs });
+#endif
+	}
+
+	void Watch_counter::mark_all_changed() noexcept {
+		for (auto& file : _files) {
+			file.changed = true;
+		}
+	}
+
+}
@@ -0,0 +1,185 @@
+/**
+ *	@file Watch_counter.hpp
+ *
+ *	Watch mode of the 'counter' program: counts kept up to date as files change.
+ */
+
+#ifndef Watch_counter_hpp
+#define Watch_counter_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Time_window.hpp"
+#include "Token_count_map.hpp"
+
+namespace counterLib {
+
+	/**
+	 Window mode of a Watch_counter: what it counts over, if not all time.
+	 */
+	struct Watch_window {
+		std::int64_t span = 0; // seconds counted over; 0 counts all time
+		std::size_t slices = 60; // the window moves on a slice at a time (see Time_window)
+		bool line_times = false; // take the time of each line from its timestamp (see parse_line_time()), not from when it was read
+		std::size_t top_k = 0; // tokens written at each refresh; 0 writes them all
+	};
+
+	/**
+	 Keeps the token counts of the files listed in an input file up to date
+	 as those files change, for example live log files, without recounting them all.
+
+	 The overall count table stays resident, along with each file's own counts.
+	 When a file changes:
+	 	- if it has grown (been appended to), only the new bytes are tokenized.
+	 	- if it has been rewritten (shrunk, replaced, or changed in place),
+	 	  its old counts are subtracted and it is counted again.
+	 	- if it has been deleted, its counts are subtracted.
+	 	- if a listed file that was missing appears, it is counted.
+	 A token at the very end of a file is only counted once whitespace follows it,
+	 as the rest of it may not have been written yet.
+
+	 On Linux, changes are noticed through inotify, watching the directories
+	 of the listed files; elsewhere every file is checked at each refresh.
+	 Every refresh interval the pending changes are applied and,
+	 if any counts changed, the sorted output file is rewritten.
+	 The output is written to a temporary file that is then renamed over the output,
+	 so readers never see a half written one.
+
+	 The input file itself is read once, by the constructor.
+
+	 In window mode (see Watch_window) the counts cover only the last span seconds,
+	 kept in a Time_window. Bytes appended to a file are counted in the slice of
+	 the time they were read, or, with line_times, line by line in the slice
+	 of each line's timestamp (a line without one takes the time of the line before),
+	 in which case only whole lines are counted, and the timestamps themselves are not.
+	 Counts leave the window as their slices expire, rather than when a file
+	 is rewritten or deleted, so no file's counts are kept. Without line_times,
+	 what files hold when watching starts is skipped, as it was written at unknown times.
+	 At each refresh the window moves on, and the output, its top_k tokens,
+	 is rewritten if any counts came or went.
+	 */
+	class Watch_counter {
+	public:
+		/**
+		 Initializing Constructor
+
+		 Reads the list of files, counts them all and writes the output once.
+		 Throws std::invalid_argument if the input file can't be read,
+		 or std::system_error if the files can't be watched.
+
+		 @param inputFileName [IN] Filename (path) of a file listing the files to watch, one per line.
+			Listed files need not exist yet.
+		 @param outputFileName [IN] Filename (path) of the output file.
+		 @param refreshInterval [IN] How often run() applies changes and refreshes the output.
+		 @param window [IN] The window to count over; by default, all time.
+			Throws std::invalid_argument if its span is shorter than its slice count.
+		 */
+		Watch_counter(const std::string& inputFileName, const std::string& outputFileName,
+					  std::chrono::milliseconds refreshInterval = std::chrono::seconds { 5 },
+					  const Watch_window& window = Watch_window {});
+
+		/**
+		 Copy constructor (deleted)
+
+		 Deleted because the watch descriptor can't be copied.
+		 */
+		Watch_counter(const Watch_counter&) = delete;
+
+		/**
+		 Destructor
+
+		 Stops watching.
+		 */
+		~Watch_counter();
+
+		/**
+		 Copy Assignment Operator (deleted)
+		 */
+		Watch_counter& operator= (const Watch_counter&) = delete;
+
+		/**
+		 Refreshes every refresh interval until stop() is called.
+		 */
+		void run();
+
+		/**
+		 Asks run() to return. Safe to call from any thread or a signal handler.
+		 */
+		void stop() noexcept { _stopping = true; }
+
+		/**
+		 Applies the changes noticed so far right away,
+		 and rewrites the output file if any counts changed.
+
+		 @return Whether any counts changed.
+		 */
+		bool refresh();
+
+		/**
+		 Gets the current overall counts, or the window's in window mode.
+		 Tokens whose count has dropped to 0 may still be present until the next refresh.
+
+		 @return The resident count table.
+		 */
+		const Token_count_map& counts() const noexcept { return _window ? _window->counts() : _total; }
+
+		/**
+		 Gets the number of listed files that currently exist.
+
+		 @return The number of files being counted.
+		 */
+		std::size_t present_file_count() const noexcept;
+
+	private:
+		/**
+		 What is known about one listed file.
+		 */
+		struct Watched_file {
+			std::string name;
+			bool present = false;
+			bool changed = true; // needs a look at the next refresh
+			bool polled = true; // checked at every refresh, as its directory isn't watched
+			std::uint64_t inode = 0;
+			std::uint64_t size = 0;
+			std::int64_t modified = 0; // seconds since the epoch
+			std::uint64_t counted = 0; // bytes counted so far: offset to continue from
+			std::string tail; // the last bytes counted, to tell an append from a rewrite
+			std::int64_t lineTime = 0; // in window mode with line times, the timestamp of the last line counted
+			Token_count_map counts; // this file's share of _total
+		};
+
+		bool update(Watched_file& file); // applies one file's changes; returns whether counts changed
+		void count_from(Watched_file& file, std::uint64_t offset);
+		void count_lines(Watched_file& file, std::uint64_t offset); // into the window, by line timestamps
+		void skip_existing(Watched_file& file); // to the end of its last token, uncounted
+		void subtract(Watched_file& file);
+		void write_output();
+		void watch_directories();
+		void read_events(int timeoutMs); // marks files named by change events
+		void mark_all_changed() noexcept;
+		static const std::size_t tail_size; // bytes kept in Watched_file::tail
+		static const std::size_t line_chunk_size; // bytes count_lines() reads at a time, or more for a longer line
+
+		std::string _outputFileName;
+		std::chrono::milliseconds _refreshInterval;
+		std::atomic<bool> _stopping { false };
+		std::vector<Watched_file> _files;
+		Token_count_map _total;
+		bool _hasZeroes = false; // some counts in _total have dropped to 0
+		Watch_window _windowOptions;
+		std::unique_ptr<Time_window> _window; // in window mode, instead of _total
+		bool _starting = true; // within the constructor's first refresh
+		std::vector<char> _textBuffer; // scratch for count_lines()
+		int _watchFd = -1; // inotify instance; -1 where inotify isn't available
+		std::unordered_map<int, std::vector<std::string>> _watchedDirectories; // watch descriptor -> directory (as spelled in the list)
+		std::unordered_map<std::string, std::vector<std::size_t>> _filesByPath; // directory + '/' + name -> files
+	};
+
+}
+
+#endif /* Watch_counter_hpp */
@@ -1,30 +1,465 @@
 /**
  *	@file main.cpp
  *
- *	Takes care of the basic user interface and overall error handling. 
- *	Instantiates and executes the Counter class. 
+ *	Takes care of the basic user interface and overall error handling.
+ *	Instantiates and executes the Counter class,
+ *	or with --serve, runs a Count_server until it is shut down,
+ *	or with --watch, keeps the output up to date until interrupted,
+ *	or with --shards, runs the count as processes of shards and merges their outputs.
  *
  *  Created by John D. Hopkins on 3/13/17.
  */
 
 #include <iostream>
+#include <fstream>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
 #include "Counter.hpp"
+#include "Count_server.hpp"
+#include "Watch_counter.hpp"
+
+namespace {
+	/**
+	 Options of a normal (not server) run.
+	 */
+	struct Options {
+		unsigned ngrams = 1;
+		counterLib::Count minCount = 1; // --min-count
+		const char* stopwordFileName = nullptr; // --stopwords
+		const char* dfFileName = nullptr; // --df
+		const char* postingsFileName = nullptr; // --postings
+		const char* idDirectory = nullptr; // --token-ids
+		const char* indexFileName = nullptr; // --index
+		bool numa = false; // --numa
+		bool memoryStats = false; // --memory-stats
+		bool dedup = false; // --dedup
+		bool progress = false; // --progress
+		double sample = 0; // --sample
+		const char* shard = nullptr; // --shard, as index/count
+		counterLib::Shard_mode shardMode = counterLib::Shard_mode::files; // --shard-by
+		unsigned shards = 0; // --shards, to launch that many shard processes
+		const char* checkpointFileName = nullptr; // --checkpoint
+		double checkpointSeconds = 60; // --checkpoint-every
+		bool resume = false; // --resume
+		bool fingerprints = false; // --fingerprints
+		bool schedule = false; // --schedule
+		const char* inputFileName = nullptr;
+		const char* outputFileName = nullptr;
+	};
+
+	/**
+	 Reads the options, each followed by its value unless it's a flag,
+	 then the input and output filenames.
+
+	 @return false if the command line doesn't fit.
+	 */
+	bool parse_options(int argc, const char * argv[], Options& options) {
+		int a = 1;
+		for (; a + 2 < argc; a += 2) {
+			if (std::strcmp(argv[a], "--numa") == 0) {
+				options.numa = true;
+				--a; // no value
+			}
+			else if (std::strcmp(argv[a], "--memory-stats") == 0) {
+				options.memoryStats = true;
+				--a;
+			}
+			else if (std::strcmp(argv[a], "--dedup") == 0) {
+				options.dedup = true;
+				--a;
+			}
+			else if (std::strcmp(argv[a], "--progress") == 0) {
+				options.progress = true;
+				--a;
+			}
+			else if (std::strcmp(argv[a], "--resume") == 0) {
+				options.resume = true;
+				--a;
+			}
+			else if (std::strcmp(argv[a], "--fingerprints") == 0) {
+				options.fingerprints = true;
+				--a;
+			}
+			else if (std::strcmp(argv[a], "--schedule") == 0) {
+				options.schedule = true;
+				--a;
+			}
+			else if (std::strcmp(argv[a], "--checkpoint") == 0) {
+				options.checkpointFileName = argv[a + 1];
+			}
+			else if (std::strcmp(argv[a], "--checkpoint-every") == 0) {
+				options.checkpointSeconds = std::strtod(argv[a + 1], nullptr);
+			}
+			else if (std::strcmp(argv[a], "--ngrams") == 0) {
+				options.ngrams = static_cast<unsigned>(std::strtoul(argv[a + 1], nullptr, 10));
+			}
+			else if (std::strcmp(argv[a], "--min-count") == 0) {
+				char* end = nullptr;
+				errno = 0;
+				options.minCount = std::strtoll(argv[a + 1], &end, 10);
+				if (end == argv[a + 1] || *end != '\0' || errno == ERANGE) {
+					return false; // not a number
+				}
+			}
+			else if (std::strcmp(argv[a], "--stopwords") == 0) {
+				options.stopwordFileName = argv[a + 1];
+			}
+			else if (std::strcmp(argv[a], "--df") == 0) {
+				options.dfFileName = argv[a + 1];
+			}
+			else if (std::strcmp(argv[a], "--postings") == 0) {
+				options.postingsFileName = argv[a + 1];
+			}
+			else if (std::strcmp(argv[a], "--token-ids") == 0) {
+				options.idDirectory = argv[a + 1];
+			}
+			else if (std::strcmp(argv[a], "--index") == 0) {
+				options.indexFileName = argv[a + 1];
+			}
+			else if (std::strcmp(argv[a], "--sample") == 0) {
+				options.sample = std::strtod(argv[a + 1], nullptr);
+			}
+			else if (std::strcmp(argv[a], "--shard") == 0) {
+				options.shard = argv[a + 1];
+			}
+			else if (std::strcmp(argv[a], "--shards") == 0) {
+				options.shards = static_cast<unsigned>(std::strtoul(argv[a + 1], nullptr, 10));
+			}
+			else if (std::strcmp(argv[a], "--shard-by") == 0) {
+				if (std::strcmp(argv[a + 1], "tokens") == 0) {
+					options.shardMode = counterLib::Shard_mode::tokens;
+				}
+				else if (std::strcmp(argv[a + 1], "files") != 0) {
+					return false;
+				}
+			}
+			else {
+				return false;
+			}
+		}
+		if (a + 2 != argc || (options.resume && !options.checkpointFileName)) {
+			return false;
+		}
+		options.inputFileName = argv[a];
+		options.outputFileName = argv[a + 1];
+		return true;
+	}
+
+	/**
+	 Reads the window options of watch mode, between the refresh interval
+	 and the input and output filenames.
+
+	 @return false if they don't fit.
+	 */
+	bool parse_window_options(int argc, const char * argv[], counterLib::Watch_window& window) {
+		int a = 3;
+		for (; a + 2 < argc; a += 2) {
+			if (std::strcmp(argv[a], "--line-times") == 0) {
+				window.line_times = true;
+				--a; // no value
+			}
+			else if (std::strcmp(argv[a], "--window") == 0) {
+				window.span = std::strtoll(argv[a + 1], nullptr, 10);
+			}
+			else if (std::strcmp(argv[a], "--slices") == 0) {
+				window.slices = std::strtoul(argv[a + 1], nullptr, 10);
+			}
+			else if (std::strcmp(argv[a], "--top") == 0) {
+				window.top_k = std::strtoul(argv[a + 1], nullptr, 10);
+			}
+			else {
+				return false;
+			}
+		}
+		return a + 2 == argc;
+	}
+
+	counterLib::Watch_counter* activeWatcher = nullptr; // for stop_watching()
+
+	/**
+	 Signal handler ending watch mode.
+	 */
+	void stop_watching(int) {
+		if (activeWatcher) {
+			activeWatcher->stop();
+		}
+	}
+
+	/**
+	 Writes one line on how far a job has got, with its leading tokens, to stderr
+	 (so that the output on stdout stays as it is).
+	 */
+	void report_progress(const counterLib::Count_job& job) {
+		counterLib::Count_progress progress = job.progress();
+		std::cerr << "Counted " << progress.files_done << " of " << progress.file_count << " files ("
+			<< progress.bytes_done << " of " << progress.byte_count << " bytes)";
+		const char* separator = "; leading: ";
+		for (auto& tc : job.snapshot()) {
+			std::cerr << separator << tc.first << " " << tc.second;
+			separator = ", ";
+		}
+		std::cerr << std::endl;
+	}
+
+	/**
+	 Runs the count as options.shards processes of this program, each with its --shard,
+	 and merges their outputs (see counterLib::launch_shards()).
+	 Every other option is passed on, except the minimum count, which launch_shards() places.
+
+	 @return false if an option would have every shard write the same file.
+	 */
+	bool run_shards(int argc, const char * argv[], const Options& options) {
+		if (options.shard || options.dfFileName || options.postingsFileName || options.idDirectory
+			|| options.indexFileName || options.sample != 0 || options.progress || options.checkpointFileName) {
+			return false;
+		}
+		std::vector<std::string> passed;
+		for (int a = 1; a + 2 < argc; ++a) {
+			if (std::strcmp(argv[a], "--shards") == 0 || std::strcmp(argv[a], "--shard-by") == 0
+				|| std::strcmp(argv[a], "--min-count") == 0) {
+				++a; // and its value
+			}
+			else {
+				passed.push_back(argv[a]);
+			}
+		}
+		std::uint64_t written = counterLib::launch_shards(argv[0], passed, options.shards, options.shardMode,
+														  options.inputFileName, options.outputFileName, options.minCount);
+		std::cout << "Output of " << options.shards << " shards written to " << options.outputFileName
+			<< " (" << written << " unique tokens)" << std::endl;
+		return true;
+	}
+
+	/**
+	 Answers a query of an index file written with --index:
+	 the counts of the given tokens, the tokens with a prefix (--prefix prefix [limit]),
+	 or the most frequent of them (--top prefix [k]).
+
+	 @return false if the command line doesn't fit.
+	 */
+	bool query(int argc, const char * argv[]) {
+		if (argc < 4) {
+			return false;
+		}
+		const bool prefix = std::strcmp(argv[3], "--prefix") == 0;
+		const bool top = std::strcmp(argv[3], "--top") == 0;
+		if ((prefix || top) && (argc < 5 || argc > 6)) {
+			return false;
+		}
+		counterLib::Token_index index { argv[2] };
+		if (prefix || top) {
+			std::size_t limit = argc == 6 ? std::strtoul(argv[5], nullptr, 10) : (top ? 10 : 100);
+			auto matches = top ? index.top_with_prefix(argv[4], limit) : index.with_prefix(argv[4], limit);
+			for (auto& tc : matches) {
+				std::cout << tc.first << ", " << tc.second << std::endl;
+			}
+		}
+		else {
+			for (int a = 3; a < argc; ++a) {
+				std::cout << argv[a] << ", " << index.count(argv[a]) << std::endl;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 Opens the named file for writing.
+	 */
+	std::ofstream open_output(const char* fileName) {
+		std::ofstream out { fileName };
+		if (!out.is_open()) {
+			throw std::invalid_argument {std::string {"Unable to open output file: "} + fileName};
+		}
+		return out;
+	}
+}
 
 int main(int argc, const char * argv[]) {
 	int theErr = 0;
-	
-	if (argc != 3) {
-		std::cout << "Usage: ./counter input.txt output.txt" << std::endl;
+	Options options;
+	counterLib::Watch_window window;
+
+	if (argc >= 3 && argc <= 4 && std::strcmp(argv[1], "--serve") == 0) {
+		try {
+			unsigned threads = argc == 4 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 0;
+			counterLib::Count_server server { argv[2], threads };
+			std::cout << "Serving on " << server.socket_path() << std::endl;
+			server.run();
+		}
+		catch (std::exception& e) {
+			std::cout << e.what() << std::endl;
+			theErr = 3;
+		}
+	}
+	else if (argc >= 4 && std::strcmp(argv[1], "query") == 0) {
+		try {
+			if (!query(argc, argv)) {
+				std::cout << "Usage: ./counter query index token..." << std::endl;
+				std::cout << "       ./counter query index --prefix prefix [limit]" << std::endl;
+				std::cout << "       ./counter query index --top prefix [k]" << std::endl;
+				theErr = 1;
+			}
+		}
+		catch (std::invalid_argument& ia) {
+			std::cout << "Invalid argument: " << ia.what() << std::endl;
+			theErr = 2;
+		}
+		catch (std::exception& e) {
+			std::cout << e.what() << std::endl;
+			theErr = 3;
+		}
+	}
+	else if (argc >= 5 && std::strcmp(argv[1], "--watch") == 0 && parse_window_options(argc, argv, window)) {
+		try {
+			const char* inputFileName = argv[argc - 2];
+			const char* outputFileName = argv[argc - 1];
+			double seconds = std::strtod(argv[2], nullptr);
+			counterLib::Watch_counter watcher { inputFileName, outputFileName,
+				std::chrono::milliseconds { static_cast<long long>(seconds > 0 ? seconds * 1000 : 1000) }, window };
+			activeWatcher = &watcher;
+			std::signal(SIGINT, stop_watching);
+			std::signal(SIGTERM, stop_watching);
+			std::cout << "Watching the files listed in " << inputFileName << ", writing " << outputFileName
+				<< " every " << argv[2] << " seconds";
+			if (window.span > 0) {
+				std::cout << " (the last " << window.span << " seconds)";
+			}
+			std::cout << ". Interrupt to stop." << std::endl;
+			watcher.run();
+			activeWatcher = nullptr;
+		}
+		catch (std::invalid_argument& ia) {
+			std::cout << "Invalid argument: " << ia.what() << std::endl;
+			theErr = 2;
+		}
+		catch (std::exception& e) {
+			std::cout << e.what() << std::endl;
+			theErr = 3;
+		}
+	}
+	else if (!parse_options(argc, argv, options)) {
+		std::cout << "Usage: ./counter [--ngrams n] [--min-count n] [--stopwords stopwords.txt]" << std::endl;
+		std::cout << "                 [--df df.txt] [--postings postings.txt] [--numa]" << std::endl;
+		std::cout << "                 [--memory-stats] [--dedup] [--progress] [--token-ids directory]" << std::endl;
+		std::cout << "                 [--sample fraction] [--index index] [--fingerprints] [--schedule]" << std::endl;
+		std::cout << "                 [--checkpoint snapshot [--checkpoint-every seconds] [--resume]]" << std::endl;
+		std::cout << "                 [--shard i/n | --shards n] [--shard-by files|tokens] input.txt output.txt" << std::endl;
+		std::cout << "       ./counter query index (token... | --prefix prefix [limit] | --top prefix [k])" << std::endl;
+		std::cout << "       ./counter --serve socket_path [threads]" << std::endl;
+		std::cout << "       ./counter --watch seconds [--window seconds] [--slices n] [--top k] [--line-times]" << std::endl;
+		std::cout << "                 input.txt output.txt" << std::endl;
 		theErr = 1;
 	}
+	else if (options.shards > 0) {
+		try {
+			if (!run_shards(argc, argv, options)) {
+				std::cout << "--shards can't be combined with --shard, --df, --postings, --token-ids," << std::endl;
+				std::cout << "--index, --sample, --progress or --checkpoint." << std::endl;
+				theErr = 1;
+			}
+		}
+		catch (std::invalid_argument& ia) {
+			std::cout << "Invalid argument: " << ia.what() << std::endl;
+			theErr = 2;
+		}
+		catch (std::exception& e) {
+			std::cout << e.what() << std::endl;
+			theErr = 3;
+		}
+	}
 	else {
 		try {
-			std::unique_ptr<counterLib::Counter> c
-				{ counterLib::Counter::singleton_instance(argv[1],argv[2]) };
-			c->execute();
-			
-			std::cout << "Output written to " << argv[2] << ":" << std::endl;
-			c->result_to_output(std::cout);
+			std::unique_ptr<counterLib::Node_pools> nodes;
+			counterLib::Counter c { options.inputFileName, options.outputFileName };
+			if (options.numa) {
+				nodes.reset(new counterLib::Node_pools {});
+				c.set_node_pools(nodes.get());
+			}
+			c.set_memory_profiling(options.memoryStats);
+			c.set_deduplication(options.dedup);
+			c.set_ngram_size(options.ngrams);
+			c.set_min_count(options.minCount);
+			if (options.shard) {
+				c.set_shard(counterLib::parse_shard(options.shard), options.shardMode);
+			}
+			if (options.stopwordFileName) {
+				c.set_stopwords(counterLib::load_stopwords(options.stopwordFileName));
+			}
+			if (options.dfFileName || options.postingsFileName) {
+				c.collect_document_stats(true, options.postingsFileName != nullptr);
+			}
+			if (options.idDirectory) {
+				c.set_token_id_output(options.idDirectory);
+			}
+			if (options.sample != 0) {
+				c.set_sampling(options.sample);
+			}
+			if (options.checkpointFileName) {
+				c.set_checkpointing(options.checkpointFileName,
+					std::chrono::milliseconds { static_cast<long long>(options.checkpointSeconds * 1000) }, options.resume);
+			}
+			c.set_fingerprinting(options.fingerprints);
+			if (options.progress) {
+				counterLib::Count_job job = c.execute_async(5);
+				while (!job.wait_for(std::chrono::seconds { 1 })) {
+					report_progress(job);
+				}
+				job.get();
+				report_progress(job);
+			}
+			else {
+				c.execute();
+			}
+
+			if (options.shard) {
+				// a shard's console goes to its log, so the result isn't written twice
+				std::cout << "Output written to " << options.outputFileName << std::endl;
+			}
+			else {
+				std::cout << "Output written to " << options.outputFileName << ":" << std::endl;
+				c.result_to_output(std::cout);
+			}
+			for (auto& collision : c.fingerprint_collisions()) {
+				std::cout << "Warning: " << collision.first << " and " << collision.second
+					<< " share a fingerprint and were counted together." << std::endl;
+			}
+
+			if (options.dfFileName) {
+				std::ofstream df = open_output(options.dfFileName);
+				c.write_document_frequencies(df);
+				std::cout << "Document frequencies written to " << options.dfFileName << std::endl;
+			}
+			if (options.postingsFileName) {
+				std::ofstream postings = open_output(options.postingsFileName);
+				c.write_postings(postings);
+				std::cout << "Postings written to " << options.postingsFileName << std::endl;
+			}
+			if (options.sample > 0) {
+				std::cout << "Estimated from a sample of " << options.sample << " of each file (95% intervals):" << std::endl;
+				for (auto& e : c.sample_estimates(10)) {
+					std::cout << e.token << ", ~" << e.estimate << " (" << e.low << " to " << e.high
+						<< ", " << e.sampled << " sampled)" << std::endl;
+				}
+			}
+			if (options.indexFileName) {
+				c.write_index(options.indexFileName);
+				std::cout << "Index written to " << options.indexFileName << std::endl;
+			}
+			if (options.idDirectory) {
+				std::cout << "Token IDs written to " << options.idDirectory << std::endl;
+			}
+			if (options.schedule) {
+				std::cout << "Schedule: ";
+				c.schedule().write(std::cout);
+			}
+			if (options.memoryStats) {
+				std::cout << "Memory use:" << std::endl;
+				c.write_memory_profile(std::cout);
+			}
 		}
 		catch (std::invalid_argument&  ia) {
 			std::cout << "Invalid argument: " << ia.what() << std::endl;
@@ -35,6 +470,6 @@ int main(int argc, const char * argv[]) {
 			theErr = 3;
 		}
 	}
-	
+
 	return theErr;
 }